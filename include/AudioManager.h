@@ -30,6 +30,7 @@
 class VPMSession;
 class VPMPayloadDecoder;
 class VPMAudioMeter;
+class mutex;
 
 #include <VPMedia/VPMSessionListener.h>
 #include <VPMedia/VPMPayload.h>
@@ -37,6 +38,8 @@ class VPMAudioMeter;
 #include <string>
 #include <vector>
 
+#include "SourceKey.h"
+
 typedef struct AudioSource
 {
     uint32_t ssrc;
@@ -83,6 +86,13 @@ public:
 
 private:
     std::vector<AudioSource*> sources;
+    // same as above, keyed by session & SSRC for the session callbacks
+    std::tr1::unordered_map<SourceKey, AudioSource*, SourceKeyHash>
+        sourceIndex;
+
+    // sources get added/removed from the session threads and read from the
+    // main thread
+    mutex* sourceMutex;
 
 };
 
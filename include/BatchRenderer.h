@@ -0,0 +1,125 @@
+/*
+ * @file BatchRenderer.h
+ *
+ * Definition of the BatchRenderer class, which collects flat 2D geometry
+ * (borders, backgrounds, outlines) so it can be drawn with a handful of
+ * calls instead of per object.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHRENDERER_H_
+#define BATCHRENDERER_H_
+
+#include "GLUtil.h"
+#include "RectangleBase.h"
+
+#include <vector>
+
+class TileRenderer;
+
+/*
+ * Geometry is given in world space (ie, not relative to whatever's on the
+ * modelview stack), axis-aligned, and is drawn in the order it was added,
+ * alpha blended. Consecutive quads with the same texture and consecutive
+ * lines get merged into a single draw, and all of it goes to the card in one
+ * vertex buffer per flush, so a frame's worth of borders costs about the
+ * same as one.
+ *
+ * Only used on the main thread, from gravManager::draw().
+ */
+class BatchRenderer
+{
+
+public:
+    BatchRenderer();
+    ~BatchRenderer();
+
+    /*
+     * Add a quad covering the given rectangle, untextured if texture is 0.
+     * Texture coordinates go from 0,0 at the bottom left to s,t at the top
+     * right.
+     */
+    void addQuad( float left, float bottom, float right, float top, float z,
+                    RGBAColor color, GLuint texture = 0, float s = 1.0f,
+                    float t = 1.0f );
+
+    void addLine( float x1, float y1, float x2, float y2, float z,
+                    RGBAColor color );
+
+    /*
+     * Add a square point, size pixels across. Consecutive points the same
+     * size get drawn together.
+     */
+    void addPoint( float x, float y, float z, float size, RGBAColor color );
+
+    /*
+     * Add the outline of the given rectangle, same as a line loop.
+     */
+    void addOutline( float left, float bottom, float right, float top,
+                        float z, RGBAColor color );
+
+    /*
+     * Draw everything added so far & clear it. Needs the modelview matrix to
+     * be just the camera.
+     */
+    void flush();
+
+    /*
+     * Where objects drawn as part of a batch can put their video, if they
+     * have any. Flushed separately, by whoever set it.
+     */
+    void setTileRenderer( TileRenderer* t );
+    TileRenderer* getTileRenderer();
+
+private:
+    typedef struct {
+        GLfloat x, y, z;
+        GLfloat s, t;
+        GLfloat r, g, b, a;
+    } Vertex;
+
+    // a range of vertices that can go in one draw call
+    typedef struct {
+        GLenum mode;
+        GLuint texture;
+        // only for points
+        GLfloat size;
+        GLint first;
+        GLsizei count;
+    } Run;
+
+    void addVertex( float x, float y, float z, float s, float t,
+                    const RGBAColor& color );
+    // extends the last run if it's the same kind, starts a new one if not
+    void extendRun( GLenum mode, GLuint texture, GLsizei count,
+                    GLfloat size = 1.0f );
+
+    std::vector<Vertex> vertices;
+    std::vector<Run> runs;
+
+    // falls back to client-side arrays if there are no VBOs
+    GLuint vbo;
+    bool vboChecked;
+
+    TileRenderer* tileRenderer;
+
+};
+
+#endif /* BATCHRENDERER_H_ */
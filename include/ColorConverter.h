@@ -0,0 +1,94 @@
+/*
+ * @file ColorConverter.h
+ *
+ * Conversion of planar YUV420 video frames to RGBA on the CPU, for when
+ * shaders aren't available to do it on the GPU. Picks the fastest kernel the
+ * CPU supports (AVX2, SSE2 or plain C) at runtime.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLORCONVERTER_H_
+#define COLORCONVERTER_H_
+
+#include <stdint.h>
+
+/*
+ * All the kernels use the same fixed-point BT.601 (video range) math, so
+ * they give exactly the same output - the SIMD ones just do 8 or 16 pixels
+ * at a time. Functions are thread safe, since there's no state beyond the
+ * kernel selection.
+ */
+class ColorConverter
+{
+
+public:
+    enum Kernel
+    {
+        KERNEL_AUTO = 0,
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2
+    };
+
+    /*
+     * Convert a YUV420P frame (Y plane followed by the quarter-size U & V
+     * planes, as the sinks hand out) to RGBA with alpha at 255. Dest must
+     * have room for w*h*4 bytes. With odd sizes the chroma planes are
+     * (w/2)x(h/2), rounded down.
+     */
+    static void yuv420ToRGBA( const uint8_t* src, unsigned int w,
+                                unsigned int h, uint8_t* dest );
+
+    /*
+     * Same as above, but with separate planes & strides. destStride is in
+     * bytes.
+     */
+    static void yuv420ToRGBA( const uint8_t* y, const uint8_t* u,
+                                const uint8_t* v, unsigned int w,
+                                unsigned int h, unsigned int yStride,
+                                unsigned int uvStride, uint8_t* dest,
+                                unsigned int destStride );
+
+    /*
+     * Force a particular kernel, ie for benchmarking. Returns false (and
+     * leaves the selection alone) if the CPU or build doesn't support it.
+     * KERNEL_AUTO goes back to the best available. Not thread safe, so only
+     * call this before converting.
+     */
+    static bool setKernel( Kernel k );
+    static Kernel getKernel();
+    static bool isKernelSupported( Kernel k );
+    static const char* getKernelName( Kernel k );
+
+private:
+    // converts as much of a row as the kernel can, returning the number of
+    // pixels done (always even)
+    typedef unsigned int (*RowFunc)( const uint8_t* y, const uint8_t* u,
+                                        const uint8_t* v, uint8_t* dest,
+                                        unsigned int w );
+
+    static RowFunc rowFunc;
+    static Kernel kernel;
+
+    static Kernel detectKernel();
+
+};
+
+#endif /* COLORCONVERTER_H_ */
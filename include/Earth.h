@@ -28,6 +28,8 @@
 
 #include "GLUtil.h"
 
+#include <vector>
+
 class Earth
 {
 
@@ -37,6 +39,12 @@ public:
     void draw();
     void convertLatLong( float lat, float lon, float &ex, float &ey,
                         float &ez );
+    /*
+     * Same as above for a list of lat/long pairs (in degrees), into x,y,z
+     * triples - for converting all the markers at once.
+     */
+    void convertLatLongs( const std::vector<float>& latLongs,
+                            std::vector<float>& positions );
     void rotate( float x, float y, float z );
     float getX(); float getY(); float getZ();
     float getRadius();
@@ -54,6 +62,9 @@ private:
     // indicator of whether the object is in motion
     bool rotating;
     void animateValues();
+    // recalculate matrix from the position & rotation - on the CPU, so
+    // converting doesn't have to read anything back from GL
+    void updateMatrix();
 
     float x, y, z;
     float radius;
@@ -63,8 +74,9 @@ private:
 
     float moveAmt;
 
-    // keep track of the transformation matrix to use with lat/long conversion
-    GLdouble* matrix;
+    // keep track of the transformation matrix to use with lat/long conversion,
+    // column major like GL's. only changes when the rotation does
+    float matrix[16];
 
 };
 
@@ -0,0 +1,115 @@
+/*
+ * @file FramePipeline.h
+ *
+ * Definition of the FramePipeline class, a pool of worker threads that does
+ * the per-frame processing of decoded video (downscaling etc.) off of the
+ * network/decoding threads, so one session with many streams can have its
+ * sources processed in parallel.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEPIPELINE_H_
+#define FRAMEPIPELINE_H_
+
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <wx/thread.h>
+
+#include <VPMedia/thread_helper.h>
+
+class VideoSource;
+
+class FramePipeline
+{
+
+public:
+    /*
+     * Start the given number of worker threads. With 0 threads, frames are
+     * processed right away on whatever thread reports them.
+     */
+    FramePipeline( int numThreads );
+    ~FramePipeline();
+
+    /*
+     * Sources have to be added before reporting frames, and removed before
+     * their sink goes away. Removing waits for the source's current job (if
+     * any) to finish, so it's safe to delete the source afterwards.
+     */
+    void addSource( VideoSource* s );
+    void removeSource( VideoSource* s );
+
+    /*
+     * Called from the decoding thread when a source has a new frame. The
+     * source gets queued for processing if it isn't already; since the sink
+     * only holds the latest frame, frames that come in while the source is
+     * queued get folded into that one job. A source is only ever processed
+     * by one worker at a time, so its frames stay in order.
+     */
+    void frameReady( VideoSource* s );
+
+    /*
+     * Per-source stats, for tuning: number of frames reported but not
+     * processed yet, average time (in ms) from a frame being reported to it
+     * being processed, and total frames processed & folded into a later job.
+     */
+    int getQueueDepth( VideoSource* s );
+    float getAverageLatency( VideoSource* s );
+    long getProcessedCount( VideoSource* s );
+    long getCoalescedCount( VideoSource* s );
+
+    int getThreadCount();
+
+private:
+    typedef struct {
+        // frames reported since the source was last picked up
+        int pending;
+        // when the oldest of those was reported
+        double firstPendingTime;
+        // in the ready queue / being processed by a worker
+        bool queued;
+        bool running;
+        // removeSource has been called & is waiting for the job to finish
+        bool removing;
+        float avgLatency;
+        long processed;
+        long coalesced;
+    } SourceState;
+
+    static void* threadMain( void* args );
+    void workerLoop();
+
+    // protects everything below - the conditions wake up workers when
+    // sources are queued & removers when a source's job finishes
+    wxMutex pipelineMutex;
+    wxCondition workAvailable;
+    wxCondition jobDone;
+
+    std::map<VideoSource*, SourceState> states;
+    // sources waiting for a worker, oldest first
+    std::deque<VideoSource*> ready;
+
+    std::vector<thread*> workers;
+    bool running;
+
+};
+
+#endif /* FRAMEPIPELINE_H_ */
@@ -0,0 +1,72 @@
+/*
+ * @file FrameScaler.h
+ *
+ * Definition of the FrameScaler class, which downscales decoded video frames
+ * (RGB24 or planar YUV420) into its own buffer with libswscale.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMESCALER_H_
+#define FRAMESCALER_H_
+
+#include <VPMedia/VPMedia_config.h>
+#include <VPMedia/video/format.h>
+
+struct SwsContext;
+
+class FrameScaler
+{
+
+public:
+    FrameScaler();
+    ~FrameScaler();
+
+    /*
+     * Scale a frame to the given size. Output is in the same format and
+     * layout as the input (ie, packed RGB24, or Y then U then V planes for
+     * YUV420). Returns false if the format isn't supported or the scale
+     * failed.
+     */
+    bool scale( const unsigned char* src, unsigned int srcWidth,
+                unsigned int srcHeight, VPMVideoFormat format,
+                unsigned int destWidth, unsigned int destHeight );
+
+    unsigned char* getData();
+    unsigned int getWidth();
+    unsigned int getHeight();
+    VPMVideoFormat getFormat();
+
+    /*
+     * Drop the current output, ie, go back to not having a frame.
+     */
+    void reset();
+
+private:
+    SwsContext* context;
+
+    unsigned char* buffer;
+    unsigned int bufferSize;
+
+    unsigned int width, height;
+    VPMVideoFormat format;
+
+};
+
+#endif /* FRAMESCALER_H_ */
@@ -47,6 +47,13 @@ public:
     void resize( wxSizeEvent& evt );
     void GLreshape( int w, int h );
 
+    /*
+     * Set the viewport & camera for drawing grav's scene at the given size,
+     * & tell grav the new size. Also used for headless rendering, where
+     * there's no canvas.
+     */
+    static void setupView( gravManager* grav, int w, int h );
+
     void stopTimer();
     void setTimer( RenderTimer* t );
 
@@ -65,9 +72,6 @@ private:
     void testDraw();
     void testKey( wxKeyEvent& evt );
 
-    // tracks the aspect ratio of the screen for reshaping
-    float screen_width, screen_height;
-
     // if draw is being called by a timer, have a reference to it so we can stop
     // it if need be
     RenderTimer* renderTimer;
@@ -40,6 +40,8 @@
 #include "Point.h"
 
 class RectangleBase;
+class SDFFont;
+class TextMetrics;
 
 class GLUtil
 {
@@ -101,18 +103,48 @@ public:
                                     Point& intersect );
 
     /**
-     * Uses GLEW to load a shader (vert and frag) from the string and returns a
-     * reference to the program.
+     * Uses GLEW to load a shader (vert and frag) from the strings and returns
+     * a reference to the program.
      */
-    GLuint loadShaders( const char* location );
+    GLuint loadShaders( const GLchar* vert, const GLchar* frag );
 
     GLuint getYUV420Program();
     GLuint getYUV420xOffsetID();
     GLuint getYUV420yOffsetID();
     GLuint getYUV420alphaID();
 
+    /*
+     * Program for YUV420 stored as three separate exact-size textures, one per
+     * plane, bound to texture units 0 (Y), 1 (U) and 2 (V).
+     */
+    GLuint getYUV420PlanarProgram();
+    GLuint getYUV420PlanaralphaID();
+
+    /*
+     * Versions of the above for drawing many videos from one vertex buffer:
+     * the offsets come from texture coordinate set 1 and the alpha from the
+     * vertex color rather than uniforms, so nothing changes between videos
+     * but the bound textures. 0 if not available.
+     */
+    GLuint getYUV420BatchProgram();
+    GLuint getYUV420PlanarBatchProgram();
+
     FTFont* getMainFont();
 
+    /*
+     * Distance field version of the main font, which all text should go
+     * through if it's there - NULL if it isn't (no GL 2.0, or disabled), in
+     * which case use the main font.
+     */
+    SDFFont* getTextFont();
+    void setSDFTextEnable( bool es );
+
+    /*
+     * Glyph metrics for the main font, for measuring text without FTGL or
+     * GL. NULL if they couldn't be loaded.
+     */
+    const TextMetrics* getTextMetrics();
+
     /*
      * Returns whether shaders are available to use or not.
      * Note shader enable needs to be set before initGL is called for the
@@ -122,8 +154,50 @@ public:
 
     void setShaderEnable( bool es );
 
+    /*
+     * Whether textures can have non-power-of-two dimensions, ie, whether video
+     * textures can be allocated at the exact size of the video.
+     */
+    bool areNPOTTexturesAvailable();
+
+    /*
+     * Whether YUV420 video can be stored as three exact-size planes (needs
+     * both shaders and NPOT textures) rather than packed into one padded
+     * texture.
+     */
+    bool isPlanarYUVAvailable();
+
+    /*
+     * Returns whether pixel buffer objects can be used for asynchronous
+     * texture uploads. Like the shader enable, PBO enable needs to be set
+     * before initGL is called.
+     */
+    bool arePBOsAvailable();
+
+    void setPBOEnable( bool ep );
+
+    /*
+     * Whether mip levels can be generated for textures on the GPU, via
+     * glGenerateMipmap (GL 3.0 or ARB/EXT framebuffer objects).
+     */
+    bool areMipmapsAvailable();
+
+    /*
+     * Regenerate the mip levels of the currently bound 2D texture from its
+     * base level. Only call if mipmaps are available.
+     */
+    void generateMipmaps();
+
     void setBufferFontUsage( bool buf );
 
+    /*
+     * Roughly how many screen pixels a world unit covers on the z=0 plane
+     * from the default camera position, for sizing things that get
+     * rasterized (ie, title textures). 0 if not known yet.
+     */
+    void setPixelScale( float s );
+    float getPixelScale();
+
 protected:
     GLUtil();
     ~GLUtil();
@@ -138,19 +212,47 @@ private:
 
     const GLchar* frag420;
     const GLchar* vert420;
+    const GLchar* frag420Planar;
+    const GLchar* vert420Planar;
+    const GLchar* frag420Batch;
+    const GLchar* vert420Batch;
+    const GLchar* frag420PlanarBatch;
+    const GLchar* vert420PlanarBatch;
 
     bool shadersAvailable;
     bool enableShaders;
 
+    bool PBOsAvailable;
+    bool enablePBOs;
+
     GLuint YUV420Program;
     GLuint YUV420xOffsetID;
     GLuint YUV420yOffsetID;
     GLuint YUV420alphaID;
 
+    bool NPOTAvailable;
+    bool planarYUVAvailable;
+
+    bool mipmapsAvailable;
+    // only have the EXT version of glGenerateMipmap
+    bool useEXTMipmaps;
+
+    GLuint YUV420PlanarProgram;
+    GLuint YUV420PlanaralphaID;
+
+    GLuint YUV420BatchProgram;
+    GLuint YUV420PlanarBatchProgram;
+
     FTFont* mainFont;
     // switch to change to use buffer font - texture font is default
     bool useBufferFont;
 
+    SDFFont* textFont;
+    TextMetrics* textMetrics;
+    bool enableSDFText;
+
+    float pixelScale;
+
 };
 
 #endif /*GLUTIL_H_*/
@@ -40,6 +40,8 @@ public:
     ~Group();
 
     virtual void draw();
+    virtual void batchBorder( BatchRenderer* b );
+    virtual bool canBatchBorder();
 
     void add( RectangleBase* object );
     virtual void remove( RectangleBase* object, bool move = true );
@@ -63,6 +65,12 @@ public:
 
     void setRendering( bool r );
 
+    /*
+     * Whether the group is currently hiding its members (ie, members are
+     * drawn fully transparent), like the runway when it's disabled.
+     */
+    bool isHidingMembers();
+
 protected:
     std::vector<RectangleBase*> objects;
     float buffer;
@@ -0,0 +1,86 @@
+/*
+ * @file OffscreenContext.h
+ *
+ * Definition of the OffscreenContext class, a GL context that renders to an
+ * offscreen buffer instead of a window, for running grav headless.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OFFSCREENCONTEXT_H_
+#define OFFSCREENCONTEXT_H_
+
+#include "GLUtil.h"
+
+#ifdef GRAV_HAVE_EGL
+#include <EGL/egl.h>
+#endif
+
+/*
+ * Uses EGL, so it doesn't need an X server, and works with Mesa's software
+ * renderer (llvmpipe) when there's no GPU. Where possible it's a pbuffer
+ * surface; otherwise it's a surfaceless context rendering into an FBO, which
+ * gets set up by initTarget() once GLEW is initialised.
+ *
+ * Only available if grav was built with EGL (GRAV_HAVE_EGL).
+ */
+class OffscreenContext
+{
+
+public:
+    OffscreenContext();
+    ~OffscreenContext();
+
+    /*
+     * Create the context with a buffer of the given size & make it current.
+     */
+    bool create( int w, int h );
+
+    /*
+     * Set up the FBO to render into, if there's no pbuffer. Needs to be after
+     * GLEW is initialised (ie, after GLUtil::initGL()).
+     */
+    bool initTarget();
+
+    /*
+     * Wait for everything drawn so far to actually be done, so frame timing
+     * includes the GL work, not just submitting it.
+     */
+    void finish();
+
+    int getWidth();
+    int getHeight();
+
+private:
+    int width;
+    int height;
+
+    GLuint fbo;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+
+#ifdef GRAV_HAVE_EGL
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+#endif
+
+};
+
+#endif /* OFFSCREENCONTEXT_H_ */
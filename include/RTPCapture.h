@@ -0,0 +1,133 @@
+/*
+ * @file RTPCapture.h
+ *
+ * Definition of the RTPCapture class, which records the RTP & RTCP packets
+ * arriving for grav's sessions to a file, so the same traffic can be played
+ * back later with RTPReplayer.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTPCAPTURE_H_
+#define RTPCAPTURE_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+#include <VPMedia/thread_helper.h>
+
+/*
+ * Capture file format, all integers big-endian:
+ *
+ *   "GRAVCAP1"
+ *   then any number of records, each starting with a type byte:
+ *
+ *   session (1): u16 id, u8 audio, u16 address length, address
+ *   packet (2):  u32 microseconds since the previous packet, u16 session id,
+ *                u8 channel (0 RTP, 1 RTCP), u16 length, packet data
+ *
+ * A session record always comes before the first packet for that session.
+ */
+namespace RTPCaptureFormat
+{
+    static const char magic[] = "GRAVCAP1";
+    static const int magicLength = 8;
+    static const uint8_t sessionRecord = 1;
+    static const uint8_t packetRecord = 2;
+    static const uint8_t channelRTP = 0;
+    static const uint8_t channelRTCP = 1;
+
+    /*
+     * Split a session address (host/port, possibly with more after that) into
+     * its host & port. Returns false if there's no port.
+     */
+    bool parseAddress( std::string address, std::string& host,
+                        unsigned int& port );
+}
+
+/*
+ * VPMedia doesn't give access to the packets it receives, so this opens its
+ * own sockets for each session's RTP & RTCP ports alongside VPMedia's, which
+ * for multicast means the kernel hands each socket its own copy of every
+ * packet. For unicast the packets would be split between the sockets instead,
+ * so unicast sessions don't get captured.
+ *
+ * A single thread receives on all the capture sockets & writes the file.
+ */
+class RTPCapture
+{
+
+public:
+    RTPCapture();
+    ~RTPCapture();
+
+    /*
+     * Create the capture file & start the capture thread.
+     */
+    bool open( std::string filename );
+
+    /*
+     * Start or stop capturing a session's traffic. Called by SessionManager
+     * as sessions get added & removed.
+     */
+    bool addSession( std::string address, bool audio );
+    void removeSession( std::string address );
+
+    /*
+     * Stop capturing & finish the file.
+     */
+    void close();
+
+private:
+    typedef struct {
+        std::string address;
+        uint16_t id;
+        int sockets[2];
+    } CaptureSession;
+
+    static void* threadMain( void* args );
+    void captureLoop();
+
+    int openSocket( std::string host, unsigned int port );
+    void writePacket( uint16_t id, uint8_t channel, const uint8_t* data,
+                        uint16_t length );
+
+    FILE* file;
+    std::string filename;
+
+    std::vector<CaptureSession> sessions;
+    // sockets of removed sessions, closed by the capture thread once it's
+    // not polling them
+    std::vector<int> closing;
+    uint16_t nextID;
+
+    double lastPacketTime;
+    unsigned long packetCount;
+    unsigned long byteCount;
+
+    // protects the session list & the file
+    mutex* captureMutex;
+    thread* captureThread;
+    volatile bool running;
+
+};
+
+#endif /* RTPCAPTURE_H_ */
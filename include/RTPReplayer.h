@@ -0,0 +1,145 @@
+/*
+ * @file RTPReplayer.h
+ *
+ * Definition of the RTPReplayer class, which plays back a file recorded by
+ * RTPCapture into local sessions, for repeatable testing with real traffic.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTPREPLAYER_H_
+#define RTPREPLAYER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <stdint.h>
+
+#include <VPMedia/thread_helper.h>
+
+/*
+ * Each session in the capture gets mapped to a unicast session on localhost
+ * (consecutive port pairs from the base port), which should be added to the
+ * SessionManager like any other session. The captured packets are then sent
+ * to those ports in their original order, either with their original timing
+ * (scaled by the speed) or as fast as the sessions take them, so the same
+ * traffic goes through the normal receive, decode & render path every time.
+ *
+ * Sending to localhost never blocks, so a receiver that falls behind just
+ * has packets dropped by the kernel. As fast as possible is throttled by
+ * watching the receiving sockets' queues (in /proc/net/udp & udp6), pausing
+ * while any of them backs up. Either way the kernel's drop count for the
+ * replay ports is logged at the end next to the number sent, so a lossy
+ * (ie, not reproducible) replay shows up in the results. If the stats can't
+ * be read for every replay port (ie, no /proc/net/udp), as fast as possible
+ * falls back to a fixed gap between packets & loss isn't reported.
+ */
+class RTPReplayer
+{
+
+public:
+    RTPReplayer( unsigned int basePort = 50000 );
+    ~RTPReplayer();
+
+    /*
+     * Read the list of sessions from a capture file. Returns false if it's
+     * not a valid capture.
+     */
+    bool load( std::string filename );
+
+    /*
+     * How fast to play back, as a multiple of the original rate. 0 means as
+     * fast as the sessions can take the packets.
+     */
+    void setSpeed( float s );
+
+    int getSessionCount();
+    // local address to add as a session for the given captured session
+    std::string getReplayAddress( int i );
+    std::string getOriginalAddress( int i );
+    bool isAudio( int i );
+
+    /*
+     * Start & stop sending. Stops by itself at the end of the capture.
+     */
+    void start();
+    void stop();
+    bool isFinished();
+
+private:
+    typedef struct {
+        std::string originalAddress;
+        std::string replayAddress;
+        bool audio;
+        unsigned int port;
+    } ReplaySession;
+
+    // what the kernel says about the sockets bound to a port: bytes waiting
+    // to be read & packets dropped because the buffer was full, & whether
+    // there were any sockets on it at all
+    typedef struct {
+        unsigned long queued;
+        unsigned long drops;
+        bool found;
+    } PortStats;
+
+    static void* threadMain( void* args );
+    void replayLoop();
+
+    /*
+     * Stats for the replay ports (RTP & RTCP) from /proc/net/udp & udp6,
+     * summed over all the sockets on each port. Returns false if they can't
+     * be read or any of the ports has no socket listed.
+     */
+    bool readPortStats( std::map<unsigned int, PortStats>& stats );
+    // add the sockets listed in one of the /proc/net/udp tables to stats.
+    // returns false if the table can't be read
+    bool readUDPTable( const char* path,
+                        std::map<unsigned int, PortStats>& stats );
+    unsigned long getTotalDrops( std::map<unsigned int, PortStats>& stats );
+    // wait (within reason) for the receivers to catch up, for as fast as
+    // possible mode. returns false if the stats can't be read
+    bool waitForReceivers();
+
+    // reads a whole record from the file. for packets, the data goes in the
+    // buffer & the fields get set; for sessions, they're added to the list
+    bool readRecord( uint8_t& type, uint32_t& delta, uint16_t& id,
+                        uint8_t& channel, std::vector<uint8_t>& data,
+                        bool addSessions );
+
+    FILE* file;
+    std::string filename;
+    unsigned int basePort;
+    float speed;
+
+    std::vector<ReplaySession> sessions;
+    // session ids in the file are indexes into sessions, but only once
+    // they're declared
+    std::vector<int> idMap;
+
+    thread* replayThread;
+    volatile bool running;
+    volatile bool finished;
+    // only complain about slow sessions once per replay
+    bool warnedStalled;
+
+};
+
+#endif /* RTPREPLAYER_H_ */
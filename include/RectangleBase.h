@@ -32,6 +32,7 @@
 #include "GLUtil.h"
 #include "Vector.h"
 #include "Ray.h"
+#include "TextMetrics.h"
 
 typedef struct {
     float R;
@@ -50,6 +51,8 @@ enum TextStyle {
 // reference each other
 class Group;
 class Point;
+class BatchRenderer;
+class TitleTexture;
 
 class RectangleBase
 {
@@ -255,6 +258,22 @@ public:
      */
     void drawBorder( float Xdist, float Ydist, float s, float t );
 
+    /*
+     * For drawing every border at once before any of the objects' contents:
+     * animates the object & adds its border to the batch, then the next
+     * draw() skips both. Only valid if canBatchBorder() is true, since the
+     * batch doesn't do rotation.
+     */
+    virtual void batchBorder( BatchRenderer* b );
+    virtual bool canBatchBorder();
+
+    /*
+     * The area covered by everything the object draws, border & title
+     * included, over both where it is now & where it's animating to.
+     */
+    void getDrawnExtent( float& left, float& right, float& bottom,
+                            float& top );
+
 protected:
     // position in world space (center of the object)
     float x,y,z;
@@ -285,6 +304,13 @@ protected:
     bool finalName;
     // if name ends up being wider than the object itself, cut off with ellipsis
     int cutoffPos;
+    // the name (or substring) measured a character at a time, so the cutoff
+    // can be found with a binary search instead of measuring again. kept
+    // until the name changes
+    std::string measuredName;
+    TextPrefixes namePrefixes;
+    // width the cutoff was last found for
+    float truncatedWidth;
 
     FTFont* font;
     FTBBox textBounds;
@@ -298,12 +324,35 @@ protected:
     // on the main thread
     bool nameSizeDirty;
 
+    // the title as drawn (substring, ellipsis, lock status), rebuilt when
+    // the text bounds are or the lock status changes
+    std::string renderedTitle;
+    bool titleDirty;
+    bool titleShowsUnlocked;
+    // renderedTitle rasterized, if titles can be & there's no distance
+    // field font - NULL until first drawn
+    TitleTexture* titleTexture;
+    // draw renderedTitle at the current position, with the distance field
+    // font or from the texture if possible. if batched, the title goes in
+    // the text batch at textX,textY relative to the center instead
+    void drawTitle( RGBAColor color, bool batched, float textX, float textY );
+    // bounding box of text in font units, from the metrics if there are any
+    FTBBox measureText( const std::string& text );
+    // update textBounds & cutoffPos from the cached measurements of the name,
+    // remeasuring it first if nameSizeDirty
+    void fitName( const TextMetrics* metrics );
+
     // size of the border relative to total size
     float borderScale;
     GLuint borderTex;
     // width/height of our border/background texture in
     // pixels
     int twidth, theight;
+    // color the border is drawn in, including the audio effect
+    RGBAColor getBorderDrawColor();
+
+    // set by batchBorder() for the next draw, which clears it
+    BatchRenderer* batch;
 
     bool selected;
     bool selectable;
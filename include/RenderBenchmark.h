@@ -0,0 +1,129 @@
+/*
+ * @file RenderBenchmark.h
+ *
+ * Definition of the RenderBenchmark class, which times grav's drawing when
+ * running headless, either for a single run or for a suite of cases across
+ * source counts, resolutions & layouts.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDERBENCHMARK_H_
+#define RENDERBENCHMARK_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+class gravManager;
+class SessionManager;
+class VideoListener;
+class OffscreenContext;
+
+/*
+ * Times are in milliseconds per frame, except the total which is in seconds.
+ * Draw time is gravManager::draw() plus waiting for the GL to finish;
+ * non-draw time is everything between draws (session iteration etc.), the
+ * same split GLCanvas keeps for the windowed version. Session CPU is what the
+ * session threads used over the run, as a percentage of one core, or -1 if
+ * they aren't running (ie, sessions are iterated as part of non-draw time).
+ */
+typedef struct {
+    unsigned int frames;
+    double totalTime;
+    double first;
+    double min;
+    double mean;
+    double median;
+    double p95;
+    double p99;
+    double max;
+    double drawTime;
+    double nonDrawTime;
+    double uploadBytes;
+    double sessionCPU;
+} FrameStats;
+
+/*
+ * The suite goes through every combination of source count (1 to 256),
+ * source resolution & layout (plain, runway, grid, site ID groups). Each case
+ * adds its own synthetic sources, so it's the real upload & draw path with no
+ * network involved, runs some warmup frames so textures are allocated &
+ * frames are flowing, then times the requested number of frames. Results go
+ * to a JSON file so runs can be compared between builds.
+ *
+ * Cases with more video than is sensible to hold in memory are listed as
+ * skipped rather than run.
+ */
+class RenderBenchmark
+{
+
+public:
+    RenderBenchmark( gravManager* g, SessionManager* sm, VideoListener* vl,
+                        OffscreenContext* o );
+
+    /*
+     * Whether sessions are on their own threads - if not, they get iterated
+     * before each frame, like the idle handler does.
+     */
+    void setThreads( bool t );
+
+    /*
+     * Minimum time between frames, in microseconds, 0 for as fast as
+     * possible.
+     */
+    void setFrameInterval( int us );
+
+    FrameStats runFrames( long frames );
+    void printStats( const FrameStats& stats );
+
+    /*
+     * Run all the cases with the given number of timed frames each & write
+     * the results to the given file.
+     */
+    bool runSuite( long frames, std::string filename );
+
+private:
+    typedef struct {
+        const char* name;
+        bool runway;
+        bool grid;
+        bool groups;
+    } Layout;
+
+    // total bytes uploaded by all current sources so far
+    uint64_t getUploadedBytes();
+
+    void writeCase( FILE* out, unsigned int count, unsigned int w,
+                    unsigned int h, const Layout& layout, bool skipped,
+                    const FrameStats& stats );
+    static std::string jsonString( std::string s );
+
+    gravManager* grav;
+    SessionManager* sessionManager;
+    VideoListener* listener;
+    OffscreenContext* offscreen;
+
+    bool threads;
+    int frameInterval;
+
+};
+
+#endif /* RENDERBENCHMARK_H_ */
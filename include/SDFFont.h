@@ -0,0 +1,130 @@
+/*
+ * @file SDFFont.h
+ *
+ * Definition of the SDFFont class, which draws text from a signed distance
+ * field glyph atlas so any size of text looks sharp from one small texture.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SDFFONT_H_
+#define SDFFONT_H_
+
+#include "GLUtil.h"
+#include "RectangleBase.h"
+#include "TextMetrics.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * The atlas is made once at startup with FreeType: each glyph (Latin-1) is
+ * rendered large, turned into a distance field & shrunk into the atlas. A
+ * small shader turns the distance back into a sharp, antialiased edge at
+ * whatever size the text ends up on screen.
+ *
+ * Layout comes from TextMetrics, so text is measured there, in the same units
+ * as the FTGL main font (FaceSize 100), & positioned the same way, ie with
+ * getTextScale().
+ *
+ * Text can either be drawn straight away under the current matrix (render),
+ * or added in world space to the batch (addText) that gets drawn in one go
+ * with flush(). Main thread only.
+ */
+class SDFFont
+{
+
+public:
+    SDFFont();
+    ~SDFFont();
+
+    /*
+     * Build the atlas from the given font file, for the glyphs metrics has,
+     * & set up the texture & shader. metrics has to be loaded from the same
+     * file & outlive this. Needs a GL context with shaders (GL 2.0). Returns
+     * false if any of that fails, in which case text should go through FTGL
+     * instead.
+     */
+    bool load( const std::string& file, const TextMetrics* m );
+
+    /*
+     * Draw text now, with the current modelview & the origin at the start of
+     * the baseline, in font units.
+     */
+    void render( const std::string& text, RGBAColor color );
+
+    /*
+     * Add text to the batch, starting at x,y,z (world space) & scaled by
+     * scale world units per font unit.
+     */
+    void addText( const std::string& text, float x, float y, float z,
+                    float scale, RGBAColor color );
+
+    /*
+     * Draw & clear the batch. Needs the modelview matrix to be just the
+     * camera.
+     */
+    void flush();
+
+private:
+    typedef struct {
+        // where the quad goes relative to the pen position, in font units,
+        // including the distance field's padding
+        float left, bottom, right, top;
+        float s0, t0, s1, t1;
+    } Glyph;
+
+    typedef struct {
+        GLfloat x, y, z;
+        GLfloat s, t;
+        GLfloat r, g, b, a;
+    } Vertex;
+
+    // make the distance fields for all the glyphs & pack them. CPU only
+    bool buildAtlas( const std::string& file );
+    bool initGL();
+
+    // glyph for a codepoint, or the fallback if it isn't in the atlas
+    const Glyph& getGlyph( unsigned int codepoint );
+
+    void appendText( std::vector<Vertex>& dest, const std::string& text,
+                        float x, float y, float z, float scale,
+                        RGBAColor color );
+    void drawVertices( std::vector<Vertex>& verts );
+
+    const TextMetrics* metrics;
+
+    std::map<unsigned int, Glyph> glyphs;
+    Glyph fallback;
+
+    std::vector<unsigned char> atlas;
+    int atlasWidth, atlasHeight;
+
+    GLuint texid;
+    GLuint program;
+
+    std::vector<Vertex> batch;
+    std::vector<Vertex> immediate;
+
+    GLuint vbo;
+
+};
+
+#endif /* SDFFONT_H_ */
@@ -33,6 +33,9 @@ class VPMSession;
 class VideoListener;
 class AudioManager;
 class mutex;
+class thread;
+class SessionManager;
+class RTPCapture;
 
 #include <vector>
 
@@ -46,8 +49,26 @@ typedef struct {
     bool enabled;
     VPMSession* session;
     uint32_t sessionTS;
+    int shard;
 } SessionEntry;
 
+/*
+ * A subset of the sessions that gets iterated by a single thread. The mutex
+ * protects the list and is held while each one of its sessions is iterated
+ * (but not across a whole pass), so other threads can add, remove or modify
+ * sessions in between without stalling every shard.
+ */
+typedef struct {
+    std::vector<SessionEntry*> entries;
+    mutex* shardMutex;
+    thread* worker;
+    SessionManager* manager;
+    int index;
+    // CPU seconds used by the thread so far, sampled every few ms, -1 if not
+    // available
+    double cpuTime;
+} SessionShard;
+
 class SessionManager
 {
 
@@ -63,6 +84,11 @@ public:
     bool initSession( std::string addr, bool audio );
     bool removeSession( std::string addr );
 
+    /*
+     * Record the traffic of sessions added from now on. NULL to not capture.
+     */
+    void setCapture( RTPCapture* c );
+
     /*
      * Methods for modifying the secondary list for available video sessions.
      * Available video can be rotated through one at a time.
@@ -86,6 +112,31 @@ public:
     bool isEncryptionEnabled( std::string addr );
 
     /*
+     * Start a pool of threads to iterate the sessions, with the sessions
+     * split between them. Sessions added later go to the thread with the
+     * fewest sessions.
+     */
+    void startThreads( int numThreads );
+    void stopThreads();
+    bool areThreadsRunning();
+
+    /*
+     * Whether the session threads should iterate continuously rather than
+     * backing off when sessions look idle. Only really useful for comparing
+     * CPU usage against the old behavior.
+     */
+    void setBusyWait( bool b );
+
+    /*
+     * Total CPU seconds used by the session threads since they started, so
+     * the difference over a run gives how much they used during it (see
+     * RenderBenchmark). Returns -1 if not available.
+     */
+    double getThreadCPUTime();
+
+    /*
+     * Iterate every session on the calling thread, for when the thread pool
+     * isn't being used.
      * Returns true if there were enabled sessions to iterate.
      */
     bool iterateSessions();
@@ -97,9 +148,35 @@ public:
     void unlockSessions();
 
 private:
-    std::vector<SessionEntry> sessions;
+    /*
+     * Iterate the sessions in one shard. Returns the number of enabled
+     * sessions iterated.
+     */
+    int iterateShard( SessionShard* shard );
+
+    static void* threadMain( void* args );
+
+    /*
+     * Find a session by address. Sessions should be locked by the caller.
+     * Returns NULL if not found.
+     */
+    SessionEntry* findSession( std::string addr );
+
+    /*
+     * Create a number of empty shards, moving existing sessions over. Should
+     * only be done when the threads aren't running.
+     */
+    void createShards( int numShards );
+
+    // main list of sessions, for lookups - the shards point to the same
+    // entries. protected by sessionMutex, which should be locked before any
+    // shard mutex if both are needed
+    std::vector<SessionEntry*> sessions;
+    std::vector<SessionShard*> shards;
+
     VideoListener* videoSessionListener;
     AudioManager* audioSessionListener;
+    RTPCapture* capture;
     int videoSessionCount;
     int audioSessionCount;
 
@@ -109,7 +186,23 @@ private:
 
     mutex* sessionMutex;
     int lockCount;
-    bool pause;
+
+    bool threadsRunning;
+    bool busyWait;
+
+    // VPMedia doesn't expose the sessions' sockets, so the threads can't
+    // block on them directly. instead, a pass that takes longer than
+    // busyIterateTime (in microseconds) per session is taken to mean packets
+    // came in, and the thread checks again right away; otherwise it sleeps,
+    // doubling the sleep from minSleepTime up to maxSleepTime while things
+    // stay quiet. with no sessions at all it sleeps for emptySleepTime.
+    int busyIterateTime;
+    int minSleepTime;
+    int maxSleepTime;
+    int emptySleepTime;
+
+    // how often (in seconds) to update & log thread CPU usage
+    double statsInterval;
 
 };
 
@@ -0,0 +1,59 @@
+/*
+ * @file SourceKey.h
+ *
+ * Key for looking up RTP sources by session & SSRC in a hash table, since an
+ * SSRC is only unique within its session.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOURCEKEY_H_
+#define SOURCEKEY_H_
+
+#include <VPMedia/VPMedia_config.h>
+#include <VPMedia/VPMTypes.h>
+
+#include <tr1/unordered_map>
+#include <cstddef>
+
+class VPMSession;
+
+struct SourceKey
+{
+    SourceKey( VPMSession* s, uint32_t i ) : session( s ), ssrc( i ) { }
+
+    VPMSession* session;
+    uint32_t ssrc;
+
+    bool operator==( const SourceKey& other ) const
+    {
+        return session == other.session && ssrc == other.ssrc;
+    }
+};
+
+struct SourceKeyHash
+{
+    size_t operator()( const SourceKey& k ) const
+    {
+        // SSRCs are random already, so just mix in the session
+        return (size_t)k.ssrc ^ ( (size_t)k.session >> 4 );
+    }
+};
+
+#endif /* SOURCEKEY_H_ */
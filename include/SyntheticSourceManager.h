@@ -0,0 +1,133 @@
+/*
+ * @file SyntheticSourceManager.h
+ *
+ * Definition of the SyntheticSourceManager class, which makes video sources
+ * showing generated test patterns, for load testing without a network or
+ * real streams.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTHETICSOURCEMANAGER_H_
+#define SYNTHETICSOURCEMANAGER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <VPMedia/video/VPMVideoBufferSink.h>
+#include <VPMedia/thread_helper.h>
+
+class VideoListener;
+class VideoSource;
+class TripleBufferSink;
+
+/*
+ * Each synthetic source gets its own sink, but instead of a decoder copying
+ * frames in, a single producer thread writes moving color bars, a gradient &
+ * a bouncing box straight into the sink's write slot at the requested frame
+ * rate. From there frames go through the same callback, pipeline, upload &
+ * draw path as sources from a session, so the rest of grav can't tell the
+ * difference (other than there being no SDES or RTP stats).
+ *
+ * Sources that are muted or auto-paused don't get new frames generated, the
+ * same as disabling a real source stops its decoding.
+ */
+class SyntheticSourceManager
+{
+
+public:
+    SyntheticSourceManager( VideoListener* l );
+
+    /*
+     * Sinks are deleted here, so this needs to happen after the sources
+     * themselves are gone (ie, after gravManager's delayed delete).
+     */
+    ~SyntheticSourceManager();
+
+    /*
+     * Add sources from a spec in the format <count>x<width>x<height>[@fps],
+     * ie 64x1280x720@30. fps defaults to 30. Returns false if the spec isn't
+     * valid or sources were already added.
+     */
+    bool addSources( std::string spec );
+
+    /*
+     * Start & stop the thread that generates frames.
+     */
+    void start();
+    void stop();
+
+    /*
+     * Take all the sources out of grav. Should be stopped first.
+     */
+    void removeSources();
+
+    /*
+     * Give the sources site IDs, a new site every perSite sources, so they
+     * get put in site ID groups like real sites' videos.
+     */
+    void setSiteIDs( unsigned int perSite );
+
+    unsigned int getSourceCount();
+
+private:
+    typedef struct {
+        VideoSource* source;
+        TripleBufferSink* sink;
+        double nextFrameTime;
+        unsigned int frame;
+        // so the sources aren't all showing the same thing
+        unsigned int phase;
+    } SyntheticSource;
+
+    static void* threadMain( void* args );
+    void producerLoop();
+
+    void buildPatterns();
+    void generateFrame( SyntheticSource& s );
+    void generateYUV420( uint8_t* dest, unsigned int offset, int boxX,
+                            int boxY );
+    void generateRGB24( uint8_t* dest, unsigned int offset, int boxX,
+                            int boxY );
+
+    VideoListener* listener;
+    std::vector<SyntheticSource> sources;
+
+    unsigned int width;
+    unsigned int height;
+    float fps;
+    VPMVideoFormat format;
+
+    // pattern rows, twice the frame width so a scrolling window of them can
+    // be copied in with a single memcpy per row
+    std::vector<uint8_t> barRowY;
+    std::vector<uint8_t> barRowU;
+    std::vector<uint8_t> barRowV;
+    std::vector<uint8_t> barRowRGB;
+    std::vector<uint8_t> rampRowY;
+    std::vector<uint8_t> rampRowRGB;
+    unsigned int boxSize;
+
+    thread* producer;
+    volatile bool running;
+
+};
+
+#endif /* SYNTHETICSOURCEMANAGER_H_ */
@@ -0,0 +1,104 @@
+/*
+ * @file TextMetrics.h
+ *
+ * Definition of the TextMetrics class, which measures text in the main
+ * font's units without any GL calls, so it's cheap & works on any thread.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTMETRICS_H_
+#define TEXTMETRICS_H_
+
+#include <FTGL/ftgl.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * Bounding box of each prefix of a string (the first 1, 2, ... characters),
+ * so any prefix can be measured, or the longest one that fits in a width
+ * found, without laying the string out again.
+ */
+typedef struct {
+    // byte offset just past each character
+    std::vector<unsigned int> ends;
+    std::vector<float> left, right, bottom, top;
+} TextPrefixes;
+
+/*
+ * Glyph advances, inked areas & kerning are read with FreeType once at
+ * startup for the Latin-1 range, at the same scale as the FTGL main font
+ * (FaceSize 100), & looked up from then on. Text is UTF-8; characters
+ * outside the table are measured as '?'.
+ *
+ * Read-only after load(), so it's safe to use from any thread.
+ */
+class TextMetrics
+{
+
+public:
+    typedef struct {
+        float advance;
+        // inked area relative to the pen position, empty for spaces
+        float left, bottom, right, top;
+    } Glyph;
+
+    TextMetrics();
+
+    bool load( const std::string& file );
+
+    /*
+     * Same as FTFont::BBox(), in font units from the start of the baseline.
+     */
+    FTBBox BBox( const std::string& text ) const;
+
+    void measurePrefixes( const std::string& text,
+                            TextPrefixes& prefixes ) const;
+    static FTBBox getPrefixBBox( const TextPrefixes& prefixes,
+                                    unsigned int count );
+    /*
+     * Most characters from the start that fit in the given width, in font
+     * units - a binary search, since prefixes only get wider.
+     */
+    static unsigned int fitPrefix( const TextPrefixes& prefixes,
+                                    float width );
+
+    // codepoints that have glyphs, for building atlases from
+    std::vector<unsigned int> getCodepoints() const;
+
+    /*
+     * Next codepoint in a UTF-8 string, advancing i.
+     */
+    static unsigned int decodeUTF8( const std::string& text,
+                                    unsigned int& i );
+    // glyph for a codepoint, or '?' if it isn't in the table
+    const Glyph& getGlyph( unsigned int codepoint ) const;
+    float getKerning( unsigned int left, unsigned int right ) const;
+
+private:
+    std::map<unsigned int, Glyph> glyphs;
+    Glyph fallback;
+    // keyed by ( left << 16 ) | right, only the non-zero pairs
+    std::map<unsigned int, float> kerning;
+
+};
+
+#endif /* TEXTMETRICS_H_ */
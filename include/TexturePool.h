@@ -0,0 +1,104 @@
+/*
+ * @file TexturePool.h
+ *
+ * Definition of the TexturePool class, which keeps video textures released
+ * by deleted or resized videos around (grouped by size & format) so they can
+ * be handed out again without reallocating.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTUREPOOL_H_
+#define TEXTUREPOOL_H_
+
+#include <map>
+#include <vector>
+
+#include "GLUtil.h"
+
+/*
+ * All functions here do GL calls, so should only be used on the main thread.
+ */
+class TexturePool
+{
+
+public:
+    TexturePool();
+    ~TexturePool();
+
+    /*
+     * Get a texture of exactly the given size & internal format, filled with
+     * gray and left bound. Reuses a released one if there's one in that
+     * bucket, otherwise generates a new one. Texture parameters are left as
+     * they were, so callers should set their own.
+     */
+    GLuint acquire( unsigned int w, unsigned int h, GLint internalFormat );
+
+    /*
+     * Give a texture back to the pool. If the pool is already holding as much
+     * as it's allowed to, the texture just gets deleted.
+     */
+    void release( GLuint tex, unsigned int w, unsigned int h,
+                    GLint internalFormat );
+
+    /*
+     * Delete all pooled textures.
+     */
+    void clear();
+
+private:
+    typedef struct {
+        unsigned int width;
+        unsigned int height;
+        GLint internalFormat;
+    } TextureKey;
+
+    struct KeyCompare
+    {
+        bool operator()( const TextureKey& a, const TextureKey& b ) const;
+    };
+
+    std::map<TextureKey, std::vector<GLuint>, KeyCompare> freeTextures;
+
+    // rough total size of the textures being held, and the most we'll hold
+    unsigned long pooledBytes;
+    unsigned long maxPooledBytes;
+
+    unsigned long hits;
+    unsigned long misses;
+
+    /*
+     * Fill the bound texture with gray. The gray comes from a buffer object
+     * that only gets filled when it needs to grow, so it's a copy on the GPU
+     * side rather than building & sending a buffer from the CPU every time.
+     * Without PBOs it falls back to a (kept around) client-side buffer.
+     */
+    void fillGray( unsigned int w, unsigned int h, GLint internalFormat,
+                    bool allocate );
+
+    GLuint grayBuffer;
+    unsigned int grayBufferSize;
+    std::vector<GLubyte> grayClientBuffer;
+
+    static unsigned long getByteSize( unsigned int w, unsigned int h,
+                                        GLint internalFormat );
+
+};
+
+#endif /* TEXTUREPOOL_H_ */
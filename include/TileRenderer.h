@@ -0,0 +1,111 @@
+/*
+ * @file TileRenderer.h
+ *
+ * Definition of the TileRenderer class, which draws the video textures of
+ * many VideoSources together, grouped by pixel format.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILERENDERER_H_
+#define TILERENDERER_H_
+
+#include "GLUtil.h"
+
+#include <vector>
+
+/*
+ * Each tile is an axis-aligned quad in world space with its own textures,
+ * texture coordinate scale & alpha. Those per-tile values go into one shared
+ * vertex buffer, so on flush each format costs one program bind & buffer
+ * setup, and each tile only a texture bind & a draw - no matrix pushes,
+ * uniforms or immediate mode.
+ *
+ * Tiles are drawn alpha blended (tiles that aren't fading just have an alpha
+ * of 1), in format order & then the order they were added, so they mustn't
+ * overlap each other. Only used on the main thread, from gravManager::draw().
+ */
+class TileRenderer
+{
+
+public:
+    enum Format
+    {
+        // RGBA textures (CPU-converted, or no shaders), fixed function
+        FORMAT_RGB = 0,
+        // YUV420 packed into one padded luminance texture
+        FORMAT_YUV420,
+        // YUV420 as three exact-size planes
+        FORMAT_YUV420_PLANAR,
+        NUM_FORMATS
+    };
+
+    TileRenderer();
+    ~TileRenderer();
+
+    /*
+     * Whether tiles of the given format can be drawn here - if not, they
+     * need to be drawn individually.
+     */
+    bool isFormatAvailable( Format f );
+
+    /*
+     * s & t are the texture coordinates of the top right corner, as well as
+     * the offsets the packed YUV shader needs. uTex & vTex are only used for
+     * planar tiles.
+     */
+    void addTile( Format f, float left, float bottom, float right, float top,
+                    float z, float s, float t, float alpha, GLuint tex,
+                    GLuint uTex = 0, GLuint vTex = 0 );
+
+    /*
+     * Draw all the tiles added so far & clear them. Needs the modelview
+     * matrix to be just the camera.
+     */
+    void flush();
+
+private:
+    typedef struct {
+        GLfloat x, y, z;
+        GLfloat s, t;
+        // texcoord set 1: the packed shader's x & y offsets
+        GLfloat os, ot;
+        GLfloat r, g, b, a;
+    } Vertex;
+
+    typedef struct {
+        GLuint textures[3];
+    } Tile;
+
+    GLuint getProgram( Format f );
+    void addVertex( Format f, float x, float y, float z, float s, float t,
+                    float os, float ot, float alpha );
+
+    std::vector<Tile> tiles[NUM_FORMATS];
+    // vertices are kept per format too, so each format's tiles are
+    // contiguous in the buffer
+    std::vector<Vertex> formatVertices[NUM_FORMATS];
+    std::vector<Vertex> vertices;
+
+    GLuint vbo;
+    bool vboChecked;
+
+};
+
+#endif /* TILERENDERER_H_ */
@@ -30,6 +30,7 @@
 
 class SessionTreeControl;
 class GLCanvas;
+class VideoInfoDialog;
 
 class RenderTimer : public wxTimer
 {
@@ -71,4 +72,16 @@ private:
 
 };
 
+class VideoInfoTimer : public wxTimer
+{
+
+public:
+    VideoInfoTimer( VideoInfoDialog* d );
+    void Notify();
+
+private:
+    VideoInfoDialog* dialog;
+
+};
+
 #endif /* TIMERS_H_ */
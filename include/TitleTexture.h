@@ -0,0 +1,88 @@
+/*
+ * @file TitleTexture.h
+ *
+ * Definition of the TitleTexture class, which holds an object's title text
+ * rasterized into a texture so it can be drawn as a single quad.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TITLETEXTURE_H_
+#define TITLETEXTURE_H_
+
+#include "GLUtil.h"
+
+#include <string>
+
+/*
+ * The text is rendered once with FTGL into a framebuffer object, in white
+ * with the glyph coverage as alpha, and only again when the text, font or
+ * scale changes. Drawing modulates it with the current color, so it comes
+ * out the same as font->Render() would, at the same position (ie, in font
+ * units, with the origin at the start of the baseline).
+ *
+ * Main thread only, since it does GL calls.
+ */
+class TitleTexture
+{
+
+public:
+    TitleTexture();
+    ~TitleTexture();
+
+    /*
+     * Whether titles can be rendered to textures at all (needs framebuffer
+     * objects).
+     */
+    static bool isAvailable();
+
+    /*
+     * Make sure the texture holds the given text, at scale texture pixels
+     * per font unit. Returns false if it couldn't be rendered, in which case
+     * the text should be rendered directly.
+     */
+    bool update( FTFont* font, const std::string& text, float scale );
+
+    /*
+     * Draw the text as of the last successful update.
+     */
+    void draw();
+
+private:
+    // rasterize the current text into the texture
+    bool render();
+
+    FTFont* font;
+    std::string text;
+    float scale;
+
+    GLuint texid;
+    int texWidth, texHeight;
+    // size actually covered by the text, in pixels
+    int pixelWidth, pixelHeight;
+    // where the texture goes in font units
+    float left, bottom, right, top;
+
+    // shared by all titles, since they're only bound while rendering
+    static GLuint fbo;
+    static bool useEXT;
+
+};
+
+#endif /* TITLETEXTURE_H_ */
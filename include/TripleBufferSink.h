@@ -0,0 +1,138 @@
+/*
+ * @file TripleBufferSink.h
+ *
+ * Definition of the TripleBufferSink class, a video sink that hands frames
+ * from the decoding thread to the rendering thread through three frame slots,
+ * so neither side ever has to wait on the other.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIPLEBUFFERSINK_H_
+#define TRIPLEBUFFERSINK_H_
+
+#include <VPMedia/video/VPMVideoBufferSink.h>
+
+/*
+ * Each new frame the base sink receives gets copied (on the decoding thread)
+ * into the writer's slot, which is then atomically swapped with the middle
+ * slot. The reader swaps the middle slot with its own when it wants the
+ * newest frame. So the writer always has a free slot, the reader always gets
+ * the most recent complete frame, and the only lock involved is the base
+ * sink's, which only the decoding thread touches.
+ *
+ * There's a single reader: whoever calls takeNewestFrame() owns the frame
+ * returned by the getFrame* functions until its next call.
+ *
+ * Frames can also be written directly (ie, by a synthetic source with no
+ * decoder) with getWriteBuffer() & publishFrame(), as long as there's only
+ * the one writer.
+ */
+class TripleBufferSink : public VPMVideoBufferSink
+{
+
+public:
+    TripleBufferSink( VPMVideoFormat format );
+    ~TripleBufferSink();
+
+    /*
+     * Callback for after a new frame is available to the reader, called on
+     * the decoding thread. This replaces addNewFrameCallback for users of
+     * this class, since callbacks registered that way may run before the
+     * frame gets copied into a slot.
+     */
+    void setFrameCallback( void (*callback)( VPMVideoSink*, int, void* ),
+                            void* userData );
+
+    /*
+     * Writer side: get the write slot, sized for a frame of the given
+     * dimensions in the sink's format, to fill in. It belongs to the writer
+     * until publishFrame() hands it to the reader.
+     */
+    uint8_t* getWriteBuffer( uint32_t w, uint32_t h );
+
+    /*
+     * Writer side: make the filled write slot the newest frame, then call the
+     * frame callback.
+     */
+    void publishFrame( int bufferIdx = 0 );
+
+    /*
+     * Reader side: swap in the newest complete frame if there's been one
+     * since the last call. Returns false (keeping the current frame) if not.
+     */
+    bool takeNewestFrame();
+
+    /*
+     * Whether takeNewestFrame() would get a new frame right now. Safe to call
+     * from any thread, but only a hint, since a frame can come in right after.
+     */
+    bool hasNewFrame();
+
+    /*
+     * The reader's current frame - stays valid & unchanged until the next
+     * takeNewestFrame(). Dimensions are 0x0 before the first frame.
+     */
+    uint8_t* getFrameData();
+    uint32_t getFrameWidth();
+    uint32_t getFrameHeight();
+    VPMVideoFormat getFrameFormat();
+
+    /*
+     * Frames copied in from the decoder, and frames that got replaced by a
+     * newer one before the reader took them.
+     */
+    unsigned long getPushedCount();
+    unsigned long getDroppedCount();
+
+private:
+    typedef struct {
+        uint8_t* data;
+        unsigned int size;
+        uint32_t width, height;
+    } FrameSlot;
+
+    FrameSlot slots[3];
+
+    // writer & reader slots are only touched by their own side. the middle
+    // index is swapped atomically, with newFrameFlag set while it holds a
+    // frame the reader hasn't taken yet
+    int writeSlot;
+    int readSlot;
+    volatile int middleSlot;
+    static const int newFrameFlag = 0x4;
+
+    VPMVideoFormat format;
+
+    void (*frameCallback)( VPMVideoSink*, int, void* );
+    void* frameCallbackData;
+
+    volatile unsigned long pushedCount;
+    volatile unsigned long droppedCount;
+
+    static void baseFrameCallback( VPMVideoSink* sink, int bufferIdx,
+                                    void* userData );
+    // copy the base sink's frame into the write slot & publish it
+    void pushFrame( int bufferIdx );
+
+    unsigned int getSizeFor( uint32_t w, uint32_t h );
+
+};
+
+#endif /* TRIPLEBUFFERSINK_H_ */
@@ -0,0 +1,101 @@
+/*
+ * @file UploadScheduler.h
+ *
+ * Definition of the UploadScheduler class, which decides each frame which
+ * videos get to push their new frames to GL, so a burst of new frames from
+ * lots of sources can't blow the frame time.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPLOADSCHEDULER_H_
+#define UPLOADSCHEDULER_H_
+
+#include <vector>
+
+class VideoSource;
+class AudioManager;
+class RectangleBase;
+
+/*
+ * Videos with a new frame waiting are ranked by how much they matter - how
+ * much of them is on screen, whether they're selected, whether their site is
+ * talking, and how long since they last got updated - and allowed to upload
+ * in that order until the per-frame byte budget is used up. The rest keep
+ * showing their current frame and try again next time, so low priority
+ * videos (ie, runway members) just update at a lower rate. Anything that's
+ * gone too long without an update gets let through regardless, as does the
+ * top video, so nothing on screen stalls completely. Videos that are off
+ * screen or covered don't upload at all.
+ *
+ * Only used on the main thread, from gravManager::draw().
+ */
+class UploadScheduler
+{
+
+public:
+    UploadScheduler();
+
+    /*
+     * Most bytes of video frames to push to textures per drawn frame. 0 means
+     * no limit.
+     */
+    void setBudget( unsigned long b );
+    unsigned long getBudget();
+
+    /*
+     * Allow or hold off uploads for this frame on each of the given sources.
+     * Only the part of each video inside the screen rect counts towards its
+     * priority, & ones with none of it showing are held off entirely. Audio
+     * is used for activity levels, & can be NULL.
+     */
+    void schedule( std::vector<VideoSource*>* sources, RectangleBase screen,
+                    AudioManager* audio );
+
+private:
+    typedef struct {
+        VideoSource* source;
+        unsigned int bytes;
+        float priority;
+        bool overdue;
+    } Candidate;
+
+    static bool compareCandidates( const Candidate& a, const Candidate& b );
+
+    // visibleArea is the part of the video on the screen, in world units
+    float getPriority( VideoSource* source, AudioManager* audio,
+                        float visibleArea, double staleness );
+
+    unsigned long budget;
+    // seconds without an update before a video gets pushed regardless of the
+    // budget
+    float maxStaleness;
+
+    // reused every frame to avoid reallocating
+    std::vector<Candidate> candidates;
+
+    // for periodic logging of how much is being held back
+    double statsTime;
+    unsigned long allowedCount;
+    unsigned long deferredCount;
+    unsigned long forcedCount;
+
+};
+
+#endif /* UPLOADSCHEDULER_H_ */
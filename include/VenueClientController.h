@@ -45,6 +45,9 @@ public:
     ~VenueClientController();
 
     void draw();
+    // the lines to the venues go between the background & the members, so
+    // the members' borders can't be drawn ahead of them
+    bool canBatchBorder();
 
     /*
      * These remove variants remove the member objects entirely (including
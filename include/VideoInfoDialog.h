@@ -29,15 +29,37 @@
 #include <wx/dialog.h>
 
 class RectangleBase;
+class VideoSource;
+class gravManager;
+class VideoInfoTimer;
+class wxStaticText;
 
 class VideoInfoDialog : public wxDialog
 {
 
 public:
-    VideoInfoDialog( wxWindow* parent, RectangleBase* o );
+    VideoInfoDialog( wxWindow* parent, RectangleBase* o, gravManager* g );
+    ~VideoInfoDialog();
+
+    /*
+     * Refresh the frame stats section - called periodically by the timer.
+     */
+    void updateStats();
+
+    void OnCloseWindow( wxCloseEvent& evt );
 
 private:
     RectangleBase* obj;
+    gravManager* grav;
+
+    // the video we're showing stats for, NULL if obj isn't a video. since
+    // the video can be deleted while the dialog is open, this is only used
+    // after checking that it's still in grav's list of sources
+    VideoSource* video;
+    wxStaticText* statsText;
+    VideoInfoTimer* timer;
+
+    DECLARE_EVENT_TABLE()
 
 };
 
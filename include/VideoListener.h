@@ -27,13 +27,19 @@
 #define VIDEOLISTENER_H_
 
 #include <VPMedia/VPMSession.h>
+#include <VPMedia/video/VPMVideoBufferSink.h>
 
 #include <sys/time.h>
+#include <string>
 
 class gravManager;
 class VPMVideoSink;
 class GLCanvas;
 class wxStopWatch;
+class FramePipeline;
+class mutex;
+class TripleBufferSink;
+class VideoSource;
 
 //static void newFrameCallbackTest( VPMVideoSink* sink, int buffer_idx,
 //                                void* user_data );
@@ -43,6 +49,51 @@ class VideoListener : public VPMSessionListener
 
 public:
     VideoListener( gravManager* g );
+    ~VideoListener();
+
+    /*
+     * Pipeline for new sources to process their frames on. If not set,
+     * frames get processed on the decoding thread.
+     */
+    void setPipeline( FramePipeline* p );
+
+    /*
+     * Whether new sources should get YUV420 from the decoder and convert it
+     * to RGBA themselves (with grav's SIMD converter, on the pipeline) when
+     * shaders aren't available, rather than having the decoder output RGB.
+     */
+    void setCPUConversion( bool c );
+
+    /*
+     * Format a new source's sink should take frames in, given what its
+     * decoder outputs. convert gets set to whether the source then needs to
+     * convert to RGBA itself.
+     */
+    VPMVideoFormat getSinkFormat( VPMVideoFormat decoderFormat,
+                                    bool* convert );
+
+    /*
+     * Create a video source for an already initialised sink and hand it to
+     * gravManager, placing it in the grid like any other new source. Used for
+     * sources from sessions & for ones generated locally, in which case
+     * session is NULL.
+     */
+    VideoSource* addSource( VPMSession* session, uint32_t ssrc,
+                            TripleBufferSink* sink, bool convert );
+
+    /*
+     * Take a source made with addSource out of the counts & queue it for
+     * deletion. The sink must stay valid until gravManager deletes it.
+     */
+    void removeSource( VideoSource* source );
+
+    /*
+     * Put a source in the site ID group for the given site, making the group
+     * if it's the first from that site - same as getting an RTCP APP site
+     * packet for it.
+     */
+    void setSiteID( VideoSource* source, std::string siteID );
+
     virtual void vpmsession_source_created( VPMSession &session,
                                           uint32_t ssrc,
                                           uint32_t pt,
@@ -66,6 +117,10 @@ public:
     void updatePixelCount( long mod );
 
 private:
+    void removeSourceLocked( VideoSource* source );
+    // needs gravManager's sources locked
+    void setSiteIDLocked( VideoSource* source, std::string siteID );
+
     gravManager* grav;
     wxStopWatch* timer;
 
@@ -78,6 +133,13 @@ private:
     int sourceCount;
     long pixelCount;
 
+    // callbacks can come in from multiple session threads at once, so this
+    // protects the counts & positions above
+    mutex* listenerMutex;
+
+    FramePipeline* pipeline;
+    bool cpuConversion;
+
 };
 
 #endif /*VIDEOLISTENER_H_*/
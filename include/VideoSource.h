@@ -31,16 +31,55 @@
 #include <VPMedia/VPMSession.h>
 #include <VPMedia/VPMedia_config.h>
 
+#include <VPMedia/thread_helper.h>
+
+#include <vector>
+
 #include "RectangleBase.h"
 
 class VideoListener;
+class TripleBufferSink;
+class FrameScaler;
+class FramePipeline;
+class TexturePool;
+
+/*
+ * Snapshot of a video's frame stats, for figuring out where choppiness comes
+ * from: frames coming out of the decoder, frames that got replaced by a newer
+ * one before making it to the texture, frames copied to GL, and frames
+ * actually in the texture when drawn. Rates are per second, times in
+ * milliseconds.
+ */
+typedef struct {
+    unsigned long decoded;
+    unsigned long dropped;
+    unsigned long uploaded;
+    unsigned long presented;
+    // total size of the frames pushed to the texture
+    uint64_t uploadedBytes;
+    float decodedRate;
+    float droppedRate;
+    float uploadedRate;
+    float presentedRate;
+    // smoothed variation in the time between decoded frames (RFC 3550 style)
+    float jitter;
+    // time since the last decoded frame, -1 if there hasn't been one
+    float lastFrameAge;
+    // frame processing pipeline backlog & report-to-processed time
+    int queueDepth;
+    float pipelineLatency;
+    // whether the texture currently has mip levels, and the average time to
+    // generate them after a new frame
+    bool mipmapped;
+    float mipmapTime;
+} VideoStats;
 
 class VideoSource : public RectangleBase
 {
 
 public:
     VideoSource( VPMSession* _session, VideoListener* l, uint32_t _ssrc,
-					VPMVideoBufferSink* vs, float x, float y );
+					TripleBufferSink* vs, float x, float y );
     ~VideoSource();
 
     void draw();
@@ -87,11 +126,101 @@ public:
     void toggleMute();
     bool isMuted();
 
+    /*
+     * Automatic pausing of decoding while the video isn't visible. This is
+     * tracked separately from the user's mute: the decoder only runs when the
+     * source is neither muted nor auto-paused, so neither overrides the other.
+     */
+    void setAutoPaused( bool p );
+    bool isAutoPaused();
+
+    /*
+     * Visibility as last determined by gravManager, plus the time it was
+     * last seen on screen, for applying the grace period before pausing.
+     */
+    void setVisible( bool v );
+    bool isVisible();
+    double getLastVisibleTime();
+
     // override RectangleBase::setRendering to account for muting
     void setRendering( bool r );
     // override RectangleBase::setSelectable to affect alpha usage
     void setSelectable( bool s );
 
+    /*
+     * Set how big the video is on screen, in pixels. If that's a good deal
+     * smaller than the native size, incoming frames get downscaled (on the
+     * decoding thread) to roughly that size before they're uploaded. Going
+     * back up to near native size switches back to native frames right away.
+     */
+    void setDisplaySize( unsigned int w, unsigned int h );
+
+    /*
+     * Callback for the video sink, called on the decoding thread when a new
+     * frame is decoded. User data should be the VideoSource.
+     */
+    static void newFrameCallback( VPMVideoSink* sink, int bufferIdx,
+                                    void* userData );
+
+    /*
+     * Hand new frames off to a pipeline to be processed on its worker
+     * threads, rather than processing them on the decoding thread. Setting
+     * it to NULL (or another pipeline) removes the source from the old one,
+     * waiting for any processing in progress to finish.
+     */
+    void setPipeline( FramePipeline* p );
+
+    /*
+     * Where to get video textures from & give them back to. Must be set
+     * before the first draw.
+     */
+    void setTexturePool( TexturePool* p );
+
+    /*
+     * Convert incoming YUV420 frames to RGBA with ColorConverter as part of
+     * processing them, and push those to an RGBA texture. For when the sink
+     * is YUV420 but there are no shaders to do the conversion on the GPU.
+     * Must be set before the source is first drawn.
+     */
+    void setCPUConversion( bool c );
+
+    /*
+     * Do any processing needed on the sink's current frame, ie downscaling
+     * it if we have a target size and converting it to RGBA. Called either
+     * from the decoding thread or a pipeline worker.
+     */
+    void processFrame();
+
+    /*
+     * Get the current frame stats. Safe to call from any thread.
+     */
+    VideoStats getStats();
+
+    /*
+     * For the upload scheduler: whether there's a frame waiting to be pushed,
+     * roughly how many bytes pushing it will take, and when a new frame was
+     * last pushed (0 if never).
+     */
+    bool hasPendingFrame();
+    unsigned int getUploadSize();
+    double getLastUploadTime();
+
+    /*
+     * Whether the next draw may push a new frame. If not, the video keeps
+     * showing its current frame and the new one waits (or gets replaced by a
+     * newer one). Resizes still push regardless.
+     */
+    void setUploadAllowed( bool a );
+
+    /*
+     * Whether to keep mip levels for the video texture(s), for when the video
+     * is drawn much smaller than its frames - avoids the aliasing (and poor
+     * texture cache use) of sampling full-size frames for a tiny tile, at
+     * the cost of regenerating the levels after each new frame. Ignored for
+     * packed YUV textures, since the levels would blend the planes together.
+     */
+    void setMipmapped( bool m );
+
 private:
     // reference to the session that this video comes from - needed for grabbing
     // metadata from RTCP/SDES
@@ -103,26 +232,157 @@ private:
     uint32_t ssrc;
 
     // the source of the video data
-    VPMVideoBufferSink* videoSink;
+    TripleBufferSink* videoSink;
 
     // original dimensions of the video
     unsigned int vwidth, vheight;
+    // dimensions of the frames actually being pushed to the texture - the
+    // same as the original unless we're downscaling
+    unsigned int fwidth, fheight;
+
+    // size to downscale incoming frames to, 0x0 for native size. this, the
+    // processed frame indices & flags below are shared with the frame
+    // processing thread, so are protected by scaleMutex - which is only held
+    // long enough to read or swap them
+    unsigned int targetWidth, targetHeight;
+    // only used by processFrame()
+    FrameScaler* scaler;
+    mutex* scaleMutex;
+
+    // when converting on the CPU, processed frames are RGBA (with rows always
+    // 4-byte aligned), otherwise they're just downscaled, in the sink's format
+    bool cpuConvert;
+
+    // a converted and/or downscaled frame, plus the native size of the frame
+    // it was made from
+    typedef struct {
+        std::vector<uint8_t> data;
+        unsigned int width, height;
+        unsigned int sourceWidth, sourceHeight;
+    } ProcessedFrame;
+    // triple buffered like the sink: processFrame() fills the write buffer &
+    // swaps it with the latest, draw() swaps the latest in as its read buffer,
+    // so neither has to wait for the other to finish with one
+    ProcessedFrame processedFrames[3];
+    int processedWrite, processedLatest, processedRead;
+    // whether the latest processed frame hasn't been taken by draw() yet
+    bool processedFrameNew;
+    // which side is using the sink's reader side - only matters right after
+    // switching between processed & native frames
+    bool processing;
+    bool drawReadingSink;
+
+    FramePipeline* pipeline;
+
+    // frame stats, updated from the decoding thread (decoded frame timing)
+    // and the main thread (uploads & draws), so protected by statsMutex.
+    // decoded & sink-dropped counts come from the sink itself
+    mutex* statsMutex;
+    unsigned long processedDropped;
+    unsigned long uploadedCount;
+    unsigned long presentedCount;
+    uint64_t uploadedBytes;
+    double lastFrameTime;
+    double lastFrameInterval;
+    float frameJitter;
+    // counts as of the last rate update, for working out the rates
+    double rateTime;
+    unsigned long rateCounts[4];
+    float rates[4];
+    double lastUploadTime;
+    void updateRates( double now );
+    void recordFrameDecoded();
 
     // aspect ratio of the video
     float aspect;
 
-    // remake the buffer when the video gets resized
-    void resizeBuffer();
+    // remake the buffer when the video or frame size changes
+    void resizeBuffer( unsigned int videoWidth, unsigned int videoHeight,
+                        unsigned int frameWidth, unsigned int frameHeight );
 
-    // dimensions rounded up to power of 2
+    /*
+     * Push a frame to the texture. If a pixel buffer object is bound, data is
+     * an offset into that buffer rather than a client memory pointer.
+     */
+    void uploadFrame( const GLubyte* data );
+
+    // size in bytes of a frame in the sink's format at the current dimensions
+    unsigned int getFrameSize();
+
+    /*
+     * Get a texture of the given size from the pool, set its parameters and
+     * fill it with gray.
+     */
+    GLuint createTexture( unsigned int w, unsigned int h,
+                            GLint internalFormat );
+
+    // give the current texture(s) back to the pool
+    void releaseTextures();
+
+    TexturePool* texturePool;
+
+    // dimensions of the allocated texture - rounded up to power of 2 unless
+    // NPOT textures are available
     unsigned int tex_width, tex_height;
 
-    // GL texture identifier
+    // GL texture identifier - in planar mode this holds the Y plane
     GLuint texid;
     bool init;
 
+    // whether YUV420 is stored as 3 separate exact-size plane textures rather
+    // than packed into the bottom of one padded texture
+    bool planar;
+    // U & V plane textures for planar mode
+    GLuint chromaTexids[2];
+    unsigned int chromaWidth, chromaHeight;
+
+    // ring of pixel buffer objects for asynchronous texture uploads: each
+    // draw pushes the frame copied into the current buffer on the previous
+    // draw, then copies the newest frame into the next one, so the texture
+    // update never has to wait on the copy out of client memory
+    static const int numPBOs = 2;
+    GLuint pbos[numPBOs];
+    int pboIndex;
+    // whether the current buffer holds a frame that hasn't been pushed yet
+    bool pboPending;
+    bool usePBOs;
+
+    // set by the upload scheduler each frame
+    bool uploadAllowed;
+
+    // mipmapping as requested, whether the current texture(s) are actually
+    // set up for it, and whether a frame was pushed since the levels were
+    // last generated
+    bool mipmapRequested;
+    bool mipmapActive;
+    bool mipmapsDirty;
+    // time spent generating levels & how many times, for stats. protected
+    // by statsMutex
+    double mipmapTime;
+    unsigned long mipmapCount;
+    // switch the filtering over if needed & regenerate the levels if
+    // there's a new frame. main thread only, after the texture push
+    void updateMipmaps();
+
+    // draw the video quad on its own, for when it can't go in a batch.
+    // drawX is whether the disabled X needs drawing here too
+    void drawTexture( float Xdist, float Ydist, float s, float t, bool drawX );
+
     // whether to apply color's alpha to video
     bool useAlpha;
+
+    // enable/disable the decoder based on the mute & auto-pause states
+    void updateDecoderState();
+
+    bool userMuted;
+    bool autoPaused;
+    bool visible;
+    double lastVisibleTime;
+    // when resuming from auto-pause, keep showing the last frame for a bit
+    // rather than the first few frames after the decoder restarts, which will
+    // be broken until the next keyframe comes in
+    double resumeTime;
+    float resumeSettleTime;
 };
 
 #endif /* VIDEOSOURCE_H_ */
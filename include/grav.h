@@ -48,6 +48,11 @@ class SessionManager;
 class VenueClientController;
 class Earth;
 class InputHandler;
+class FramePipeline;
+class SyntheticSourceManager;
+class RTPCapture;
+class RTPReplayer;
+class OffscreenContext;
 
 class gravApp : public wxApp
 {
@@ -64,6 +69,16 @@ private:
     virtual bool OnInit();
     virtual int OnExit();
 
+    /*
+     * In headless mode, skip the GUI parts of wx's setup & teardown (which
+     * need a display) and run a fixed number of frames instead of the event
+     * loop.
+     */
+    virtual bool Initialize( int& argc, wxChar** argv );
+    virtual bool OnInitGui();
+    virtual void CleanUp();
+    virtual int OnRun();
+
     DECLARE_EVENT_TABLE()
 
     void idleHandler( wxIdleEvent& evt );
@@ -80,14 +95,20 @@ private:
      */
     void mapRTP();
 
-    static void* threadTest( void* args );
-    bool isThreadRunning();
-    /**
-     * Calls iterate sessions on the session manager, but also sleeps if there
-     * was no iteration (to avoid CPU spin). Used when sessions are on separate
-     * thread.
+    /*
+     * The rest of OnInit for headless mode: GL & the manager get set up
+     * against an offscreen buffer, with no windows or trees.
+     */
+    bool initHeadless();
+    bool initGL();
+
+    /*
+     * Add the sessions & sources given on the command line, through the
+     * session tree if there is one.
      */
-    void iterateSessions();
+    void addInitialSources();
+    void addSession( std::string address, bool audio, bool available );
+    void setEncryptionKey( std::string address, std::string key );
 
     wxCmdLineParser parser;
 
@@ -116,8 +137,9 @@ private:
     VenueClientController* venueClientController;
 
     bool usingThreads;
-    bool threadRunning;
-    thread* VPMthread;
+    // number of threads to split sessions between
+    int sessionThreads;
+    bool sessionBusyWait;
 
     bool verbose;
     bool VPMverbose;
@@ -134,6 +156,28 @@ private:
 
     SessionManager* sessionManager;
 
+    // worker pool for processing decoded frames off the session threads
+    FramePipeline* framePipeline;
+    int pipelineThreads;
+
+    // locally generated test pattern videos, if any were asked for
+    SyntheticSourceManager* syntheticSources;
+    std::string syntheticSpec;
+
+    // recording incoming traffic, & playing back a recording
+    RTPCapture* capture;
+    std::string captureFile;
+    RTPReplayer* replayer;
+    std::string replayFile;
+    long int replaySpeed;
+
+    // rendering offscreen with no windows, for benchmarking
+    bool headless;
+    long int headlessFrames;
+    OffscreenContext* offscreen;
+    // where to write results from the benchmark suite, if running it
+    std::string benchmarkFile;
+
     bool haveVideoKey;
     bool haveAudioKey;
     std::string initialVideoKey;
@@ -143,7 +187,10 @@ private:
     bool headerSet;
 
     bool enableShaders;
+    bool disableCPUConvert;
     bool bufferFont;
+    bool disableSDFText;
+    bool disablePBOs;
 
     bool startFullscreen;
 
@@ -188,6 +235,25 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
             _("disables threading separation of graphics and network/decoding")
     },
 
+    {
+        wxCMD_LINE_OPTION, _("st"), _("session-threads"),
+            _("number of threads to split network/decoding of sessions "
+              "between (default 1)"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("sbw"), _("session-busy-wait"),
+            _("keep session threads iterating continuously instead of "
+              "sleeping when idle (for comparing CPU usage)")
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("pt"), _("pipeline-threads"),
+            _("number of threads for processing decoded frames (downscaling "
+              "etc.) - 0 to do it on the network/decoding threads (default "
+              "2)"), wxCMD_LINE_VAL_NUMBER
+    },
+
     {
         wxCMD_LINE_SWITCH, _("np"), _("no-python"),
             _("disables python tools, including Access Grid integration")
@@ -200,6 +266,13 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
               "to rendering thread)")
     },
 
+    {
+        wxCMD_LINE_SWITCH, _("ncc"), _("no-cpu-convert"),
+            _("without shaders, have the decoder output RGB rather than "
+              "converting YUV to RGBA with grav's SIMD converter on the "
+              "frame processing threads")
+    },
+
     {
         wxCMD_LINE_SWITCH, _("bf"), _("use-buffer-font"),
             _("enable buffer font rendering method - may save memory and be "
@@ -207,6 +280,18 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
               "for many objects")
     },
 
+    {
+        wxCMD_LINE_SWITCH, _("nsdf"), _("no-sdf-text"),
+            _("draw text with FTGL rather than from a signed distance field "
+              "glyph atlas")
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("npbo"), _("no-pbo"),
+            _("disable asynchronous texture uploads via pixel buffer objects "
+              "and push video frames to textures directly")
+    },
+
     {
         wxCMD_LINE_OPTION, _("ht"), _("header"), _("header string"),
             wxCMD_LINE_VAL_STRING
@@ -233,6 +318,70 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
             _("rearrange all objects in grid on source add/remove")
     },
 
+    {
+        wxCMD_LINE_SWITCH, _("nap"), _("no-auto-pause"),
+            _("don't automatically pause decoding of videos that are "
+              "off-screen or completely covered by other videos")
+    },
+
+    {
+        wxCMD_LINE_SWITCH, _("nds"), _("no-downscale"),
+            _("always upload videos at native resolution, rather than "
+              "downscaling videos that are drawn much smaller than that")
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("mm"), _("mipmaps"),
+            _("generate mipmaps for videos drawn narrower than [num] pixels, "
+              "to reduce aliasing when they're shrunk a lot (ie, in the "
+              "runway)"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("ub"), _("upload-budget"),
+            _("most KB of new video frames to push to textures per drawn "
+              "frame, prioritizing large, selected & talking videos - 0 for "
+              "no limit (default 8192)"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("ss"), _("synthetic-sources"),
+            _("add locally generated test pattern videos, for load testing "
+              "without a network, in the format [count]x[width]x[height]"
+              "[@fps] (ie, 64x1280x720@30)"), wxCMD_LINE_VAL_STRING
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("cap"), _("capture"),
+            _("record all RTP/RTCP packets received on multicast sessions "
+              "to the given file"), wxCMD_LINE_VAL_STRING
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("rp"), _("replay"),
+            _("play back a file recorded with --capture through local "
+              "sessions"), wxCMD_LINE_VAL_STRING
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("rps"), _("replay-speed"),
+            _("speed to play back captures at, as a multiple of real time - "
+              "0 for as fast as the sessions keep up (default 1)"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("hl"), _("headless"),
+            _("render [num] frames offscreen at the -sw/-sh size with no "
+              "windows, print timing & exit"), wxCMD_LINE_VAL_NUMBER
+    },
+
+    {
+        wxCMD_LINE_OPTION, _("bm"), _("benchmark"),
+            _("run the render benchmark suite headless (with -hl frames per "
+              "case) & write the results to the given JSON file"),
+            wxCMD_LINE_VAL_STRING
+    },
+
     {
         wxCMD_LINE_SWITCH, _("avl"), _("available-video-list"),
             _("add supplied video addresses to available list, rather than "
@@ -294,7 +443,8 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
 
     {
         wxCMD_LINE_PARAM, NULL, NULL, _("video address"),
-            wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_MULTIPLE
+            wxCMD_LINE_VAL_STRING,
+            wxCMD_LINE_PARAM_MULTIPLE | wxCMD_LINE_PARAM_OPTIONAL
     },
 
     {
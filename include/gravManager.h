@@ -32,6 +32,7 @@
 
 #include "RectangleBase.h"
 #include "GLCanvas.h"
+#include "SourceKey.h"
 
 #include <VPMedia/thread_helper.h>
 
@@ -39,6 +40,7 @@ class VideoSource;
 class Group;
 class VideoListener;
 class AudioManager;
+class UploadScheduler;
 class VPMSession;
 class VPMSessionFactory;
 class Earth;
@@ -49,6 +51,9 @@ class Runway;
 class VenueClientController;
 class Camera;
 class Point;
+class TexturePool;
+class BatchRenderer;
+class TileRenderer;
 
 class gravManager
 {
@@ -85,7 +90,8 @@ public:
 
     void drawCurvedEarthLine( float lat, float lon,
                               float destx, float desty, float destz );
-    void drawEarthPoint( float lat, float lon, float size );
+    // markers for where the objects are on the earth, drawn in one batch
+    void drawEarthPoints();
 
     void setBoxSelectDrawing( bool draw );
     int getWindowWidth(); int getWindowHeight();
@@ -134,15 +140,18 @@ public:
 
     /*
      * Manage sources in the main list of sources as well as in the lists of
-     * drawn & selected objects.
-     * Latter is an iterator so as not to have to loop through the list of
-     * sources twice - mainly because the delete-by-ssrc in videolistener
-     * needs to find its target that way.
-     * I.e., delete expects that the caller will find the source in the
-     * sources list itself.
+     * drawn & selected objects, and the session/SSRC index.
      */
     void addNewSource( VideoSource* s );
-    void deleteSource( std::vector<VideoSource*>::iterator si );
+    void deleteSource( VideoSource* s );
+
+    /*
+     * Look up a source by its session & SSRC via the index, rather than
+     * walking the list. Sources should be locked by the caller (or the
+     * caller should otherwise be sure sources aren't being added/removed).
+     * Returns NULL if not found.
+     */
+    VideoSource* findSource( VPMSession* session, uint32_t ssrc );
     void deleteGroup( Group* g );
     void addToDrawList( RectangleBase* obj );
     void removeFromLists( RectangleBase* obj, bool treeRemove = true );
@@ -198,6 +207,35 @@ public:
     void setGraphicsDebugMode( bool g );
     bool getGraphicsDebugMode();
 
+    /*
+     * Whether to automatically pause decoding for videos that are off-screen,
+     * hidden or fully covered by other videos.
+     */
+    void setAutoPause( bool a );
+    bool usingAutoPause();
+
+    /*
+     * Whether to downscale incoming frames for videos that are drawn much
+     * smaller than their native resolution.
+     */
+    void setDownscaling( bool d );
+    bool usingDownscaling();
+
+    /*
+     * Most bytes of new video frames to push to textures per drawn frame,
+     * with videos prioritized by size, selection, audio activity & how long
+     * they've been waiting. 0 for no limit.
+     */
+    void setUploadBudget( unsigned long b );
+    unsigned long getUploadBudget();
+
+    /*
+     * Generate mipmaps for videos drawn narrower than this many pixels, so
+     * heavily minified ones (ie, in the runway) don't alias. 0 to disable.
+     */
+    void setMipmapThreshold( unsigned int t );
+    unsigned int getMipmapThreshold();
+
     void toggleShowVenueClientController();
     bool isVenueClientControllerShown();
     bool isVenueClientControllerShowable();
@@ -211,7 +249,30 @@ private:
      */
     void doDelayedDelete();
 
+    /*
+     * Determine which videos are actually visible given the current camera
+     * and the draw order, and auto-pause/resume their decoding accordingly.
+     * Also passes on each video's on-screen size for downscaling.
+     * Needs the current camera transform to be set up, and sources to be
+     * locked.
+     */
+    void updateSourceVisibility();
+
+    /*
+     * Whether all the borders can be drawn in one batch before any object's
+     * contents, which only looks the same as drawing each object in turn if
+     * none of them overlap (or are rotated). Needs sources to be locked.
+     */
+    bool canBatchBorders();
+    bool objectsOverlap( std::vector<RectangleBase*>& objects );
+    // whether any of the group's members overlap, at any depth
+    bool membersOverlap( Group* g );
+
     std::vector<VideoSource*>* sources;
+    // same sources as above, keyed by session & SSRC for the session
+    // callbacks to find them quickly
+    std::tr1::unordered_map<SourceKey, VideoSource*, SourceKeyHash>
+        sourceIndex;
     std::vector<RectangleBase*>* drawnObjects;
     std::vector<RectangleBase*>* selectedObjects;
     std::map<std::string,Group*>* siteIDGroups;
@@ -273,6 +334,18 @@ private:
     RectangleBase earthRect;
     void recalculateRectSizes();
 
+    // video textures released by deleted or resized videos, for reuse. only
+    // used on the main thread (in draw & doDelayedDelete)
+    TexturePool* texturePool;
+
+    // decides which videos get to push new frames each draw
+    UploadScheduler* uploadScheduler;
+
+    // borders, runway & selection box geometry, drawn together
+    BatchRenderer* batchRenderer;
+    // video textures, when the borders are batched
+    TileRenderer* tileRenderer;
+
     // background texture for groups & video objects
     GLuint borderTex;
     int borderWidth;
@@ -302,6 +375,19 @@ private:
     bool graphicsDebugView;
     long pixelCount;
 
+    bool autoPause;
+    // how long (in seconds) a video has to be invisible before it gets paused,
+    // so things like quick pans or rearranges don't cause pause/resume churn
+    float autoPauseDelay;
+    // videos smaller than this on screen (in pixels) count as invisible
+    float minVisibleSize;
+
+    bool downscaling;
+
+    // on-screen width (in pixels) below which videos get mipmapped, 0 for
+    // never
+    unsigned int mipmapMaxSize;
+
 };
 
 #endif /*GRAVMANAGER_H_*/
@@ -73,6 +73,17 @@ public:
 
     static std::string getVersionString();
 
+    /*
+     * Wall clock time in seconds, for measuring intervals.
+     */
+    static double getTime();
+
+    /*
+     * CPU time (user + system, in seconds) used so far by the calling thread.
+     * Returns -1 where per-thread usage isn't available.
+     */
+    static double getThreadCPUTime();
+
 protected:
     gravUtil();
     ~gravUtil();
@@ -31,16 +31,18 @@
 #include <VPMedia/audio/linear/VPMLinear16Decoder.h>
 #include <VPMedia/audio/VPMAudioMeter.h>
 #include <VPMedia/VPMSession.h>
+#include <VPMedia/thread_helper.h>
 #include <cstdio>
+#include <algorithm>
 
 AudioManager::AudioManager()
 {
-
+    sourceMutex = mutex_create();
 }
 
 AudioManager::~AudioManager()
 {
-
+    mutex_free( sourceMutex );
 }
 
 float AudioManager::getLevel( std::string name, bool avg, bool cnames )
@@ -51,6 +53,7 @@ float AudioManager::getLevel( std::string name, bool avg, bool cnames )
     float temp = 0.0f;
     int count = 0;
 
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         if ( ( !cnames && sources[i]->siteID.compare( name ) == 0 ) ||
@@ -68,6 +71,7 @@ float AudioManager::getLevel( std::string name, bool avg, bool cnames )
         }
         // would fall to else clause if name was not found
     }
+    mutex_unlock( sourceMutex );
 
     if ( count == 1 )
         return temp;
@@ -84,12 +88,14 @@ float AudioManager::getLevelAvg( std::string name )
 
 void AudioManager::printLevels()
 {
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         gravUtil::logVerbose( "AudioManager::printLevels: "
                 "source: 0x%08x/%s: %f\n", sources[i]->ssrc,
                 sources[i]->siteID.c_str(), sources[i]->meter->level() );
     }
+    mutex_unlock( sourceMutex );
 }
 
 unsigned int AudioManager::getSourceCount()
@@ -99,6 +105,7 @@ unsigned int AudioManager::getSourceCount()
 
 void AudioManager::updateNames()
 {
+    mutex_lock( sourceMutex );
     for ( unsigned int i = 0; i < sources.size(); i++ )
     {
         char buffer[256];
@@ -110,6 +117,7 @@ void AudioManager::updateNames()
             sources[i]->cName = std::string( buffer );
         }
     }
+    mutex_unlock( sourceMutex );
 }
 
 void AudioManager::vpmsession_source_created( VPMSession &session,
@@ -131,7 +139,10 @@ void AudioManager::vpmsession_source_created( VPMSession &session,
 
         dec->connectAudioProcessor( m );
 
+        mutex_lock( sourceMutex );
         sources.push_back( a );
+        sourceIndex[ SourceKey( &session, ssrc ) ] = a;
+        mutex_unlock( sourceMutex );
         gravUtil::logVerbose( "AudioManager::vpmsession_source_created: "
                 "source added\n" );
     }
@@ -144,17 +155,21 @@ void AudioManager::vpmsession_source_deleted( VPMSession &session,
                                           uint32_t ssrc,
                                           const char *reason )
 {
-    std::vector<AudioSource*>::iterator it;
-    for ( it = sources.begin(); it != sources.end(); ++it )
+    mutex_lock( sourceMutex );
+    std::tr1::unordered_map<SourceKey, AudioSource*, SourceKeyHash>::iterator
+        it = sourceIndex.find( SourceKey( &session, ssrc ) );
+    if ( it != sourceIndex.end() )
     {
-        if ( (*it)->ssrc == ssrc )
-        {
-            delete (*it)->meter;
-            delete (*it);
-            sources.erase( it );
-            return;
-        }
+        AudioSource* a = it->second;
+        sourceIndex.erase( it );
+        std::vector<AudioSource*>::iterator si =
+            std::find( sources.begin(), sources.end(), a );
+        if ( si != sources.end() )
+            sources.erase( si );
+        delete a->meter;
+        delete a;
     }
+    mutex_unlock( sourceMutex );
 }
 
 void AudioManager::vpmsession_source_description( VPMSession &session,
@@ -179,12 +194,11 @@ void AudioManager::vpmsession_source_app(VPMSession &session,
 
     if ( appS.compare( "site" ) == 0 )
     {
-        for ( unsigned int i = 0; i < sources.size(); i++ )
-        {
-            if ( sources[i]->ssrc == ssrc )
-            {
-                sources[i]->siteID = dataS;
-            }
-        }
+        mutex_lock( sourceMutex );
+        std::tr1::unordered_map<SourceKey, AudioSource*, SourceKeyHash>::
+            iterator it = sourceIndex.find( SourceKey( &session, ssrc ) );
+        if ( it != sourceIndex.end() )
+            it->second->siteID = dataS;
+        mutex_unlock( sourceMutex );
     }
 }
@@ -0,0 +1,205 @@
+/*
+ * @file BatchRenderer.cpp
+ *
+ * Implementation of the BatchRenderer class. See BatchRenderer.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchRenderer.h"
+
+#include <cstddef>
+
+BatchRenderer::BatchRenderer()
+{
+    vbo = 0;
+    vboChecked = false;
+    tileRenderer = NULL;
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    if ( vbo != 0 )
+        glDeleteBuffersARB( 1, &vbo );
+}
+
+void BatchRenderer::addQuad( float left, float bottom, float right,
+                                float top, float z, RGBAColor color,
+                                GLuint texture, float s, float t )
+{
+    addVertex( left, bottom, z, 0.0f, 0.0f, color );
+    addVertex( left, top, z, 0.0f, t, color );
+    addVertex( right, top, z, s, t, color );
+    addVertex( right, bottom, z, s, 0.0f, color );
+    extendRun( GL_QUADS, texture, 4 );
+}
+
+void BatchRenderer::addLine( float x1, float y1, float x2, float y2, float z,
+                                RGBAColor color )
+{
+    addVertex( x1, y1, z, 0.0f, 0.0f, color );
+    addVertex( x2, y2, z, 0.0f, 0.0f, color );
+    extendRun( GL_LINES, 0, 2 );
+}
+
+void BatchRenderer::addPoint( float x, float y, float z, float size,
+                                RGBAColor color )
+{
+    addVertex( x, y, z, 0.0f, 0.0f, color );
+    extendRun( GL_POINTS, 0, 1, size );
+}
+
+void BatchRenderer::addOutline( float left, float bottom, float right,
+                                    float top, float z, RGBAColor color )
+{
+    addLine( left, bottom, left, top, z, color );
+    addLine( left, top, right, top, z, color );
+    addLine( right, top, right, bottom, z, color );
+    addLine( right, bottom, left, bottom, z, color );
+}
+
+void BatchRenderer::flush()
+{
+    if ( vertices.empty() )
+        return;
+
+    if ( !vboChecked )
+    {
+        if ( GLEW_ARB_vertex_buffer_object )
+            glGenBuffersARB( 1, &vbo );
+        vboChecked = true;
+    }
+
+    const GLubyte* base;
+    if ( vbo != 0 )
+    {
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, vbo );
+        // the whole thing gets replaced every flush, so let the driver give
+        // us fresh storage rather than waiting on the last draw
+        glBufferDataARB( GL_ARRAY_BUFFER_ARB,
+                            vertices.size() * sizeof( Vertex ), &vertices[0],
+                            GL_STREAM_DRAW_ARB );
+        base = NULL;
+    }
+    else
+    {
+        base = (const GLubyte*)&vertices[0];
+    }
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, x ) );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, s ) );
+    glColorPointer( 4, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, r ) );
+
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+    bool texturing = false;
+    GLuint boundTexture = 0;
+    GLfloat pointSize = 1.0f;
+    for ( unsigned int i = 0; i < runs.size(); i++ )
+    {
+        const Run& run = runs[i];
+        if ( run.mode == GL_POINTS && run.size != pointSize )
+        {
+            glPointSize( run.size );
+            pointSize = run.size;
+        }
+        if ( run.texture != 0 )
+        {
+            if ( !texturing )
+            {
+                glEnable( GL_TEXTURE_2D );
+                texturing = true;
+            }
+            if ( run.texture != boundTexture )
+            {
+                glBindTexture( GL_TEXTURE_2D, run.texture );
+                boundTexture = run.texture;
+            }
+        }
+        else if ( texturing )
+        {
+            glDisable( GL_TEXTURE_2D );
+            texturing = false;
+        }
+
+        glDrawArrays( run.mode, run.first, run.count );
+    }
+
+    if ( texturing )
+        glDisable( GL_TEXTURE_2D );
+    if ( pointSize != 1.0f )
+        glPointSize( 1.0f );
+    glDisable( GL_BLEND );
+
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_COLOR_ARRAY );
+    if ( vbo != 0 )
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 );
+
+    vertices.clear();
+    runs.clear();
+}
+
+void BatchRenderer::setTileRenderer( TileRenderer* t )
+{
+    tileRenderer = t;
+}
+
+TileRenderer* BatchRenderer::getTileRenderer()
+{
+    return tileRenderer;
+}
+
+void BatchRenderer::addVertex( float x, float y, float z, float s, float t,
+                                const RGBAColor& color )
+{
+    Vertex v;
+    v.x = x; v.y = y; v.z = z;
+    v.s = s; v.t = t;
+    v.r = color.R; v.g = color.G; v.b = color.B; v.a = color.A;
+    vertices.push_back( v );
+}
+
+void BatchRenderer::extendRun( GLenum mode, GLuint texture, GLsizei count,
+                                GLfloat size )
+{
+    if ( !runs.empty() && runs.back().mode == mode &&
+            runs.back().texture == texture && runs.back().size == size )
+    {
+        runs.back().count += count;
+        return;
+    }
+
+    Run run;
+    run.mode = mode;
+    run.texture = texture;
+    run.size = size;
+    run.first = vertices.size() - count;
+    run.count = count;
+    runs.push_back( run );
+}
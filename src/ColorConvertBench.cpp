@@ -0,0 +1,250 @@
+/*
+ * @file ColorConvertBench.cpp
+ *
+ * Standalone benchmark for ColorConverter: times each kernel the CPU supports
+ * against libswscale doing the same YUV420P -> RGB conversion the decoder
+ * does when shaders are off, at a few common video sizes. Also checks that
+ * the SIMD kernels give exactly the same output as the scalar one.
+ *
+ * Usage: grav-colorbench [seconds per test]
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ColorConverter.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+
+extern "C"
+{
+#include <libavutil/avutil.h>
+#include <libswscale/swscale.h>
+}
+
+// older ffmpeg only has the PIX_FMT_ names
+#if LIBAVUTIL_VERSION_INT < AV_VERSION_INT(51,42,0)
+#define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
+#define AV_PIX_FMT_RGB24 PIX_FMT_RGB24
+#define AV_PIX_FMT_RGBA PIX_FMT_RGBA
+#define AVPixelFormat PixelFormat
+#endif
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Frame with something like real video in it - gradients plus some noise, so
+ * chroma isn't constant.
+ */
+static void fillFrame( std::vector<uint8_t>& frame, unsigned int w,
+                        unsigned int h )
+{
+    frame.resize( w * h * 3 / 2 );
+    uint8_t* y = &frame[0];
+    uint8_t* u = y + w * h;
+    uint8_t* v = u + ( w / 2 ) * ( h / 2 );
+
+    for ( unsigned int row = 0; row < h; row++ )
+        for ( unsigned int col = 0; col < w; col++ )
+            y[ row*w + col ] = (uint8_t)( 16 + ( col * 219 ) / w +
+                                            ( rand() % 8 ) - 4 );
+    for ( unsigned int row = 0; row < h/2; row++ )
+    {
+        for ( unsigned int col = 0; col < w/2; col++ )
+        {
+            u[ row*(w/2) + col ] = (uint8_t)( 16 + ( row * 224 ) / ( h/2 ) );
+            v[ row*(w/2) + col ] = (uint8_t)( 240 - ( col * 224 ) / ( w/2 ) );
+        }
+    }
+}
+
+/*
+ * Run a conversion repeatedly for about the given time, returning average
+ * milliseconds per frame.
+ */
+template <class F>
+static double timeConversion( F convert, double duration )
+{
+    // warm up caches & any lazy setup
+    convert();
+
+    int frames = 0;
+    double start = getTime();
+    double elapsed = 0.0;
+    while ( elapsed < duration )
+    {
+        convert();
+        frames++;
+        elapsed = getTime() - start;
+    }
+    return elapsed * 1000.0 / frames;
+}
+
+struct SwscaleConversion
+{
+    SwsContext* context;
+    const uint8_t* planes[3];
+    int strides[3];
+    uint8_t* dest;
+    int destStride;
+    int height;
+
+    void operator()()
+    {
+        uint8_t* destPlanes[3] = { dest, NULL, NULL };
+        int destStrides[3] = { destStride, 0, 0 };
+        sws_scale( context, planes, strides, 0, height, destPlanes,
+                    destStrides );
+    }
+};
+
+struct KernelConversion
+{
+    const uint8_t* src;
+    unsigned int width, height;
+    uint8_t* dest;
+
+    void operator()()
+    {
+        ColorConverter::yuv420ToRGBA( src, width, height, dest );
+    }
+};
+
+static void printResult( const char* name, double ms, unsigned int w,
+                            unsigned int h, double baseline )
+{
+    printf( "  %-24s %8.3f ms/frame %9.1f Mpixel/s %7.2fx\n", name, ms,
+            (double)w * h / ( ms * 1000.0 ), baseline / ms );
+}
+
+int main( int argc, char* argv[] )
+{
+    double duration = 1.0;
+    if ( argc > 1 )
+        duration = atof( argv[1] );
+    if ( duration <= 0.0 )
+    {
+        fprintf( stderr, "usage: %s [seconds per test]\n", argv[0] );
+        return 1;
+    }
+
+    const unsigned int sizes[][2] = { { 352, 288 }, { 640, 480 },
+                                      { 1280, 720 }, { 1920, 1080 } };
+    const ColorConverter::Kernel kernels[] = { ColorConverter::KERNEL_SCALAR,
+                                               ColorConverter::KERNEL_SSE2,
+                                               ColorConverter::KERNEL_AVX2 };
+    const int numSizes = sizeof( sizes ) / sizeof( sizes[0] );
+    const int numKernels = sizeof( kernels ) / sizeof( kernels[0] );
+
+    ColorConverter::setKernel( ColorConverter::KERNEL_AUTO );
+    printf( "best available kernel: %s\n",
+            ColorConverter::getKernelName( ColorConverter::getKernel() ) );
+
+    bool mismatch = false;
+
+    for ( int s = 0; s < numSizes; s++ )
+    {
+        unsigned int w = sizes[s][0];
+        unsigned int h = sizes[s][1];
+        printf( "%ux%u:\n", w, h );
+
+        std::vector<uint8_t> src;
+        fillFrame( src, w, h );
+        std::vector<uint8_t> rgb( w * h * 3 );
+        std::vector<uint8_t> rgba( w * h * 4 );
+        std::vector<uint8_t> reference( w * h * 4 );
+
+        // the current path: swscale to RGB24, as the decoder does
+        SwscaleConversion sws;
+        sws.planes[0] = &src[0];
+        sws.planes[1] = sws.planes[0] + w * h;
+        sws.planes[2] = sws.planes[1] + ( w / 2 ) * ( h / 2 );
+        sws.strides[0] = w;
+        sws.strides[1] = w / 2;
+        sws.strides[2] = w / 2;
+        sws.height = h;
+
+        sws.context = sws_getContext( w, h, AV_PIX_FMT_YUV420P, w, h,
+                                        AV_PIX_FMT_RGB24, SWS_BICUBIC, NULL,
+                                        NULL, NULL );
+        double baseline = 0.0;
+        if ( sws.context != NULL )
+        {
+            sws.dest = &rgb[0];
+            sws.destStride = w * 3;
+            baseline = timeConversion( sws, duration );
+            printResult( "swscale RGB24", baseline, w, h, baseline );
+            sws_freeContext( sws.context );
+        }
+
+        sws.context = sws_getContext( w, h, AV_PIX_FMT_YUV420P, w, h,
+                                        AV_PIX_FMT_RGBA, SWS_BICUBIC, NULL,
+                                        NULL, NULL );
+        if ( sws.context != NULL )
+        {
+            sws.dest = &rgba[0];
+            sws.destStride = w * 4;
+            double ms = timeConversion( sws, duration );
+            if ( baseline == 0.0 )
+                baseline = ms;
+            printResult( "swscale RGBA", ms, w, h, baseline );
+            sws_freeContext( sws.context );
+        }
+
+        ColorConverter::setKernel( ColorConverter::KERNEL_SCALAR );
+        ColorConverter::yuv420ToRGBA( &src[0], w, h, &reference[0] );
+
+        for ( int k = 0; k < numKernels; k++ )
+        {
+            if ( !ColorConverter::setKernel( kernels[k] ) )
+                continue;
+
+            KernelConversion conv;
+            conv.src = &src[0];
+            conv.width = w;
+            conv.height = h;
+            conv.dest = &rgba[0];
+            double ms = timeConversion( conv, duration );
+            if ( baseline == 0.0 )
+                baseline = ms;
+
+            char name[64];
+            snprintf( name, sizeof( name ), "grav %s RGBA",
+                        ColorConverter::getKernelName( kernels[k] ) );
+            printResult( name, ms, w, h, baseline );
+
+            if ( memcmp( &rgba[0], &reference[0], rgba.size() ) != 0 )
+            {
+                printf( "  %s output doesn't match scalar!\n",
+                        ColorConverter::getKernelName( kernels[k] ) );
+                mismatch = true;
+            }
+        }
+    }
+
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*
+ * @file ColorConverter.cpp
+ *
+ * Implementation of the ColorConverter class, plus the scalar & SSE2 row
+ * kernels. The AVX2 kernel is in ColorConverterAVX2.cpp since it needs to be
+ * built with different compiler flags. See ColorConverter.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ColorConverter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * BT.601 video range coefficients, times 64:
+ *   R = 1.164(Y-16) + 1.596(V-128)
+ *   G = 1.164(Y-16) - 0.391(U-128) - 0.813(V-128)
+ *   B = 1.164(Y-16) + 2.018(U-128)
+ * 64 is as high as they can go with every intermediate still fitting in a
+ * signed 16-bit lane (the blue sum can saturate, but only when the result
+ * would be clamped to 255 anyway), which is what keeps the SIMD kernels
+ * exactly matching this one.
+ */
+static inline uint8_t clampByte( int v )
+{
+    return v < 0 ? 0 : ( v > 255 ? 255 : (uint8_t)v );
+}
+
+static unsigned int yuvRowScalar( const uint8_t* y, const uint8_t* u,
+                                    const uint8_t* v, uint8_t* dest,
+                                    unsigned int w )
+{
+    for ( unsigned int x = 0; x < w; x++ )
+    {
+        int yy = ( y[x] - 16 ) * 75 + 32;
+        int uu = u[x/2] - 128;
+        int vv = v[x/2] - 128;
+
+        dest[0] = clampByte( ( yy + vv * 102 ) >> 6 );
+        dest[1] = clampByte( ( yy - uu * 25 - vv * 52 ) >> 6 );
+        dest[2] = clampByte( ( yy + uu * 129 ) >> 6 );
+        dest[3] = 255;
+        dest += 4;
+    }
+    return w;
+}
+
+#ifdef __SSE2__
+// 8 pixels at a time - returns how many pixels it did, leaving the rest of
+// the row for the scalar kernel
+static unsigned int yuvRowSSE2( const uint8_t* y, const uint8_t* u,
+                                const uint8_t* v, uint8_t* dest,
+                                unsigned int w )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8( (char)0xFF );
+    const __m128i yOffset = _mm_set1_epi16( 16 );
+    const __m128i uvOffset = _mm_set1_epi16( 128 );
+    const __m128i round = _mm_set1_epi16( 32 );
+    const __m128i yCoeff = _mm_set1_epi16( 75 );
+    const __m128i vrCoeff = _mm_set1_epi16( 102 );
+    const __m128i ugCoeff = _mm_set1_epi16( 25 );
+    const __m128i vgCoeff = _mm_set1_epi16( 52 );
+    const __m128i ubCoeff = _mm_set1_epi16( 129 );
+
+    unsigned int x;
+    for ( x = 0; x + 8 <= w; x += 8 )
+    {
+        int u4, v4;
+        memcpy( &u4, u + x/2, 4 );
+        memcpy( &v4, v + x/2, 4 );
+
+        __m128i Y = _mm_loadl_epi64( (const __m128i*)( y + x ) );
+        __m128i U = _mm_cvtsi32_si128( u4 );
+        __m128i V = _mm_cvtsi32_si128( v4 );
+        // each chroma sample covers two pixels horizontally
+        U = _mm_unpacklo_epi8( U, U );
+        V = _mm_unpacklo_epi8( V, V );
+
+        Y = _mm_sub_epi16( _mm_unpacklo_epi8( Y, zero ), yOffset );
+        U = _mm_sub_epi16( _mm_unpacklo_epi8( U, zero ), uvOffset );
+        V = _mm_sub_epi16( _mm_unpacklo_epi8( V, zero ), uvOffset );
+
+        __m128i yy = _mm_add_epi16( _mm_mullo_epi16( Y, yCoeff ), round );
+        __m128i R = _mm_adds_epi16( yy, _mm_mullo_epi16( V, vrCoeff ) );
+        __m128i G = _mm_subs_epi16( yy, _mm_mullo_epi16( U, ugCoeff ) );
+        G = _mm_subs_epi16( G, _mm_mullo_epi16( V, vgCoeff ) );
+        __m128i B = _mm_adds_epi16( yy, _mm_mullo_epi16( U, ubCoeff ) );
+
+        // shift back down & clamp to bytes
+        R = _mm_packus_epi16( _mm_srai_epi16( R, 6 ), zero );
+        G = _mm_packus_epi16( _mm_srai_epi16( G, 6 ), zero );
+        B = _mm_packus_epi16( _mm_srai_epi16( B, 6 ), zero );
+
+        // interleave to RGBA
+        __m128i RG = _mm_unpacklo_epi8( R, G );
+        __m128i BA = _mm_unpacklo_epi8( B, alpha );
+        _mm_storeu_si128( (__m128i*)( dest + x*4 ),
+                            _mm_unpacklo_epi16( RG, BA ) );
+        _mm_storeu_si128( (__m128i*)( dest + x*4 + 16 ),
+                            _mm_unpackhi_epi16( RG, BA ) );
+    }
+    return x;
+}
+#endif
+
+#ifdef GRAV_HAVE_AVX2
+// in ColorConverterAVX2.cpp
+unsigned int yuvRowAVX2( const uint8_t* y, const uint8_t* u,
+                            const uint8_t* v, uint8_t* dest, unsigned int w );
+#endif
+
+ColorConverter::RowFunc ColorConverter::rowFunc = NULL;
+ColorConverter::Kernel ColorConverter::kernel = KERNEL_SCALAR;
+
+void ColorConverter::yuv420ToRGBA( const uint8_t* src, unsigned int w,
+                                    unsigned int h, uint8_t* dest )
+{
+    const uint8_t* y = src;
+    const uint8_t* u = y + w * h;
+    const uint8_t* v = u + ( w / 2 ) * ( h / 2 );
+    yuv420ToRGBA( y, u, v, w, h, w, w / 2, dest, w * 4 );
+}
+
+void ColorConverter::yuv420ToRGBA( const uint8_t* y, const uint8_t* u,
+                                    const uint8_t* v, unsigned int w,
+                                    unsigned int h, unsigned int yStride,
+                                    unsigned int uvStride, uint8_t* dest,
+                                    unsigned int destStride )
+{
+    // detecting is harmless to race on, since every thread comes up with the
+    // same answer
+    if ( rowFunc == NULL )
+        setKernel( KERNEL_AUTO );
+    RowFunc func = rowFunc;
+
+    // the chroma planes are (w/2)x(h/2), rounded down, so with odd sizes the
+    // last row & column of pixels have no chroma of their own - they share
+    // the nearest one. too small for any chroma at all, there's nothing to
+    // go on, so just make it black
+    if ( w < 2 || h < 2 )
+    {
+        for ( unsigned int row = 0; row < h; row++ )
+        {
+            uint8_t* destRow = dest + row * destStride;
+            for ( unsigned int x = 0; x < w; x++ )
+            {
+                destRow[x*4] = 0; destRow[x*4+1] = 0; destRow[x*4+2] = 0;
+                destRow[x*4+3] = 255;
+            }
+        }
+        return;
+    }
+    unsigned int evenWidth = w & ~1u;
+    unsigned int lastChromaRow = h / 2 - 1;
+    unsigned int lastChromaCol = w / 2 - 1;
+
+    for ( unsigned int row = 0; row < h; row++ )
+    {
+        unsigned int chromaRow = std::min( row / 2, lastChromaRow );
+        const uint8_t* yRow = y + row * yStride;
+        const uint8_t* uRow = u + chromaRow * uvStride;
+        const uint8_t* vRow = v + chromaRow * uvStride;
+        uint8_t* destRow = dest + row * destStride;
+
+        unsigned int done = func( yRow, uRow, vRow, destRow, evenWidth );
+        // finish off whatever's left that the SIMD kernel couldn't fit.
+        // done is always even, so the chroma lines up
+        if ( done < evenWidth )
+            yuvRowScalar( yRow + done, uRow + done/2, vRow + done/2,
+                            destRow + done*4, evenWidth - done );
+        if ( evenWidth < w )
+            yuvRowScalar( yRow + evenWidth, uRow + lastChromaCol,
+                            vRow + lastChromaCol, destRow + evenWidth*4, 1 );
+    }
+}
+
+bool ColorConverter::setKernel( Kernel k )
+{
+    if ( k == KERNEL_AUTO )
+        k = detectKernel();
+    if ( !isKernelSupported( k ) )
+        return false;
+
+    switch ( k )
+    {
+#ifdef GRAV_HAVE_AVX2
+    case KERNEL_AVX2:
+        rowFunc = &yuvRowAVX2;
+        break;
+#endif
+#ifdef __SSE2__
+    case KERNEL_SSE2:
+        rowFunc = &yuvRowSSE2;
+        break;
+#endif
+    default:
+        k = KERNEL_SCALAR;
+        rowFunc = &yuvRowScalar;
+        break;
+    }
+    kernel = k;
+    return true;
+}
+
+ColorConverter::Kernel ColorConverter::getKernel()
+{
+    if ( rowFunc == NULL )
+        setKernel( KERNEL_AUTO );
+    return kernel;
+}
+
+bool ColorConverter::isKernelSupported( Kernel k )
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    switch ( k )
+    {
+    case KERNEL_AUTO:
+    case KERNEL_SCALAR:
+        return true;
+
+    case KERNEL_SSE2:
+#if defined(__SSE2__) && ( defined(__i386__) || defined(__x86_64__) )
+        if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+            return false;
+        return ( edx & ( 1 << 26 ) ) != 0;
+#else
+        return false;
+#endif
+
+    case KERNEL_AVX2:
+#if defined(GRAV_HAVE_AVX2) && ( defined(__i386__) || defined(__x86_64__) )
+    {
+        if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+            return false;
+        // need the OS to save the AVX registers (OSXSAVE + AVX, then check
+        // XCR0 for the XMM & YMM state bits)
+        if ( ( ecx & ( 1 << 27 ) ) == 0 || ( ecx & ( 1 << 28 ) ) == 0 )
+            return false;
+        unsigned int xcrLow, xcrHigh;
+        __asm__ volatile ( "xgetbv" : "=a" (xcrLow), "=d" (xcrHigh)
+                            : "c" (0) );
+        if ( ( xcrLow & 6 ) != 6 )
+            return false;
+        if ( __get_cpuid_max( 0, NULL ) < 7 )
+            return false;
+        __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+        return ( ebx & ( 1 << 5 ) ) != 0;
+    }
+#else
+        return false;
+#endif
+    }
+
+    return false;
+}
+
+const char* ColorConverter::getKernelName( Kernel k )
+{
+    switch ( k )
+    {
+    case KERNEL_AUTO:
+        return "auto";
+    case KERNEL_SCALAR:
+        return "scalar";
+    case KERNEL_SSE2:
+        return "SSE2";
+    case KERNEL_AVX2:
+        return "AVX2";
+    }
+    return "unknown";
+}
+
+ColorConverter::Kernel ColorConverter::detectKernel()
+{
+    if ( isKernelSupported( KERNEL_AVX2 ) )
+        return KERNEL_AVX2;
+    if ( isKernelSupported( KERNEL_SSE2 ) )
+        return KERNEL_SSE2;
+    return KERNEL_SCALAR;
+}
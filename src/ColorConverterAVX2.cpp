@@ -0,0 +1,92 @@
+/*
+ * @file ColorConverterAVX2.cpp
+ *
+ * AVX2 YUV420 -> RGBA row kernel for ColorConverter. Kept in its own file so
+ * only this gets built with -mavx2 - ColorConverter only calls it after
+ * checking that the CPU supports it. Same math as the other kernels, see
+ * ColorConverter.cpp.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GRAV_HAVE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+// 16 pixels at a time - returns how many pixels it did, leaving the rest of
+// the row for the scalar kernel
+unsigned int yuvRowAVX2( const uint8_t* y, const uint8_t* u,
+                            const uint8_t* v, uint8_t* dest, unsigned int w )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi8( (char)0xFF );
+    const __m256i yOffset = _mm256_set1_epi16( 16 );
+    const __m256i uvOffset = _mm256_set1_epi16( 128 );
+    const __m256i round = _mm256_set1_epi16( 32 );
+    const __m256i yCoeff = _mm256_set1_epi16( 75 );
+    const __m256i vrCoeff = _mm256_set1_epi16( 102 );
+    const __m256i ugCoeff = _mm256_set1_epi16( 25 );
+    const __m256i vgCoeff = _mm256_set1_epi16( 52 );
+    const __m256i ubCoeff = _mm256_set1_epi16( 129 );
+
+    unsigned int x;
+    for ( x = 0; x + 16 <= w; x += 16 )
+    {
+        __m128i u8 = _mm_loadl_epi64( (const __m128i*)( u + x/2 ) );
+        __m128i v8 = _mm_loadl_epi64( (const __m128i*)( v + x/2 ) );
+
+        __m256i Y = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128( (const __m128i*)( y + x ) ) );
+        // each chroma sample covers two pixels horizontally
+        __m256i U = _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( u8, u8 ) );
+        __m256i V = _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( v8, v8 ) );
+
+        Y = _mm256_sub_epi16( Y, yOffset );
+        U = _mm256_sub_epi16( U, uvOffset );
+        V = _mm256_sub_epi16( V, uvOffset );
+
+        __m256i yy = _mm256_add_epi16( _mm256_mullo_epi16( Y, yCoeff ),
+                                        round );
+        __m256i R = _mm256_adds_epi16( yy, _mm256_mullo_epi16( V, vrCoeff ) );
+        __m256i G = _mm256_subs_epi16( yy, _mm256_mullo_epi16( U, ugCoeff ) );
+        G = _mm256_subs_epi16( G, _mm256_mullo_epi16( V, vgCoeff ) );
+        __m256i B = _mm256_adds_epi16( yy, _mm256_mullo_epi16( U, ubCoeff ) );
+
+        // shift back down & clamp to bytes. packing works per 128-bit lane,
+        // so this leaves pixels 0-7 in the low lane and 8-15 in the high one
+        R = _mm256_packus_epi16( _mm256_srai_epi16( R, 6 ), zero );
+        G = _mm256_packus_epi16( _mm256_srai_epi16( G, 6 ), zero );
+        B = _mm256_packus_epi16( _mm256_srai_epi16( B, 6 ), zero );
+
+        __m256i RG = _mm256_unpacklo_epi8( R, G );
+        __m256i BA = _mm256_unpacklo_epi8( B, alpha );
+        // pixels 0-3 & 8-11, then 4-7 & 12-15
+        __m256i lo = _mm256_unpacklo_epi16( RG, BA );
+        __m256i hi = _mm256_unpackhi_epi16( RG, BA );
+
+        _mm256_storeu_si256( (__m256i*)( dest + x*4 ),
+                                _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)( dest + x*4 + 32 ),
+                                _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+    }
+    return x;
+}
+
+#endif
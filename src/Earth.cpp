@@ -77,14 +77,13 @@ Earth::Earth()
     glDisable( GL_TEXTURE_2D );
     glEndList();
 
-    matrix = new GLdouble[16];
+    updateMatrix();
 }
 
 Earth::~Earth()
 {
     glDeleteTextures( 1, &earthTex );
     gluDeleteQuadric( sphereQuad );
-    delete[] matrix;
     glDeleteLists( sphereIndex, 1 );
 }
 
@@ -148,70 +147,54 @@ void Earth::draw()
 void Earth::convertLatLong( float lat, float lon, float &ex, float &ey,
                             float &ez)
 {
-    // grab the modelview matrix so we can calculate the result of the
-    // rotation manually
-    //GLdouble matrix[16];
-    //glPushMatrix();
-    //GLUtil::printMatrices();
-
-
-    /*glTranslatef( x, y, z );
-    glRotatef( xRot, 1.0f, 0.0f, 0.0f );
-    glRotatef( yRot, 0.0f, 0.0f, 1.0f );
-    glRotatef( zRot, 0.0f, 1.0f, 0.0f );
-    glGetDoublev( GL_MODELVIEW_MATRIX, matrix );*/
-
-    //glPopMatrix();
-    //GLUtil::updateMatrices();
-    //GLUtil::printMatrices();
-    //for ( int i = 0; i < 16; i++ )
-    //    matrix[i] = GLUtil::modelview[i];
-
-    glPushMatrix();
-    glLoadIdentity();
-    glTranslatef( x, y, z );
-    glRotatef( xRot, 1.0f, 0.0f, 0.0f );
-    glRotatef( yRot, 0.0f, 0.0f, 1.0f );
-    glRotatef( zRot, 0.0f, 1.0f, 0.0f );
-    glGetDoublev( GL_MODELVIEW_MATRIX, matrix );
-    glPopMatrix();
-
-    float rlat = lat;//-90.0f); //-xRot
-    float rlon = lon; //+zRot
-    //float rlat = lat-xRot-90.0f;
-    //float rlon = lon+zRot;
-
-    rlat = rlat*PI/180.0f;
-    rlon = rlon*PI/180.0f;
+    float rlat = lat*PI/180.0f;
+    float rlon = lon*PI/180.0f;
 
     float ext = radius * (cos(rlat) * sin(rlon));
     float eyt = radius * (sin(rlat));
     float ezt = radius * (cos(rlat) * cos(rlon));
-    //gravUtil::logVerbose( "ex,ey,ez: %f,%f,%f\n", ex, ey, ez );
-
-    /*glBegin( GL_LINE );
-    glVertex3f( 0.0f, 0.0f, 0.0f );
-    glVertex3f( ex, ey, ez );
-    glEnd();*/
 
     // column major
     ex = (ext*matrix[0]) + (eyt*matrix[4]) + (ezt*matrix[8]) + matrix[12];
     ey = (ext*matrix[1]) + (eyt*matrix[5]) + (ezt*matrix[9]) + matrix[13];
     ez = (ext*matrix[2]) + (eyt*matrix[6]) + (ezt*matrix[10]) + matrix[14];
-    //gravUtil::logVerbose( "x,y,z: %f,%f,%f\n", ex, ey, ez );
+}
 
-    // row major
-    /*ex = (ex*matrix[0]) + (ey*matrix[1]) + (ez*matrix[2]);// + matrix[3];
-    ey = (ex*matrix[4]) + (ey*matrix[5]) + (ez*matrix[5]);// + matrix[7];
-    ez = (ex*matrix[8]) + (ey*matrix[9]) + (ez*matrix[10]);// + matrix[11];*/
+void Earth::convertLatLongs( const std::vector<float>& latLongs,
+                                std::vector<float>& positions )
+{
+    unsigned int count = latLongs.size() / 2;
+    positions.resize( count * 3 );
+    if ( count == 0 )
+        return;
+
+    // the matrix is the same for all of them, so fold the radius in once.
+    // straight loops over plain arrays so the compiler can vectorize them
+    float m[12];
+    for ( int i = 0; i < 3; i++ )
+    {
+        m[i] = matrix[i] * radius;
+        m[i+3] = matrix[i+4] * radius;
+        m[i+6] = matrix[i+8] * radius;
+        m[i+9] = matrix[i+12];
+    }
 
-    //gravUtil::logVerbose( "matrix/modelview: %f, %f\n", matrix[1], GLUtil::modelview[1] );
+    const float* in = &latLongs[0];
+    float* out = &positions[0];
+    for ( unsigned int i = 0; i < count; i++ )
+    {
+        float rlat = in[i*2] * PI/180.0f;
+        float rlon = in[i*2+1] * PI/180.0f;
+        float cosLat = cosf( rlat );
 
-    //ex = (ex*GLUtil::modelview[0]) + (ey*GLUtil::modelview[4]) + (ez*GLUtil::modelview[8]) + GLUtil::modelview[12];
-    //ey = (ex*GLUtil::modelview[1]) + (ey*GLUtil::modelview[5]) + (ez*GLUtil::modelview[9]) + GLUtil::modelview[13];
-    //ez = (ex*GLUtil::modelview[2]) + (ey*GLUtil::modelview[3]) + (ez*GLUtil::modelview[10]) + GLUtil::modelview[14];
+        float ext = cosLat * sinf( rlon );
+        float eyt = sinf( rlat );
+        float ezt = cosLat * cosf( rlon );
 
-    //glPopMatrix();
+        out[i*3] = (ext*m[0]) + (eyt*m[3]) + (ezt*m[6]) + m[9];
+        out[i*3+1] = (ext*m[1]) + (eyt*m[4]) + (ezt*m[7]) + m[10];
+        out[i*3+2] = (ext*m[2]) + (eyt*m[5]) + (ezt*m[8]) + m[11];
+    }
 }
 
 void Earth::rotate( float x, float y, float z )
@@ -225,6 +208,7 @@ void Earth::rotate( float x, float y, float z )
         xRot += x;
         yRot += y;
         zRot += z;
+        updateMatrix();
     }
     else
         rotating = true;
@@ -268,5 +252,42 @@ void Earth::animateValues()
             zRot = destZRot;
             rotating = false;
         }
+
+        updateMatrix();
     }
 }
+
+void Earth::updateMatrix()
+{
+    // same as glTranslatef( x, y, z ), then glRotatef for xRot around X, yRot
+    // around Z & zRot around Y
+    float a = xRot*PI/180.0f;
+    float b = yRot*PI/180.0f;
+    float c = zRot*PI/180.0f;
+    float ca = cos(a), sa = sin(a);
+    float cb = cos(b), sb = sin(b);
+    float cc = cos(c), sc = sin(c);
+
+    // Rx * Rz, row by row
+    float r00 = cb,      r01 = -sb,     r02 = 0.0f;
+    float r10 = ca*sb,   r11 = ca*cb,   r12 = -sa;
+    float r20 = sa*sb,   r21 = sa*cb,   r22 = ca;
+
+    // then * Ry, stored column major
+    matrix[0] = r00*cc - r02*sc;
+    matrix[1] = r10*cc - r12*sc;
+    matrix[2] = r20*cc - r22*sc;
+    matrix[3] = 0.0f;
+    matrix[4] = r01;
+    matrix[5] = r11;
+    matrix[6] = r21;
+    matrix[7] = 0.0f;
+    matrix[8] = r00*sc + r02*cc;
+    matrix[9] = r10*sc + r12*cc;
+    matrix[10] = r20*sc + r22*cc;
+    matrix[11] = 0.0f;
+    matrix[12] = x;
+    matrix[13] = y;
+    matrix[14] = z;
+    matrix[15] = 1.0f;
+}
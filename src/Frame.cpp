@@ -83,7 +83,7 @@ void Frame::spawnPropertyWindow( wxCommandEvent& evt )
     for ( unsigned int i = 0; i < grav->getSelectedObjects()->size(); i++ )
     {
         VideoInfoDialog* dialog = new VideoInfoDialog( this,
-                (*grav->getSelectedObjects())[i] );
+                (*grav->getSelectedObjects())[i], grav );
         dialog->Show();
     }
 }
@@ -0,0 +1,245 @@
+/*
+ * @file FramePipeline.cpp
+ *
+ * Implementation of the FramePipeline class. See FramePipeline.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FramePipeline.h"
+#include "VideoSource.h"
+#include "gravUtil.h"
+
+#include <algorithm>
+
+FramePipeline::FramePipeline( int numThreads )
+    : workAvailable( pipelineMutex ), jobDone( pipelineMutex )
+{
+    running = true;
+
+    gravUtil::logVerbose( "FramePipeline::FramePipeline: starting %i frame "
+            "processing thread(s)\n", numThreads );
+    for ( int i = 0; i < numThreads; i++ )
+        workers.push_back( thread_start( threadMain, this ) );
+}
+
+FramePipeline::~FramePipeline()
+{
+    pipelineMutex.Lock();
+    running = false;
+    workAvailable.Broadcast();
+    pipelineMutex.Unlock();
+
+    for ( unsigned int i = 0; i < workers.size(); i++ )
+        thread_join( workers[i] );
+}
+
+void FramePipeline::addSource( VideoSource* s )
+{
+    SourceState state;
+    state.pending = 0;
+    state.firstPendingTime = 0.0;
+    state.queued = false;
+    state.running = false;
+    state.removing = false;
+    state.avgLatency = 0.0f;
+    state.processed = 0;
+    state.coalesced = 0;
+
+    pipelineMutex.Lock();
+    states[s] = state;
+    pipelineMutex.Unlock();
+}
+
+void FramePipeline::removeSource( VideoSource* s )
+{
+    pipelineMutex.Lock();
+
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    if ( it == states.end() )
+    {
+        pipelineMutex.Unlock();
+        return;
+    }
+
+    // stops it getting queued again, by new frames or by a worker finishing
+    // a job for it while we wait below
+    it->second.removing = true;
+
+    // a worker may be in the middle of processing it - it'll still need the
+    // state when it's done, so wait for that before erasing
+    while ( it->second.running )
+        jobDone.Wait();
+
+    std::deque<VideoSource*>::iterator ri =
+        std::find( ready.begin(), ready.end(), s );
+    if ( ri != ready.end() )
+        ready.erase( ri );
+
+    states.erase( it );
+    pipelineMutex.Unlock();
+}
+
+void FramePipeline::frameReady( VideoSource* s )
+{
+    pipelineMutex.Lock();
+
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    if ( it == states.end() )
+    {
+        pipelineMutex.Unlock();
+        return;
+    }
+    SourceState& state = it->second;
+    if ( state.removing )
+    {
+        pipelineMutex.Unlock();
+        return;
+    }
+
+    if ( state.pending == 0 )
+        state.firstPendingTime = gravUtil::getTime();
+    state.pending++;
+
+    // no workers, so just do it here
+    if ( workers.empty() )
+    {
+        state.running = true;
+        state.pending = 0;
+        pipelineMutex.Unlock();
+
+        s->processFrame();
+
+        pipelineMutex.Lock();
+        state.running = false;
+        state.processed++;
+        jobDone.Broadcast();
+        pipelineMutex.Unlock();
+        return;
+    }
+
+    // if it's already waiting or being worked on, this frame will be picked
+    // up by that job (or the one queued right after it finishes)
+    if ( !state.queued && !state.running )
+    {
+        state.queued = true;
+        ready.push_back( s );
+        workAvailable.Signal();
+    }
+
+    pipelineMutex.Unlock();
+}
+
+void* FramePipeline::threadMain( void* args )
+{
+    FramePipeline* pipeline = (FramePipeline*)args;
+    pipeline->workerLoop();
+    return 0;
+}
+
+void FramePipeline::workerLoop()
+{
+    pipelineMutex.Lock();
+
+    while ( running )
+    {
+        if ( ready.empty() )
+        {
+            workAvailable.Wait();
+            continue;
+        }
+
+        VideoSource* s = ready.front();
+        ready.pop_front();
+
+        // removed since it was queued (shouldn't happen, since removeSource
+        // takes it out of the queue, but don't make a new entry for it)
+        std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+        if ( it == states.end() || it->second.removing )
+            continue;
+
+        SourceState& state = it->second;
+        state.queued = false;
+        state.running = true;
+        int frames = state.pending;
+        double reportTime = state.firstPendingTime;
+        state.pending = 0;
+
+        pipelineMutex.Unlock();
+
+        s->processFrame();
+        double latency = ( gravUtil::getTime() - reportTime ) * 1000.0;
+
+        pipelineMutex.Lock();
+
+        // the map entry stays put while running is set (see removeSource)
+        // so the reference is still good
+        state.running = false;
+        state.processed++;
+        state.coalesced += frames - 1;
+        state.avgLatency = state.processed == 1 ? (float)latency :
+                                state.avgLatency * 0.9f +
+                                    (float)latency * 0.1f;
+
+        // more frames came in while this one was being processed - unless
+        // it's being removed, in which case removeSource is waiting on us
+        if ( state.pending > 0 && !state.removing )
+        {
+            state.queued = true;
+            ready.push_back( s );
+        }
+
+        jobDone.Broadcast();
+    }
+
+    pipelineMutex.Unlock();
+}
+
+int FramePipeline::getQueueDepth( VideoSource* s )
+{
+    wxMutexLocker locker( pipelineMutex );
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    return it != states.end() ? it->second.pending : 0;
+}
+
+float FramePipeline::getAverageLatency( VideoSource* s )
+{
+    wxMutexLocker locker( pipelineMutex );
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    return it != states.end() ? it->second.avgLatency : 0.0f;
+}
+
+long FramePipeline::getProcessedCount( VideoSource* s )
+{
+    wxMutexLocker locker( pipelineMutex );
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    return it != states.end() ? it->second.processed : 0;
+}
+
+long FramePipeline::getCoalescedCount( VideoSource* s )
+{
+    wxMutexLocker locker( pipelineMutex );
+    std::map<VideoSource*, SourceState>::iterator it = states.find( s );
+    return it != states.end() ? it->second.coalesced : 0;
+}
+
+int FramePipeline::getThreadCount()
+{
+    return (int)workers.size();
+}
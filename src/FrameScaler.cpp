@@ -0,0 +1,170 @@
+/*
+ * @file FrameScaler.cpp
+ *
+ * Implementation of the FrameScaler class. See FrameScaler.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameScaler.h"
+#include "gravUtil.h"
+
+extern "C"
+{
+#include <libavutil/avutil.h>
+#include <libswscale/swscale.h>
+}
+
+// older ffmpeg only has the PIX_FMT_ names
+#if LIBAVUTIL_VERSION_INT < AV_VERSION_INT(51,42,0)
+#define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
+#define AV_PIX_FMT_RGB24 PIX_FMT_RGB24
+#define AVPixelFormat PixelFormat
+#endif
+
+FrameScaler::FrameScaler()
+{
+    context = NULL;
+    buffer = NULL;
+    bufferSize = 0;
+    width = 0; height = 0;
+    format = VIDEO_FORMAT_RGB24;
+}
+
+FrameScaler::~FrameScaler()
+{
+    if ( context != NULL )
+        sws_freeContext( context );
+    delete [] buffer;
+}
+
+bool FrameScaler::scale( const unsigned char* src, unsigned int srcWidth,
+                            unsigned int srcHeight, VPMVideoFormat srcFormat,
+                            unsigned int destWidth, unsigned int destHeight )
+{
+    if ( src == NULL || srcWidth == 0 || srcHeight == 0 ||
+            destWidth == 0 || destHeight == 0 )
+        return false;
+
+    const uint8_t* srcPlanes[3];
+    int srcStrides[3];
+    uint8_t* destPlanes[3];
+    int destStrides[3];
+    unsigned int destSize;
+    AVPixelFormat pixFormat;
+
+    if ( srcFormat == VIDEO_FORMAT_RGB24 )
+    {
+        pixFormat = AV_PIX_FMT_RGB24;
+        destSize = destWidth * destHeight * 3;
+    }
+    else if ( srcFormat == VIDEO_FORMAT_YUV420 )
+    {
+        pixFormat = AV_PIX_FMT_YUV420P;
+        destSize = destWidth * destHeight * 3 / 2;
+    }
+    else
+    {
+        gravUtil::logWarning( "FrameScaler::scale: unsupported format %i\n",
+                srcFormat );
+        return false;
+    }
+
+    // only reallocate when it grows, so bouncing between sizes doesn't thrash
+    if ( destSize > bufferSize )
+    {
+        delete [] buffer;
+        buffer = new unsigned char[destSize];
+        bufferSize = destSize;
+    }
+
+    // this only makes a new context if the parameters actually changed
+    context = sws_getCachedContext( context,
+                                    srcWidth, srcHeight, pixFormat,
+                                    destWidth, destHeight, pixFormat,
+                                    SWS_FAST_BILINEAR, NULL, NULL, NULL );
+    if ( context == NULL )
+    {
+        gravUtil::logError( "FrameScaler::scale: failed to get scaling "
+                "context for %ix%i -> %ix%i\n", srcWidth, srcHeight,
+                destWidth, destHeight );
+        return false;
+    }
+
+    if ( srcFormat == VIDEO_FORMAT_RGB24 )
+    {
+        srcPlanes[0] = src;
+        srcStrides[0] = srcWidth * 3;
+        srcPlanes[1] = srcPlanes[2] = NULL;
+        srcStrides[1] = srcStrides[2] = 0;
+
+        destPlanes[0] = buffer;
+        destStrides[0] = destWidth * 3;
+        destPlanes[1] = destPlanes[2] = NULL;
+        destStrides[1] = destStrides[2] = 0;
+    }
+    else
+    {
+        srcPlanes[0] = src;
+        srcPlanes[1] = src + srcWidth * srcHeight;
+        srcPlanes[2] = src + 5 * ( srcWidth * srcHeight ) / 4;
+        srcStrides[0] = srcWidth;
+        srcStrides[1] = srcStrides[2] = srcWidth / 2;
+
+        destPlanes[0] = buffer;
+        destPlanes[1] = buffer + destWidth * destHeight;
+        destPlanes[2] = buffer + 5 * ( destWidth * destHeight ) / 4;
+        destStrides[0] = destWidth;
+        destStrides[1] = destStrides[2] = destWidth / 2;
+    }
+
+    sws_scale( context, srcPlanes, srcStrides, 0, srcHeight,
+                destPlanes, destStrides );
+
+    width = destWidth;
+    height = destHeight;
+    format = srcFormat;
+    return true;
+}
+
+unsigned char* FrameScaler::getData()
+{
+    return buffer;
+}
+
+unsigned int FrameScaler::getWidth()
+{
+    return width;
+}
+
+unsigned int FrameScaler::getHeight()
+{
+    return height;
+}
+
+VPMVideoFormat FrameScaler::getFormat()
+{
+    return format;
+}
+
+void FrameScaler::reset()
+{
+    width = 0;
+    height = 0;
+}
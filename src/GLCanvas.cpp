@@ -124,6 +124,14 @@ void GLCanvas::resize( wxSizeEvent& evt )
 
 void GLCanvas::GLreshape( int w, int h )
 {
+    setupView( grav, w, h );
+}
+
+void GLCanvas::setupView( gravManager* grav, int w, int h )
+{
+    // tracks the aspect ratio of the screen for reshaping
+    float screen_width, screen_height;
+
     glViewport(0, 0, w, h);
 
     if (w > h)
@@ -24,6 +24,8 @@
 
 #include "VideoSource.h"
 #include "GLUtil.h"
+#include "SDFFont.h"
+#include "TextMetrics.h"
 #include <string>
 
 GLUtil* GLUtil::instance = NULL;
@@ -45,9 +47,14 @@ bool GLUtil::initGL()
     const char* glVer = (const char*)glGetString( GL_VERSION );
     int glMajorVer, glMinorVer;
     sscanf( glVer, "%d.%d", &glMajorVer, &glMinorVer );
+    // NPOT textures are core as of 2.0
+    NPOTAvailable = GLEW_ARB_texture_non_power_of_two || glMajorVer >= 2;
+    gravUtil::logVerbose( "GLUtil::initGL(): non-power-of-two textures %s\n",
+            NPOTAvailable ? "available" : "NOT available" );
+
     if ( glMajorVer >= 2 && enableShaders )
     {
-        YUV420Program = GLUtil::loadShaders( "GLSL/YUV420toRGB24" );
+        YUV420Program = GLUtil::loadShaders( vert420, frag420 );
         if ( YUV420Program )
         {
             YUV420xOffsetID = glGetUniformLocation( YUV420Program, "xOffset" );
@@ -56,6 +63,52 @@ bool GLUtil::initGL()
             shadersAvailable = true;
             gravUtil::logVerbose( "GLUtil::initGL(): shaders are available "
                     "(GL v%s)\n", glVer );
+
+            if ( NPOTAvailable )
+            {
+                YUV420PlanarProgram = GLUtil::loadShaders( vert420Planar,
+                                                            frag420Planar );
+            }
+            if ( YUV420PlanarProgram )
+            {
+                YUV420PlanaralphaID = glGetUniformLocation(
+                                        YUV420PlanarProgram, "alpha" );
+                // the plane samplers never change, so point them at their
+                // texture units once here
+                glUseProgram( YUV420PlanarProgram );
+                glUniform1i( glGetUniformLocation( YUV420PlanarProgram,
+                                "yTex" ), 0 );
+                glUniform1i( glGetUniformLocation( YUV420PlanarProgram,
+                                "uTex" ), 1 );
+                glUniform1i( glGetUniformLocation( YUV420PlanarProgram,
+                                "vTex" ), 2 );
+                glUseProgram( 0 );
+                planarYUVAvailable = true;
+                gravUtil::logVerbose( "GLUtil::initGL(): using planar YUV420 "
+                        "textures\n" );
+
+                YUV420PlanarBatchProgram = GLUtil::loadShaders(
+                                        vert420PlanarBatch, frag420PlanarBatch );
+                if ( YUV420PlanarBatchProgram )
+                {
+                    glUseProgram( YUV420PlanarBatchProgram );
+                    glUniform1i( glGetUniformLocation(
+                                    YUV420PlanarBatchProgram, "yTex" ), 0 );
+                    glUniform1i( glGetUniformLocation(
+                                    YUV420PlanarBatchProgram, "uTex" ), 1 );
+                    glUniform1i( glGetUniformLocation(
+                                    YUV420PlanarBatchProgram, "vTex" ), 2 );
+                    glUseProgram( 0 );
+                }
+            }
+
+            // the batched versions are optional - without them, videos just
+            // get drawn one at a time
+            YUV420BatchProgram = GLUtil::loadShaders( vert420Batch,
+                                                        frag420Batch );
+            gravUtil::logVerbose( "GLUtil::initGL(): batched video shaders "
+                    "%s\n", YUV420BatchProgram ? "available" :
+                    "NOT available" );
         }
         else
         {
@@ -77,6 +130,45 @@ bool GLUtil::initGL()
                 "(GL v%s)\n", glVer );
     }
 
+    // pixel buffer objects let texture pushes return immediately and have the
+    // driver do the actual transfer asynchronously
+    if ( GLEW_ARB_pixel_buffer_object && enablePBOs )
+    {
+        PBOsAvailable = true;
+        gravUtil::logVerbose( "GLUtil::initGL(): pixel buffer objects are "
+                "available\n" );
+    }
+    else if ( GLEW_ARB_pixel_buffer_object && !enablePBOs )
+    {
+        PBOsAvailable = false;
+        gravUtil::logVerbose( "GLUtil::initGL(): pixel buffer objects may be "
+                "available but are disabled\n" );
+    }
+    else
+    {
+        PBOsAvailable = false;
+        gravUtil::logVerbose( "GLUtil::initGL(): pixel buffer objects NOT "
+                "available, using direct texture uploads\n" );
+    }
+
+    // for mipmapping small videos
+    if ( GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object )
+    {
+        mipmapsAvailable = true;
+        useEXTMipmaps = false;
+    }
+    else if ( GLEW_EXT_framebuffer_object )
+    {
+        mipmapsAvailable = true;
+        useEXTMipmaps = true;
+    }
+    else
+    {
+        mipmapsAvailable = false;
+    }
+    gravUtil::logVerbose( "GLUtil::initGL(): mipmap generation %s\n",
+            mipmapsAvailable ? "available" : "NOT available" );
+
     gravUtil* util = gravUtil::getInstance();
     std::string fontLoc = util->findFile( "FreeSans.ttf" );
     bool found = fontLoc.compare( "" ) != 0;
@@ -109,6 +201,29 @@ bool GLUtil::initGL()
         mainFont->FaceSize( 100 );
     }
 
+    textMetrics = new TextMetrics();
+    if ( !textMetrics->load( fontLoc ) )
+    {
+        gravUtil::logWarning( "GLUtil::initGL(): text metrics failed to "
+                "load, measuring text with FTGL\n" );
+        delete textMetrics;
+        textMetrics = NULL;
+    }
+
+    // the distance field shader is tiny, so it doesn't depend on the
+    // (colorspace conversion) shader enable, just on having GLSL
+    if ( glMajorVer >= 2 && enableSDFText && textMetrics != NULL )
+    {
+        textFont = new SDFFont();
+        if ( !textFont->load( fontLoc, textMetrics ) )
+        {
+            gravUtil::logWarning( "GLUtil::initGL(): distance field font "
+                    "failed to load, using FTGL for text\n" );
+            delete textFont;
+            textFont = NULL;
+        }
+    }
+
     // TODO this is platform-specific, see the glxew include in glutil.h
     if ( GLX_SGI_swap_control )
     {
@@ -250,19 +365,13 @@ bool GLUtil::screenToRectIntersect( GLdouble x, GLdouble y, RectangleBase rect,
     return rect.findRayIntersect( r, intersect );
 }
 
-GLuint GLUtil::loadShaders( const char* location )
+GLuint GLUtil::loadShaders( const GLchar* vert, const GLchar* frag )
 {
-    /*std::string vertLoc;
-    std::string fragLoc;
-
-    vertLoc = std::string(location) + std::string(".vert");
-    fragLoc = std::string(location) + std::string(".frag");*/
-
     GLuint vertexShader = glCreateShader( GL_VERTEX_SHADER );
     GLuint fragmentShader = glCreateShader( GL_FRAGMENT_SHADER );
 
-    glShaderSource( vertexShader, 1, (const GLchar**)&vert420, NULL );
-    glShaderSource( fragmentShader, 1, (const GLchar**)&frag420, NULL );
+    glShaderSource( vertexShader, 1, &vert, NULL );
+    glShaderSource( fragmentShader, 1, &frag, NULL );
 
     glCompileShader( vertexShader );
 
@@ -349,11 +458,46 @@ GLuint GLUtil::getYUV420alphaID()
     return YUV420alphaID;
 }
 
+GLuint GLUtil::getYUV420PlanarProgram()
+{
+    return YUV420PlanarProgram;
+}
+
+GLuint GLUtil::getYUV420PlanaralphaID()
+{
+    return YUV420PlanaralphaID;
+}
+
+GLuint GLUtil::getYUV420BatchProgram()
+{
+    return YUV420BatchProgram;
+}
+
+GLuint GLUtil::getYUV420PlanarBatchProgram()
+{
+    return YUV420PlanarBatchProgram;
+}
+
 FTFont* GLUtil::getMainFont()
 {
     return mainFont;
 }
 
+SDFFont* GLUtil::getTextFont()
+{
+    return textFont;
+}
+
+const TextMetrics* GLUtil::getTextMetrics()
+{
+    return textMetrics;
+}
+
+void GLUtil::setSDFTextEnable( bool es )
+{
+    enableSDFText = es;
+}
+
 bool GLUtil::areShadersAvailable()
 {
     return shadersAvailable;
@@ -364,15 +508,73 @@ void GLUtil::setShaderEnable( bool es )
     enableShaders = es;
 }
 
+bool GLUtil::areNPOTTexturesAvailable()
+{
+    return NPOTAvailable;
+}
+
+bool GLUtil::isPlanarYUVAvailable()
+{
+    return planarYUVAvailable;
+}
+
+bool GLUtil::arePBOsAvailable()
+{
+    return PBOsAvailable;
+}
+
+void GLUtil::setPBOEnable( bool ep )
+{
+    enablePBOs = ep;
+}
+
+bool GLUtil::areMipmapsAvailable()
+{
+    return mipmapsAvailable;
+}
+
+void GLUtil::generateMipmaps()
+{
+    if ( useEXTMipmaps )
+        glGenerateMipmapEXT( GL_TEXTURE_2D );
+    else
+        glGenerateMipmap( GL_TEXTURE_2D );
+}
+
 void GLUtil::setBufferFontUsage( bool buf )
 {
     useBufferFont = buf;
 }
 
+void GLUtil::setPixelScale( float s )
+{
+    pixelScale = s;
+}
+
+float GLUtil::getPixelScale()
+{
+    return pixelScale;
+}
+
 GLUtil::GLUtil()
 {
     enableShaders = false;
+    shadersAvailable = false;
+    enablePBOs = true;
+    PBOsAvailable = false;
+    NPOTAvailable = false;
+    planarYUVAvailable = false;
+    mipmapsAvailable = false;
+    useEXTMipmaps = false;
+    YUV420Program = 0;
+    YUV420PlanarProgram = 0;
+    YUV420BatchProgram = 0;
+    YUV420PlanarBatchProgram = 0;
     useBufferFont = false;
+    textFont = NULL;
+    textMetrics = NULL;
+    enableSDFText = true;
+    pixelScale = 0.0f;
 
     frag420 =
     "uniform sampler2D texture;\n"
@@ -418,9 +620,128 @@ GLUtil::GLUtil()
     "\n"
     "    gl_Position = ftransform();\n"
     "}\n";
+
+    // planar version: each plane is its own exact-size texture, so no offset
+    // math is needed, just the same vertical flip as above
+    frag420Planar =
+    "uniform sampler2D yTex;\n"
+    "uniform sampler2D uTex;\n"
+    "uniform sampler2D vTex;\n"
+    "uniform float alpha;\n"
+    "\n"
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    float y = texture2D( yTex, texCoord ).r;\n"
+    "    float u = texture2D( uTex, texCoord ).r;\n"
+    "    float v = texture2D( vTex, texCoord ).r;\n"
+    "\n"
+    "    float cb = u - 0.5;\n"
+    "    float cr = v - 0.5;\n"
+    "\n"
+    "    gl_FragColor = vec4( y + (cr*1.3874),\n"
+    "                         y - (cb*0.7109) - (cr*0.3438),\n"
+    "                         y + (cb*1.7734),\n"
+    "                         alpha );\n"
+    "}\n";
+
+    vert420Planar =
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    texCoord.s = gl_MultiTexCoord0.s;\n"
+    "    texCoord.t = 1.0 - gl_MultiTexCoord0.t;\n"
+    "\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+    // batched versions: same math, but the per-video values come in with
+    // the vertices (offsets as texcoord set 1, alpha as the color)
+    frag420Batch =
+    "uniform sampler2D texture;\n"
+    "\n"
+    "varying vec2 yCoord;\n"
+    "varying vec2 uCoord;\n"
+    "varying vec2 vCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    float y = texture2D( texture, yCoord ).r;\n"
+    "    float u = texture2D( texture, uCoord ).r;\n"
+    "    float v = texture2D( texture, vCoord ).r;\n"
+    "\n"
+    "    float cb = u - 0.5;\n"
+    "    float cr = v - 0.5;\n"
+    "\n"
+    "    gl_FragColor = vec4( y + (cr*1.3874),\n"
+    "                         y - (cb*0.7109) - (cr*0.3438),\n"
+    "                         y + (cb*1.7734),\n"
+    "                         gl_Color.a );\n"
+    "}\n";
+
+    vert420Batch =
+    "varying vec2 yCoord;\n"
+    "varying vec2 uCoord;\n"
+    "varying vec2 vCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    float xOffset = gl_MultiTexCoord1.s;\n"
+    "    float yOffset = gl_MultiTexCoord1.t;\n"
+    "\n"
+    "    yCoord.s = gl_MultiTexCoord0.s;\n"
+    "    yCoord.t = yOffset - gl_MultiTexCoord0.t;\n"
+    "\n"
+    "    uCoord.s = (gl_MultiTexCoord0.s/2.0);\n"
+    "    uCoord.t = (3.0*yOffset/2.0) - (gl_MultiTexCoord0.t/2.0);\n"
+    "\n"
+    "    vCoord.s = uCoord.s + xOffset/2.0;\n"
+    "    vCoord.t = uCoord.t;\n"
+    "\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+    frag420PlanarBatch =
+    "uniform sampler2D yTex;\n"
+    "uniform sampler2D uTex;\n"
+    "uniform sampler2D vTex;\n"
+    "\n"
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    float y = texture2D( yTex, texCoord ).r;\n"
+    "    float u = texture2D( uTex, texCoord ).r;\n"
+    "    float v = texture2D( vTex, texCoord ).r;\n"
+    "\n"
+    "    float cb = u - 0.5;\n"
+    "    float cr = v - 0.5;\n"
+    "\n"
+    "    gl_FragColor = vec4( y + (cr*1.3874),\n"
+    "                         y - (cb*0.7109) - (cr*0.3438),\n"
+    "                         y + (cb*1.7734),\n"
+    "                         gl_Color.a );\n"
+    "}\n";
+
+    vert420PlanarBatch =
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    texCoord.s = gl_MultiTexCoord0.s;\n"
+    "    texCoord.t = 1.0 - gl_MultiTexCoord0.t;\n"
+    "\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
 }
 
 GLUtil::~GLUtil()
 {
     delete mainFont;
+    delete textFont;
+    delete textMetrics;
 }
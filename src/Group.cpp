@@ -60,6 +60,29 @@ void Group::draw()
     }
 }
 
+void Group::batchBorder( BatchRenderer* b )
+{
+    RectangleBase::batchBorder( b );
+
+    for ( unsigned int i = 0; i < objects.size(); i++ )
+    {
+        objects[i]->batchBorder( b );
+    }
+}
+
+bool Group::canBatchBorder()
+{
+    if ( !RectangleBase::canBatchBorder() )
+        return false;
+
+    for ( unsigned int i = 0; i < objects.size(); i++ )
+    {
+        if ( !objects[i]->canBatchBorder() )
+            return false;
+    }
+    return true;
+}
+
 void Group::add( RectangleBase* object )
 {
     objects.push_back( object );
@@ -385,3 +408,8 @@ void Group::setRendering( bool r )
         }
     }
 }
+
+bool Group::isHidingMembers()
+{
+    return allowHiding && !enableRendering;
+}
@@ -0,0 +1,816 @@
+/*
+ * @file LoadGenerator.cpp
+ *
+ * Standalone RTP load generator for testing grav against a big venue on one
+ * machine. Encodes a loop of test pattern frames to H.264 with libavcodec,
+ * then sends it out as any number of concurrent RTP streams (payload type 96,
+ * as grav maps it), each with its own SSRC, sequence numbers & timestamps, and
+ * RTCP sender reports with SDES NAME/CNAME/LOC and vic-style "site" APP
+ * packets so the streams get grouped by site like a real venue.
+ *
+ * Usage: grav-loadgen [-n streams] [-s WxH] [-r fps] [-b kbps] [-g streams
+ *                     per site] [-l loop seconds] [-v variants] [-p packet
+ *                     size] [-t ttl] [-d seconds] address/port
+ *
+ * Every stream sends the same encoded loop (or one of a few variants, with
+ * -v), so encoding cost doesn't grow with the number of streams - grav still
+ * has to decode every one of them separately.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/opt.h>
+}
+
+// older ffmpeg only has the old names
+#if LIBAVUTIL_VERSION_INT < AV_VERSION_INT(51,42,0)
+#define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
+#endif
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(54,25,0)
+#define AV_CODEC_ID_H264 CODEC_ID_H264
+#endif
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,28,1)
+#define av_frame_alloc avcodec_alloc_frame
+#define av_frame_free avcodec_free_frame
+#endif
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,52,0)
+static void avcodec_free_context( AVCodecContext** ctx )
+{
+    avcodec_close( *ctx );
+    av_freep( ctx );
+}
+#endif
+
+// same as in gravApp::mapRTP
+static const int h264PayloadType = 96;
+static const int rtpClockRate = 90000;
+// seconds between NTP's epoch (1900) and unix's
+static const uint32_t ntpOffset = 2208988800u;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleSignal( int sig )
+{
+    stopRequested = 1;
+}
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/*
+ * One encoded frame, as the NAL units that make it up (without start codes).
+ */
+typedef std::vector< std::vector<uint8_t> > AccessUnit;
+
+struct Stream
+{
+    uint32_t ssrc;
+    uint16_t seq;
+    uint32_t timestampBase;
+    int variant;
+
+    // total frames sent, and where in the loop we are
+    unsigned long framesSent;
+    unsigned int loopPos;
+    double nextFrameTime;
+    double nextRTCPTime;
+
+    uint32_t packetCount;
+    uint32_t octetCount;
+
+    std::string cname;
+    std::string name;
+    std::string loc;
+    std::string site;
+};
+
+struct Options
+{
+    unsigned int streams;
+    unsigned int width, height;
+    unsigned int fps;
+    unsigned int kbps;
+    unsigned int streamsPerSite;
+    unsigned int loopSeconds;
+    unsigned int variants;
+    unsigned int packetSize;
+    int ttl;
+    double duration;
+    std::string address;
+};
+
+static void printUsage( const char* name )
+{
+    fprintf( stderr,
+        "usage: %s [options] address/port\n"
+        "  -n <num>    number of streams (default 16)\n"
+        "  -s <WxH>    frame size (default 640x480)\n"
+        "  -r <num>    frames per second (default 15)\n"
+        "  -b <num>    kbit/s per stream (default 500)\n"
+        "  -g <num>    streams per site, for site grouping (default 2)\n"
+        "  -l <num>    seconds of video to encode & loop, one keyframe per\n"
+        "              loop (default 4)\n"
+        "  -v <num>    number of differently encoded loops to spread over\n"
+        "              the streams (default 1)\n"
+        "  -p <num>    largest RTP packet to send, in bytes (default 1200)\n"
+        "  -t <num>    multicast TTL (default 1)\n"
+        "  -d <num>    seconds to run for, 0 for until interrupted (default "
+        "0)\n", name );
+}
+
+static bool parseOptions( int argc, char* argv[], Options& opt )
+{
+    opt.streams = 16;
+    opt.width = 640;
+    opt.height = 480;
+    opt.fps = 15;
+    opt.kbps = 500;
+    opt.streamsPerSite = 2;
+    opt.loopSeconds = 4;
+    opt.variants = 1;
+    opt.packetSize = 1200;
+    opt.ttl = 1;
+    opt.duration = 0.0;
+
+    int c;
+    while ( ( c = getopt( argc, argv, "n:s:r:b:g:l:v:p:t:d:h" ) ) != -1 )
+    {
+        switch ( c )
+        {
+        case 'n': opt.streams = atoi( optarg ); break;
+        case 's':
+            if ( sscanf( optarg, "%ux%u", &opt.width, &opt.height ) != 2 )
+                return false;
+            break;
+        case 'r': opt.fps = atoi( optarg ); break;
+        case 'b': opt.kbps = atoi( optarg ); break;
+        case 'g': opt.streamsPerSite = atoi( optarg ); break;
+        case 'l': opt.loopSeconds = atoi( optarg ); break;
+        case 'v': opt.variants = atoi( optarg ); break;
+        case 'p': opt.packetSize = atoi( optarg ); break;
+        case 't': opt.ttl = atoi( optarg ); break;
+        case 'd': opt.duration = atof( optarg ); break;
+        default: return false;
+        }
+    }
+
+    if ( optind != argc - 1 )
+        return false;
+    opt.address = argv[ optind ];
+
+    // 4:2:0 needs even dimensions, & the FU-A headers need some room
+    return opt.streams > 0 && opt.width >= 16 && opt.height >= 16 &&
+            opt.width % 2 == 0 && opt.height % 2 == 0 && opt.fps > 0 &&
+            opt.kbps > 0 && opt.streamsPerSite > 0 && opt.loopSeconds > 0 &&
+            opt.variants > 0 && opt.packetSize >= 64 &&
+            opt.packetSize <= 65000;
+}
+
+/*
+ * Moving color bars plus a bouncing box, different for each variant.
+ */
+static void fillFrame( uint8_t* y, uint8_t* u, uint8_t* v, unsigned int w,
+                        unsigned int h, unsigned int frame, unsigned int phase )
+{
+    static const uint8_t bars[8][3] = {
+        { 180, 128, 128 }, { 162, 44, 142 }, { 131, 156, 44 },
+        { 112, 72, 58 }, { 84, 184, 198 }, { 65, 100, 212 },
+        { 35, 212, 114 }, { 16, 128, 128 } };
+    unsigned int offset = ( frame * 8 + phase ) % w;
+
+    for ( unsigned int row = 0; row < h; row++ )
+        for ( unsigned int col = 0; col < w; col++ )
+            y[ row*w + col ] = bars[ ( ( ( col + offset ) % w ) * 8 ) / w ][0];
+    for ( unsigned int row = 0; row < h/2; row++ )
+    {
+        for ( unsigned int col = 0; col < w/2; col++ )
+        {
+            int bar = ( ( ( col*2 + offset ) % w ) * 8 ) / w;
+            u[ row*(w/2) + col ] = bars[ bar ][1];
+            v[ row*(w/2) + col ] = bars[ bar ][2];
+        }
+    }
+
+    unsigned int box = ( w < h ? w : h ) / 8;
+    unsigned int rangeX = w - box, rangeY = h - box;
+    unsigned int bx = ( frame * 6 + phase ) % ( rangeX * 2 );
+    unsigned int by = ( frame * 4 + phase ) % ( rangeY * 2 );
+    if ( bx > rangeX ) bx = rangeX * 2 - bx;
+    if ( by > rangeY ) by = rangeY * 2 - by;
+    for ( unsigned int row = by; row < by + box; row++ )
+        memset( y + row*w + bx, 235, box );
+}
+
+/*
+ * Split Annex B output (start code delimited) into NAL units, adding them to
+ * the given access unit.
+ */
+static void splitNALs( const uint8_t* data, int size, AccessUnit& au )
+{
+    int start = -1;
+    int i = 0;
+    while ( i + 2 < size )
+    {
+        if ( data[i] == 0 && data[i+1] == 0 && data[i+2] == 1 )
+        {
+            if ( start >= 0 )
+            {
+                // a 4 byte start code's extra zero isn't part of the NAL
+                int end = i;
+                if ( end > start && data[ end-1 ] == 0 )
+                    end--;
+                au.push_back( std::vector<uint8_t>( data + start,
+                                                    data + end ) );
+            }
+            i += 3;
+            start = i;
+        }
+        else
+            i++;
+    }
+    if ( start >= 0 && start < size )
+        au.push_back( std::vector<uint8_t>( data + start, data + size ) );
+}
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,37,100)
+static bool receivePackets( AVCodecContext* ctx,
+                            std::vector<AccessUnit>& frames )
+{
+    AVPacket* pkt = av_packet_alloc();
+    while ( avcodec_receive_packet( ctx, pkt ) == 0 )
+    {
+        frames.push_back( AccessUnit() );
+        splitNALs( pkt->data, pkt->size, frames.back() );
+        av_packet_unref( pkt );
+    }
+    av_packet_free( &pkt );
+    return true;
+}
+#endif
+
+/*
+ * Encode a loop of frames, with a keyframe at the start of the loop only, so
+ * it can be sent over & over.
+ */
+static bool encodeLoop( const Options& opt, unsigned int phase,
+                        std::vector<AccessUnit>& frames )
+{
+    AVCodec* codec = (AVCodec*)avcodec_find_encoder( AV_CODEC_ID_H264 );
+    if ( codec == NULL )
+    {
+        fprintf( stderr, "no H.264 encoder available (is ffmpeg built with "
+                 "libx264?)\n" );
+        return false;
+    }
+
+    unsigned int loopFrames = opt.fps * opt.loopSeconds;
+
+    AVCodecContext* ctx = avcodec_alloc_context3( codec );
+    ctx->width = opt.width;
+    ctx->height = opt.height;
+    ctx->time_base.num = 1;
+    ctx->time_base.den = opt.fps;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->bit_rate = opt.kbps * 1000;
+    ctx->gop_size = loopFrames;
+    // no reordering, like a live conferencing encoder
+    ctx->max_b_frames = 0;
+    // x264 specific, harmless if it's some other encoder
+    av_opt_set( ctx->priv_data, "preset", "veryfast", 0 );
+    av_opt_set( ctx->priv_data, "tune", "zerolatency", 0 );
+    av_opt_set( ctx->priv_data, "profile", "baseline", 0 );
+
+    if ( avcodec_open2( ctx, codec, NULL ) < 0 )
+    {
+        fprintf( stderr, "couldn't open H.264 encoder\n" );
+        avcodec_free_context( &ctx );
+        return false;
+    }
+
+    unsigned int w = opt.width, h = opt.height;
+    std::vector<uint8_t> buffer( w * h * 3 / 2 );
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = w;
+    frame->height = h;
+    frame->data[0] = &buffer[0];
+    frame->data[1] = frame->data[0] + w * h;
+    frame->data[2] = frame->data[1] + ( w / 2 ) * ( h / 2 );
+    frame->linesize[0] = w;
+    frame->linesize[1] = w / 2;
+    frame->linesize[2] = w / 2;
+
+    bool ok = true;
+    for ( unsigned int i = 0; i < loopFrames && ok; i++ )
+    {
+        fillFrame( frame->data[0], frame->data[1], frame->data[2], w, h, i,
+                    phase );
+        frame->pts = i;
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,37,100)
+        ok = avcodec_send_frame( ctx, frame ) >= 0 &&
+                receivePackets( ctx, frames );
+#else
+        AVPacket pkt;
+        av_init_packet( &pkt );
+        pkt.data = NULL;
+        pkt.size = 0;
+        int gotPacket = 0;
+        ok = avcodec_encode_video2( ctx, &pkt, frame, &gotPacket ) >= 0;
+        if ( ok && gotPacket )
+        {
+            frames.push_back( AccessUnit() );
+            splitNALs( pkt.data, pkt.size, frames.back() );
+            av_free_packet( &pkt );
+        }
+#endif
+    }
+
+    // get anything the encoder was holding on to
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,37,100)
+    if ( ok && avcodec_send_frame( ctx, NULL ) >= 0 )
+        receivePackets( ctx, frames );
+#else
+    while ( ok )
+    {
+        AVPacket pkt;
+        av_init_packet( &pkt );
+        pkt.data = NULL;
+        pkt.size = 0;
+        int gotPacket = 0;
+        if ( avcodec_encode_video2( ctx, &pkt, NULL, &gotPacket ) < 0 ||
+                !gotPacket )
+            break;
+        frames.push_back( AccessUnit() );
+        splitNALs( pkt.data, pkt.size, frames.back() );
+        av_free_packet( &pkt );
+    }
+#endif
+
+    av_frame_free( &frame );
+    avcodec_free_context( &ctx );
+
+    if ( !ok || frames.empty() )
+    {
+        fprintf( stderr, "encoding failed\n" );
+        return false;
+    }
+    return true;
+}
+
+static int openSocket( const std::string& host, unsigned int port, int ttl,
+                        struct sockaddr_storage* dest, socklen_t* destLen )
+{
+    struct addrinfo hints;
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    std::ostringstream portS;
+    portS << port;
+    struct addrinfo* res;
+    if ( getaddrinfo( host.c_str(), portS.str().c_str(), &hints, &res ) != 0 )
+    {
+        fprintf( stderr, "couldn't resolve %s\n", host.c_str() );
+        return -1;
+    }
+
+    int sock = socket( res->ai_family, SOCK_DGRAM, 0 );
+    if ( sock < 0 )
+    {
+        perror( "socket" );
+        freeaddrinfo( res );
+        return -1;
+    }
+
+    memcpy( dest, res->ai_addr, res->ai_addrlen );
+    *destLen = res->ai_addrlen;
+
+    // keyframes for a lot of streams can go out at once
+    int bufSize = 4 * 1024 * 1024;
+    setsockopt( sock, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof( bufSize ) );
+
+    if ( res->ai_family == AF_INET )
+    {
+        struct sockaddr_in* sin = (struct sockaddr_in*)res->ai_addr;
+        if ( IN_MULTICAST( ntohl( sin->sin_addr.s_addr ) ) )
+        {
+            unsigned char t = ttl;
+            setsockopt( sock, IPPROTO_IP, IP_MULTICAST_TTL, &t, sizeof( t ) );
+        }
+    }
+    else if ( res->ai_family == AF_INET6 )
+    {
+        struct sockaddr_in6* sin6 = (struct sockaddr_in6*)res->ai_addr;
+        if ( IN6_IS_ADDR_MULTICAST( &sin6->sin6_addr ) )
+            setsockopt( sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl,
+                        sizeof( ttl ) );
+    }
+
+    freeaddrinfo( res );
+    return sock;
+}
+
+static void put16( uint8_t* p, uint16_t v )
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static void put32( uint8_t* p, uint32_t v )
+{
+    p[0] = v >> 24;
+    p[1] = ( v >> 16 ) & 0xFF;
+    p[2] = ( v >> 8 ) & 0xFF;
+    p[3] = v & 0xFF;
+}
+
+struct Sender
+{
+    int rtpSock;
+    int rtcpSock;
+    struct sockaddr_storage rtpDest;
+    struct sockaddr_storage rtcpDest;
+    socklen_t rtpDestLen;
+    socklen_t rtcpDestLen;
+    unsigned int maxPayload;
+
+    unsigned long packetsSent;
+    unsigned long bytesSent;
+    unsigned long sendErrors;
+};
+
+static void sendRTP( Sender& sender, Stream& stream, uint32_t timestamp,
+                        bool marker, const uint8_t* header,
+                        unsigned int headerLen, const uint8_t* payload,
+                        unsigned int payloadLen )
+{
+    uint8_t packet[ 65536 ];
+    packet[0] = 0x80;
+    packet[1] = ( marker ? 0x80 : 0 ) | h264PayloadType;
+    put16( packet + 2, stream.seq++ );
+    put32( packet + 4, timestamp );
+    put32( packet + 8, stream.ssrc );
+    if ( headerLen > 0 )
+        memcpy( packet + 12, header, headerLen );
+    memcpy( packet + 12 + headerLen, payload, payloadLen );
+
+    unsigned int len = 12 + headerLen + payloadLen;
+    if ( sendto( sender.rtpSock, packet, len, 0,
+                 (struct sockaddr*)&sender.rtpDest, sender.rtpDestLen ) < 0 )
+    {
+        sender.sendErrors++;
+        return;
+    }
+
+    stream.packetCount++;
+    stream.octetCount += headerLen + payloadLen;
+    sender.packetsSent++;
+    sender.bytesSent += len;
+}
+
+/*
+ * Packetize one frame per RFC 6184: NAL units that fit go as single NAL unit
+ * packets, bigger ones get split into FU-As. Marker on the frame's last
+ * packet.
+ */
+static void sendFrame( Sender& sender, Stream& stream, const AccessUnit& au,
+                        uint32_t timestamp )
+{
+    for ( unsigned int n = 0; n < au.size(); n++ )
+    {
+        const std::vector<uint8_t>& nal = au[n];
+        if ( nal.empty() )
+            continue;
+        bool lastNAL = n == au.size() - 1;
+
+        if ( nal.size() <= sender.maxPayload )
+        {
+            sendRTP( sender, stream, timestamp, lastNAL, NULL, 0, &nal[0],
+                        nal.size() );
+            continue;
+        }
+
+        uint8_t fu[2];
+        fu[0] = ( nal[0] & 0xE0 ) | 28;
+        unsigned int pos = 1;
+        unsigned int chunk = sender.maxPayload - 2;
+        while ( pos < nal.size() )
+        {
+            unsigned int len = nal.size() - pos;
+            if ( len > chunk )
+                len = chunk;
+            bool first = pos == 1;
+            bool last = pos + len == nal.size();
+            fu[1] = ( first ? 0x80 : 0 ) | ( last ? 0x40 : 0 ) |
+                        ( nal[0] & 0x1F );
+            sendRTP( sender, stream, timestamp, last && lastNAL, fu, 2,
+                        &nal[ pos ], len );
+            pos += len;
+        }
+    }
+}
+
+static unsigned int addSDESItem( uint8_t* p, uint8_t type,
+                                    const std::string& value )
+{
+    unsigned int len = value.size() > 255 ? 255 : value.size();
+    p[0] = type;
+    p[1] = len;
+    memcpy( p + 2, value.data(), len );
+    return len + 2;
+}
+
+/*
+ * Compound RTCP: sender report, SDES with CNAME/NAME/LOC, then the site APP
+ * that vic/grav use for grouping. With bye set, just a BYE after the SR.
+ */
+static void sendRTCP( Sender& sender, Stream& stream, uint32_t timestamp,
+                        bool bye )
+{
+    uint8_t packet[ 1500 ];
+    unsigned int len = 0;
+
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+
+    // SR, no report blocks since we don't receive anything
+    packet[0] = 0x80;
+    packet[1] = 200;
+    put16( packet + 2, 6 );
+    put32( packet + 4, stream.ssrc );
+    put32( packet + 8, (uint32_t)tv.tv_sec + ntpOffset );
+    put32( packet + 12, (uint32_t)( (double)tv.tv_usec * 4294.967296 ) );
+    put32( packet + 16, timestamp );
+    put32( packet + 20, stream.packetCount );
+    put32( packet + 24, stream.octetCount );
+    len = 28;
+
+    if ( bye )
+    {
+        packet[ len ] = 0x81;
+        packet[ len+1 ] = 203;
+        put16( packet + len + 2, 1 );
+        put32( packet + len + 4, stream.ssrc );
+        len += 8;
+    }
+    else
+    {
+        unsigned int sdes = len;
+        packet[ sdes ] = 0x81;
+        packet[ sdes+1 ] = 202;
+        put32( packet + sdes + 4, stream.ssrc );
+        len += 8;
+        len += addSDESItem( packet + len, 1, stream.cname );
+        len += addSDESItem( packet + len, 2, stream.name );
+        len += addSDESItem( packet + len, 5, stream.loc );
+        // end of items, then pad the chunk to a word boundary
+        packet[ len++ ] = 0;
+        while ( len % 4 != 0 )
+            packet[ len++ ] = 0;
+        put16( packet + sdes + 2, ( len - sdes ) / 4 - 1 );
+
+        unsigned int app = len;
+        packet[ app ] = 0x80;
+        packet[ app+1 ] = 204;
+        put32( packet + app + 4, stream.ssrc );
+        memcpy( packet + app + 8, "site", 4 );
+        len += 12;
+        memcpy( packet + len, stream.site.data(), stream.site.size() );
+        len += stream.site.size();
+        while ( len % 4 != 0 )
+            packet[ len++ ] = 0;
+        put16( packet + app + 2, ( len - app ) / 4 - 1 );
+    }
+
+    if ( sendto( sender.rtcpSock, packet, len, 0,
+                 (struct sockaddr*)&sender.rtcpDest,
+                 sender.rtcpDestLen ) < 0 )
+        sender.sendErrors++;
+}
+
+/*
+ * RFC 3550's minimum interval, randomized so streams don't line up.
+ */
+static double nextRTCPInterval()
+{
+    return 5.0 * ( 0.5 + (double)rand() / RAND_MAX );
+}
+
+int main( int argc, char* argv[] )
+{
+    Options opt;
+    if ( !parseOptions( argc, argv, opt ) )
+    {
+        printUsage( argv[0] );
+        return 1;
+    }
+
+    size_t slash = opt.address.rfind( '/' );
+    if ( slash == std::string::npos )
+    {
+        fprintf( stderr, "address should be in the format address/port\n" );
+        return 1;
+    }
+    std::string host = opt.address.substr( 0, slash );
+    unsigned int port = atoi( opt.address.substr( slash + 1 ).c_str() );
+    if ( port == 0 || port > 65534 )
+    {
+        fprintf( stderr, "invalid port\n" );
+        return 1;
+    }
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58,9,100)
+    avcodec_register_all();
+#endif
+
+    std::vector< std::vector<AccessUnit> > variants( opt.variants );
+    for ( unsigned int v = 0; v < opt.variants; v++ )
+    {
+        printf( "encoding %u frames of %ux%u for variant %u...\n",
+                opt.fps * opt.loopSeconds, opt.width, opt.height, v + 1 );
+        if ( !encodeLoop( opt, v * 131, variants[v] ) )
+            return 1;
+    }
+
+    Sender sender;
+    sender.rtpSock = openSocket( host, port, opt.ttl, &sender.rtpDest,
+                                    &sender.rtpDestLen );
+    sender.rtcpSock = openSocket( host, port + 1, opt.ttl, &sender.rtcpDest,
+                                    &sender.rtcpDestLen );
+    if ( sender.rtpSock < 0 || sender.rtcpSock < 0 )
+        return 1;
+    sender.maxPayload = opt.packetSize - 12;
+    sender.packetsSent = 0;
+    sender.bytesSent = 0;
+    sender.sendErrors = 0;
+
+    char hostname[256];
+    if ( gethostname( hostname, sizeof( hostname ) ) != 0 )
+        strcpy( hostname, "localhost" );
+    hostname[ sizeof( hostname ) - 1 ] = '\0';
+
+    double start = getTime();
+    double frameInterval = 1.0 / opt.fps;
+    srand( (unsigned int)( start * 1000.0 ) );
+
+    std::vector<Stream> streams( opt.streams );
+    for ( unsigned int i = 0; i < opt.streams; i++ )
+    {
+        Stream& s = streams[i];
+        unsigned int site = i / opt.streamsPerSite;
+        s.ssrc = ( (uint32_t)rand() << 16 ) ^ (uint32_t)rand() ^ i;
+        s.seq = rand() & 0xFFFF;
+        s.timestampBase = ( (uint32_t)rand() << 16 ) ^ (uint32_t)rand();
+        s.variant = i % opt.variants;
+        s.framesSent = 0;
+        s.loopPos = 0;
+        // spread the streams over the frame interval, & send RTCP right
+        // away so names & sites show up with the video
+        s.nextFrameTime = start + frameInterval * i / opt.streams;
+        s.nextRTCPTime = s.nextFrameTime;
+        s.packetCount = 0;
+        s.octetCount = 0;
+
+        std::ostringstream cname, name, loc, siteS;
+        cname << "loadgen" << i << "@" << hostname;
+        name << "Loadgen site " << ( site + 1 ) << " camera " <<
+                ( i % opt.streamsPerSite + 1 );
+        // spread the sites around the globe
+        loc << ( -60 + (int)( ( site * 37 ) % 120 ) ) << "," <<
+                ( -180 + (int)( ( site * 73 ) % 360 ) );
+        // grav only looks at the first 32 characters of this
+        siteS << "loadgen-site-" << ( site + 1 );
+        s.cname = cname.str();
+        s.name = name.str();
+        s.loc = loc.str();
+        s.site = siteS.str();
+    }
+
+    signal( SIGINT, handleSignal );
+    signal( SIGTERM, handleSignal );
+
+    printf( "sending %u streams (%u sites) to %s, ports %u/%u\n",
+            opt.streams, ( opt.streams + opt.streamsPerSite - 1 ) /
+            opt.streamsPerSite, host.c_str(), port, port + 1 );
+
+    double statsTime = start;
+    unsigned long statsPackets = 0, statsBytes = 0, lateFrames = 0;
+
+    while ( !stopRequested &&
+            ( opt.duration <= 0.0 || getTime() - start < opt.duration ) )
+    {
+        double now = getTime();
+        // wake up at least this often so stopping doesn't take long
+        double nextWake = now + 0.05;
+
+        for ( unsigned int i = 0; i < streams.size(); i++ )
+        {
+            Stream& s = streams[i];
+            const std::vector<AccessUnit>& loop = variants[ s.variant ];
+
+            if ( now >= s.nextFrameTime )
+            {
+                uint32_t ts = s.timestampBase + (uint32_t)( s.framesSent *
+                                    rtpClockRate / opt.fps );
+                sendFrame( sender, s, loop[ s.loopPos ], ts );
+                s.framesSent++;
+                s.loopPos = ( s.loopPos + 1 ) % loop.size();
+
+                s.nextFrameTime += frameInterval;
+                // drop behind rather than bursting to catch up
+                if ( s.nextFrameTime < now )
+                {
+                    s.nextFrameTime = now + frameInterval;
+                    lateFrames++;
+                }
+            }
+
+            if ( now >= s.nextRTCPTime )
+            {
+                uint32_t ts = s.timestampBase + (uint32_t)( s.framesSent *
+                                    rtpClockRate / opt.fps );
+                sendRTCP( sender, s, ts, false );
+                s.nextRTCPTime = now + nextRTCPInterval();
+            }
+
+            if ( s.nextFrameTime < nextWake )
+                nextWake = s.nextFrameTime;
+        }
+
+        if ( now - statsTime >= 5.0 )
+        {
+            double elapsed = now - statsTime;
+            printf( "%.0f packets/s, %.2f Mbit/s, %lu late frames, %lu send "
+                    "errors\n",
+                    ( sender.packetsSent - statsPackets ) / elapsed,
+                    ( sender.bytesSent - statsBytes ) * 8.0 /
+                        ( elapsed * 1000000.0 ), lateFrames,
+                    sender.sendErrors );
+            statsTime = now;
+            statsPackets = sender.packetsSent;
+            statsBytes = sender.bytesSent;
+            lateFrames = 0;
+        }
+
+        double wait = nextWake - getTime();
+        if ( wait > 0.0 )
+            usleep( (useconds_t)( wait * 1000000.0 ) );
+    }
+
+    // let grav know they're gone rather than waiting for them to time out
+    for ( unsigned int i = 0; i < streams.size(); i++ )
+    {
+        Stream& s = streams[i];
+        uint32_t ts = s.timestampBase + (uint32_t)( s.framesSent *
+                            rtpClockRate / opt.fps );
+        sendRTCP( sender, s, ts, true );
+    }
+
+    printf( "sent %lu packets, %lu bytes\n", sender.packetsSent,
+            sender.bytesSent );
+
+    close( sender.rtpSock );
+    close( sender.rtcpSock );
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * @file OffscreenContext.cpp
+ *
+ * Implementation of the OffscreenContext class. See OffscreenContext.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OffscreenContext.h"
+#include "gravUtil.h"
+
+#include <cstring>
+
+#ifdef GRAV_HAVE_EGL
+#include <EGL/eglext.h>
+
+// from EGL_MESA_platform_surfaceless, for older headers
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef EGLDisplay (*GetPlatformDisplayFunc)( EGLenum, void*, const EGLint* );
+#endif
+
+OffscreenContext::OffscreenContext()
+{
+    width = 0;
+    height = 0;
+    fbo = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+
+#ifdef GRAV_HAVE_EGL
+    display = EGL_NO_DISPLAY;
+    surface = EGL_NO_SURFACE;
+    context = EGL_NO_CONTEXT;
+#endif
+}
+
+OffscreenContext::~OffscreenContext()
+{
+#ifdef GRAV_HAVE_EGL
+    if ( fbo != 0 )
+    {
+        if ( GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object )
+        {
+            glDeleteFramebuffers( 1, &fbo );
+            glDeleteRenderbuffers( 1, &colorBuffer );
+            glDeleteRenderbuffers( 1, &depthBuffer );
+        }
+        else
+        {
+            glDeleteFramebuffersEXT( 1, &fbo );
+            glDeleteRenderbuffersEXT( 1, &colorBuffer );
+            glDeleteRenderbuffersEXT( 1, &depthBuffer );
+        }
+    }
+
+    if ( display != EGL_NO_DISPLAY )
+    {
+        eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        EGL_NO_CONTEXT );
+        if ( context != EGL_NO_CONTEXT )
+            eglDestroyContext( display, context );
+        if ( surface != EGL_NO_SURFACE )
+            eglDestroySurface( display, surface );
+        eglTerminate( display );
+    }
+#endif
+}
+
+bool OffscreenContext::create( int w, int h )
+{
+    width = w;
+    height = h;
+
+#ifdef GRAV_HAVE_EGL
+    // without an X server the default display may not work, so go for Mesa's
+    // surfaceless platform if it's there
+    const char* clientExts = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+    if ( clientExts != NULL &&
+            strstr( clientExts, "EGL_MESA_platform_surfaceless" ) != NULL )
+    {
+        GetPlatformDisplayFunc getPlatformDisplay = (GetPlatformDisplayFunc)
+                eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+        if ( getPlatformDisplay != NULL )
+            display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, NULL );
+    }
+    if ( display == EGL_NO_DISPLAY )
+        display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+    EGLint major, minor;
+    if ( display == EGL_NO_DISPLAY ||
+            !eglInitialize( display, &major, &minor ) )
+    {
+        gravUtil::logError( "OffscreenContext::create: couldn't initialise "
+                "EGL\n" );
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+    gravUtil::logVerbose( "OffscreenContext::create: EGL %i.%i, %s\n", major,
+            minor, eglQueryString( display, EGL_VENDOR ) );
+
+    // grav uses the fixed function pipeline, so it needs desktop GL
+    if ( !eglBindAPI( EGL_OPENGL_API ) )
+    {
+        gravUtil::logError( "OffscreenContext::create: EGL doesn't support "
+                "desktop OpenGL\n" );
+        return false;
+    }
+
+    EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8, EGL_DEPTH_SIZE, 24,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_NONE };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    bool havePbufferConfig = eglChooseConfig( display, configAttribs, &config,
+                                                1, &numConfigs ) &&
+                                numConfigs > 0;
+
+    if ( havePbufferConfig )
+    {
+        EGLint surfaceAttribs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+        surface = eglCreatePbufferSurface( display, config, surfaceAttribs );
+    }
+
+    if ( surface == EGL_NO_SURFACE )
+    {
+        // no pbuffers, so take any config & draw into an FBO instead
+        EGLint fboConfigAttribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, 0,
+            EGL_NONE };
+        if ( !eglChooseConfig( display, fboConfigAttribs, &config, 1,
+                                &numConfigs ) || numConfigs == 0 )
+        {
+            gravUtil::logError( "OffscreenContext::create: no usable EGL "
+                    "config\n" );
+            return false;
+        }
+        gravUtil::logVerbose( "OffscreenContext::create: no pbuffer, "
+                "rendering to an FBO\n" );
+    }
+
+    context = eglCreateContext( display, config, EGL_NO_CONTEXT, NULL );
+    if ( context == EGL_NO_CONTEXT )
+    {
+        gravUtil::logError( "OffscreenContext::create: couldn't create "
+                "context\n" );
+        return false;
+    }
+
+    if ( !eglMakeCurrent( display, surface, surface, context ) )
+    {
+        gravUtil::logError( "OffscreenContext::create: couldn't make context "
+                "current\n" );
+        return false;
+    }
+
+    return true;
+#else
+    gravUtil::logError( "OffscreenContext::create: grav was built without "
+            "EGL, so headless rendering isn't available\n" );
+    return false;
+#endif
+}
+
+bool OffscreenContext::initTarget()
+{
+#ifdef GRAV_HAVE_EGL
+    if ( surface != EGL_NO_SURFACE )
+        return true;
+
+    GLenum status;
+    if ( GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object )
+    {
+        glGenFramebuffers( 1, &fbo );
+        glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+        glGenRenderbuffers( 1, &colorBuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, colorBuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                    GL_RENDERBUFFER, colorBuffer );
+        glGenRenderbuffers( 1, &depthBuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, depthBuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                                height );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                    GL_RENDERBUFFER, depthBuffer );
+        status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    }
+    else if ( GLEW_EXT_framebuffer_object )
+    {
+        glGenFramebuffersEXT( 1, &fbo );
+        glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, fbo );
+        glGenRenderbuffersEXT( 1, &colorBuffer );
+        glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, colorBuffer );
+        glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_RGBA8, width,
+                                    height );
+        glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT,
+                                        GL_COLOR_ATTACHMENT0_EXT,
+                                        GL_RENDERBUFFER_EXT, colorBuffer );
+        glGenRenderbuffersEXT( 1, &depthBuffer );
+        glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, depthBuffer );
+        glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24,
+                                    width, height );
+        glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT,
+                                        GL_DEPTH_ATTACHMENT_EXT,
+                                        GL_RENDERBUFFER_EXT, depthBuffer );
+        status = glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT );
+    }
+    else
+    {
+        gravUtil::logError( "OffscreenContext::initTarget: no pbuffer & no "
+                "framebuffer objects, nothing to render to\n" );
+        return false;
+    }
+
+    if ( status != GL_FRAMEBUFFER_COMPLETE )
+    {
+        gravUtil::logError( "OffscreenContext::initTarget: framebuffer "
+                "incomplete (0x%x)\n", status );
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OffscreenContext::finish()
+{
+    glFinish();
+}
+
+int OffscreenContext::getWidth()
+{
+    return width;
+}
+
+int OffscreenContext::getHeight()
+{
+    return height;
+}
@@ -178,6 +178,13 @@ GLuint PNGLoader::loadPNG( std::string filename, int &width, int &height )
     glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, iwidth, iheight, GL_RGBA,
                     GL_UNSIGNED_BYTE, (GLvoid*)image );
 
+    // no mipmaps, so the default min filter would leave it incomplete. set
+    // here once rather than every time it's drawn
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
     gl_error = glGetError();
     for ( ; (gl_error); gl_error = glGetError() )
     {
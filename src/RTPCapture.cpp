@@ -0,0 +1,369 @@
+/*
+ * @file RTPCapture.cpp
+ *
+ * Implementation of the RTPCapture class. See RTPCapture.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RTPCapture.h"
+#include "gravUtil.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+bool RTPCaptureFormat::parseAddress( std::string address, std::string& host,
+                                        unsigned int& port )
+{
+    size_t slash = address.find( '/' );
+    if ( slash == std::string::npos )
+        return false;
+
+    host = address.substr( 0, slash );
+    port = strtoul( address.c_str() + slash + 1, NULL, 10 );
+    return port > 0 && port < 65535;
+}
+
+RTPCapture::RTPCapture()
+{
+    file = NULL;
+    nextID = 0;
+    lastPacketTime = 0.0;
+    packetCount = 0;
+    byteCount = 0;
+    captureMutex = mutex_create();
+    captureThread = NULL;
+    running = false;
+}
+
+RTPCapture::~RTPCapture()
+{
+    close();
+    mutex_free( captureMutex );
+}
+
+bool RTPCapture::open( std::string f )
+{
+    filename = f;
+    file = fopen( filename.c_str(), "wb" );
+    if ( file == NULL )
+    {
+        gravUtil::logError( "RTPCapture::open: couldn't open %s for "
+                "writing\n", filename.c_str() );
+        return false;
+    }
+
+    fwrite( RTPCaptureFormat::magic, 1, RTPCaptureFormat::magicLength, file );
+    lastPacketTime = gravUtil::getTime();
+
+    running = true;
+    captureThread = thread_start( threadMain, this );
+
+    gravUtil::logMessage( "RTPCapture::open: capturing to %s\n",
+            filename.c_str() );
+    return true;
+}
+
+bool RTPCapture::addSession( std::string address, bool audio )
+{
+    if ( file == NULL )
+        return false;
+
+    std::string host;
+    unsigned int port;
+    if ( !RTPCaptureFormat::parseAddress( address, host, port ) )
+    {
+        gravUtil::logWarning( "RTPCapture::addSession: can't capture %s, no "
+                "port in address\n", address.c_str() );
+        return false;
+    }
+
+    CaptureSession session;
+    session.address = address;
+    session.sockets[0] = openSocket( host, port );
+    session.sockets[1] = session.sockets[0] >= 0 ?
+                            openSocket( host, port + 1 ) : -1;
+    if ( session.sockets[0] < 0 || session.sockets[1] < 0 )
+    {
+        if ( session.sockets[0] >= 0 )
+            ::close( session.sockets[0] );
+        return false;
+    }
+
+    mutex_lock( captureMutex );
+    session.id = nextID++;
+    sessions.push_back( session );
+
+    uint8_t header[6];
+    uint16_t len = address.size();
+    header[0] = RTPCaptureFormat::sessionRecord;
+    header[1] = session.id >> 8;
+    header[2] = session.id & 0xFF;
+    header[3] = audio ? 1 : 0;
+    header[4] = len >> 8;
+    header[5] = len & 0xFF;
+    fwrite( header, 1, sizeof( header ), file );
+    fwrite( address.data(), 1, len, file );
+    mutex_unlock( captureMutex );
+
+    gravUtil::logVerbose( "RTPCapture::addSession: capturing %s as session "
+            "%i\n", address.c_str(), session.id );
+    return true;
+}
+
+void RTPCapture::removeSession( std::string address )
+{
+    mutex_lock( captureMutex );
+    for ( std::vector<CaptureSession>::iterator it = sessions.begin();
+            it != sessions.end(); ++it )
+    {
+        if ( it->address.compare( address ) == 0 )
+        {
+            // the capture thread might be polling these right now
+            if ( running )
+            {
+                closing.push_back( it->sockets[0] );
+                closing.push_back( it->sockets[1] );
+            }
+            else
+            {
+                ::close( it->sockets[0] );
+                ::close( it->sockets[1] );
+            }
+            sessions.erase( it );
+            break;
+        }
+    }
+    mutex_unlock( captureMutex );
+}
+
+void RTPCapture::close()
+{
+    if ( running )
+    {
+        running = false;
+        thread_join( captureThread );
+        captureThread = NULL;
+    }
+
+    for ( unsigned int i = 0; i < sessions.size(); i++ )
+    {
+        ::close( sessions[i].sockets[0] );
+        ::close( sessions[i].sockets[1] );
+    }
+    sessions.clear();
+    for ( unsigned int i = 0; i < closing.size(); i++ )
+        ::close( closing[i] );
+    closing.clear();
+
+    if ( file != NULL )
+    {
+        fclose( file );
+        file = NULL;
+        gravUtil::logMessage( "RTPCapture::close: captured %lu packets "
+                "(%lu bytes) to %s\n", packetCount, byteCount,
+                filename.c_str() );
+    }
+}
+
+void* RTPCapture::threadMain( void* args )
+{
+    RTPCapture* capture = (RTPCapture*)args;
+    capture->captureLoop();
+    return 0;
+}
+
+void RTPCapture::captureLoop()
+{
+    std::vector<struct pollfd> fds;
+    std::vector<uint16_t> ids;
+    uint8_t buffer[ 65536 ];
+
+    while ( running )
+    {
+        mutex_lock( captureMutex );
+        for ( unsigned int i = 0; i < closing.size(); i++ )
+            ::close( closing[i] );
+        closing.clear();
+
+        fds.clear();
+        ids.clear();
+        for ( unsigned int i = 0; i < sessions.size(); i++ )
+        {
+            for ( int c = 0; c < 2; c++ )
+            {
+                struct pollfd pfd;
+                pfd.fd = sessions[i].sockets[c];
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                fds.push_back( pfd );
+                ids.push_back( sessions[i].id );
+            }
+        }
+        mutex_unlock( captureMutex );
+
+        // short timeout so new sessions & stopping get noticed
+        if ( fds.empty() )
+        {
+            poll( NULL, 0, 50 );
+            continue;
+        }
+        if ( poll( &fds[0], fds.size(), 50 ) <= 0 )
+            continue;
+
+        for ( unsigned int i = 0; i < fds.size(); i++ )
+        {
+            if ( !( fds[i].revents & POLLIN ) )
+                continue;
+
+            ssize_t len = recv( fds[i].fd, buffer, sizeof( buffer ),
+                                MSG_DONTWAIT );
+            if ( len <= 0 )
+                continue;
+
+            // sockets are listed RTP then RTCP for each session
+            uint8_t channel = ( i % 2 == 0 ) ? RTPCaptureFormat::channelRTP :
+                                                RTPCaptureFormat::channelRTCP;
+            writePacket( ids[i], channel, buffer, (uint16_t)len );
+        }
+    }
+}
+
+void RTPCapture::writePacket( uint16_t id, uint8_t channel,
+                                const uint8_t* data, uint16_t length )
+{
+    mutex_lock( captureMutex );
+
+    double now = gravUtil::getTime();
+    double delta = ( now - lastPacketTime ) * 1000000.0;
+    uint32_t deltaUS = delta > 4294967295.0 ? 0xFFFFFFFF : (uint32_t)delta;
+    // keep the remainder so rounding doesn't add up over a long capture
+    lastPacketTime += (double)deltaUS / 1000000.0;
+
+    uint8_t header[10];
+    header[0] = RTPCaptureFormat::packetRecord;
+    header[1] = deltaUS >> 24;
+    header[2] = ( deltaUS >> 16 ) & 0xFF;
+    header[3] = ( deltaUS >> 8 ) & 0xFF;
+    header[4] = deltaUS & 0xFF;
+    header[5] = id >> 8;
+    header[6] = id & 0xFF;
+    header[7] = channel;
+    header[8] = length >> 8;
+    header[9] = length & 0xFF;
+    fwrite( header, 1, sizeof( header ), file );
+    fwrite( data, 1, length, file );
+
+    packetCount++;
+    byteCount += length;
+
+    mutex_unlock( captureMutex );
+}
+
+int RTPCapture::openSocket( std::string host, unsigned int port )
+{
+    struct addrinfo hints;
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    std::ostringstream portS;
+    portS << port;
+    struct addrinfo* res;
+    if ( getaddrinfo( host.c_str(), portS.str().c_str(), &hints, &res ) != 0 )
+    {
+        gravUtil::logWarning( "RTPCapture::openSocket: couldn't resolve "
+                "%s\n", host.c_str() );
+        return -1;
+    }
+
+    bool multicast = false;
+    if ( res->ai_family == AF_INET )
+    {
+        struct sockaddr_in* sin = (struct sockaddr_in*)res->ai_addr;
+        multicast = IN_MULTICAST( ntohl( sin->sin_addr.s_addr ) );
+    }
+    else if ( res->ai_family == AF_INET6 )
+    {
+        struct sockaddr_in6* sin6 = (struct sockaddr_in6*)res->ai_addr;
+        multicast = IN6_IS_ADDR_MULTICAST( &sin6->sin6_addr );
+    }
+
+    if ( !multicast )
+    {
+        gravUtil::logWarning( "RTPCapture::openSocket: %s isn't multicast, "
+                "not capturing it\n", host.c_str() );
+        freeaddrinfo( res );
+        return -1;
+    }
+
+    int sock = socket( res->ai_family, SOCK_DGRAM, 0 );
+    if ( sock < 0 )
+    {
+        freeaddrinfo( res );
+        return -1;
+    }
+
+    // share the port with VPMedia's socket
+    int one = 1;
+    setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+#ifdef SO_REUSEPORT
+    setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof( one ) );
+#endif
+    int bufSize = 4 * 1024 * 1024;
+    setsockopt( sock, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof( bufSize ) );
+
+    // binding to the group address means we only get that group's packets
+    bool ok = bind( sock, res->ai_addr, res->ai_addrlen ) == 0;
+    if ( ok && res->ai_family == AF_INET )
+    {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+        mreq.imr_interface.s_addr = htonl( INADDR_ANY );
+        ok = setsockopt( sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                            sizeof( mreq ) ) == 0;
+    }
+    else if ( ok )
+    {
+        struct ipv6_mreq mreq;
+        mreq.ipv6mr_multiaddr =
+                ((struct sockaddr_in6*)res->ai_addr)->sin6_addr;
+        mreq.ipv6mr_interface = 0;
+        ok = setsockopt( sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq,
+                            sizeof( mreq ) ) == 0;
+    }
+    freeaddrinfo( res );
+
+    if ( !ok )
+    {
+        gravUtil::logWarning( "RTPCapture::openSocket: couldn't listen on "
+                "%s/%u\n", host.c_str(), port );
+        ::close( sock );
+        return -1;
+    }
+    return sock;
+}
@@ -0,0 +1,452 @@
+/*
+ * @file RTPReplayer.cpp
+ *
+ * Implementation of the RTPReplayer class. See RTPReplayer.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RTPReplayer.h"
+#include "RTPCapture.h"
+#include "gravUtil.h"
+
+#include <wx/utils.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// as fast as possible: how much to send between checks on the receivers, &
+// how much can be waiting in a receive buffer before pausing - well under the
+// default buffer size, so there's still room for what's sent in between
+static const unsigned long checkInterval = 16 * 1024;
+static const unsigned long maxQueued = 64 * 1024;
+static const double maxReceiverWait = 2.0;
+// gap between packets (in us) when the receivers can't be checked
+static const unsigned long minimumGap = 200;
+
+RTPReplayer::RTPReplayer( unsigned int bp )
+    : basePort( bp )
+{
+    file = NULL;
+    speed = 1.0f;
+    replayThread = NULL;
+    running = false;
+    finished = false;
+    warnedStalled = false;
+}
+
+RTPReplayer::~RTPReplayer()
+{
+    stop();
+    if ( file != NULL )
+        fclose( file );
+}
+
+bool RTPReplayer::load( std::string f )
+{
+    filename = f;
+    file = fopen( filename.c_str(), "rb" );
+    if ( file == NULL )
+    {
+        gravUtil::logError( "RTPReplayer::load: couldn't open %s\n",
+                filename.c_str() );
+        return false;
+    }
+
+    char magic[ RTPCaptureFormat::magicLength ];
+    if ( fread( magic, 1, sizeof( magic ), file ) != sizeof( magic ) ||
+            memcmp( magic, RTPCaptureFormat::magic, sizeof( magic ) ) != 0 )
+    {
+        gravUtil::logError( "RTPReplayer::load: %s isn't a grav capture "
+                "file\n", filename.c_str() );
+        return false;
+    }
+
+    // go through the whole thing once to find all the sessions up front, so
+    // they can be added before anything gets sent
+    uint8_t type, channel;
+    uint32_t delta;
+    uint16_t id;
+    std::vector<uint8_t> data;
+    unsigned long packets = 0;
+    double duration = 0.0;
+    while ( readRecord( type, delta, id, channel, data, true ) )
+    {
+        if ( type == RTPCaptureFormat::packetRecord )
+        {
+            packets++;
+            duration += (double)delta / 1000000.0;
+        }
+    }
+
+    gravUtil::logMessage( "RTPReplayer::load: %s has %lu packets over %.1f "
+            "seconds in %u sessions\n", filename.c_str(), packets, duration,
+            (unsigned int)sessions.size() );
+
+    fseek( file, RTPCaptureFormat::magicLength, SEEK_SET );
+    return true;
+}
+
+void RTPReplayer::setSpeed( float s )
+{
+    speed = s;
+}
+
+int RTPReplayer::getSessionCount()
+{
+    return sessions.size();
+}
+
+std::string RTPReplayer::getReplayAddress( int i )
+{
+    return sessions[i].replayAddress;
+}
+
+std::string RTPReplayer::getOriginalAddress( int i )
+{
+    return sessions[i].originalAddress;
+}
+
+bool RTPReplayer::isAudio( int i )
+{
+    return sessions[i].audio;
+}
+
+void RTPReplayer::start()
+{
+    if ( running || file == NULL )
+        return;
+
+    running = true;
+    finished = false;
+    replayThread = thread_start( threadMain, this );
+}
+
+void RTPReplayer::stop()
+{
+    if ( replayThread == NULL )
+        return;
+
+    running = false;
+    thread_join( replayThread );
+    replayThread = NULL;
+}
+
+bool RTPReplayer::isFinished()
+{
+    return finished;
+}
+
+bool RTPReplayer::readRecord( uint8_t& type, uint32_t& delta, uint16_t& id,
+                                uint8_t& channel, std::vector<uint8_t>& data,
+                                bool addSessions )
+{
+    if ( fread( &type, 1, 1, file ) != 1 )
+        return false;
+
+    if ( type == RTPCaptureFormat::sessionRecord )
+    {
+        uint8_t header[5];
+        if ( fread( header, 1, sizeof( header ), file ) != sizeof( header ) )
+            return false;
+        id = ( header[0] << 8 ) | header[1];
+        uint16_t len = ( header[3] << 8 ) | header[4];
+        std::string address( len, '\0' );
+        if ( len > 0 && fread( &address[0], 1, len, file ) != len )
+            return false;
+
+        if ( addSessions )
+        {
+            ReplaySession session;
+            session.originalAddress = address;
+            session.audio = header[2] != 0;
+            session.port = basePort + sessions.size() * 2;
+            std::ostringstream replayAddress;
+            replayAddress << "127.0.0.1/" << session.port;
+            session.replayAddress = replayAddress.str();
+
+            if ( id >= idMap.size() )
+                idMap.resize( id + 1, -1 );
+            idMap[ id ] = sessions.size();
+            sessions.push_back( session );
+        }
+        return true;
+    }
+    else if ( type == RTPCaptureFormat::packetRecord )
+    {
+        uint8_t header[9];
+        if ( fread( header, 1, sizeof( header ), file ) != sizeof( header ) )
+            return false;
+        delta = ( header[0] << 24 ) | ( header[1] << 16 ) |
+                    ( header[2] << 8 ) | header[3];
+        id = ( header[4] << 8 ) | header[5];
+        channel = header[6];
+        uint16_t len = ( header[7] << 8 ) | header[8];
+        data.resize( len );
+        return len == 0 || fread( &data[0], 1, len, file ) == len;
+    }
+
+    gravUtil::logError( "RTPReplayer::readRecord: unknown record type %i, "
+            "capture file is probably corrupt\n", type );
+    return false;
+}
+
+void* RTPReplayer::threadMain( void* args )
+{
+    RTPReplayer* replayer = (RTPReplayer*)args;
+    replayer->replayLoop();
+    return 0;
+}
+
+void RTPReplayer::replayLoop()
+{
+    int sock = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( sock < 0 )
+    {
+        gravUtil::logError( "RTPReplayer::replayLoop: couldn't create "
+                "socket\n" );
+        finished = true;
+        return;
+    }
+    int bufSize = 4 * 1024 * 1024;
+    setsockopt( sock, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof( bufSize ) );
+
+    struct sockaddr_in dest;
+    memset( &dest, 0, sizeof( dest ) );
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr( "127.0.0.1" );
+
+    // so only what gets dropped during the replay counts
+    std::map<unsigned int, PortStats> stats;
+    bool haveStats = readPortStats( stats );
+    unsigned long startDrops = haveStats ? getTotalDrops( stats ) : 0;
+    warnedStalled = false;
+    if ( !haveStats )
+        gravUtil::logWarning( "RTPReplayer::replayLoop: can't read socket "
+                "stats for all the replay ports, so packet loss won't be "
+                "reported%s\n",
+                speed > 0.0f ? "" : " & fast replay will use a fixed rate" );
+
+    uint8_t type, channel;
+    uint32_t delta;
+    uint16_t id;
+    std::vector<uint8_t> data;
+    unsigned long packets = 0;
+    unsigned long sendErrors = 0;
+    unsigned long bytesSinceCheck = 0;
+    double captureTime = 0.0;
+    double start = gravUtil::getTime();
+
+    while ( running && readRecord( type, delta, id, channel, data, false ) )
+    {
+        if ( type != RTPCaptureFormat::packetRecord )
+            continue;
+        if ( id >= idMap.size() || idMap[ id ] < 0 )
+            continue;
+
+        captureTime += (double)delta / 1000000.0;
+        if ( speed > 0.0f )
+        {
+            double wait = start + captureTime / speed - gravUtil::getTime();
+            // sleep in short chunks so stopping doesn't take long
+            while ( running && wait > 0.0 )
+            {
+                wxMicroSleep( (unsigned long)( std::min( wait, 0.05 ) *
+                                                1000000.0 ) );
+                wait = start + captureTime / speed - gravUtil::getTime();
+            }
+        }
+        else if ( !haveStats )
+        {
+            // no way to tell how the receivers are doing, so just give them
+            // a moment per packet
+            wxMicroSleep( minimumGap );
+        }
+        else if ( bytesSinceCheck >= checkInterval )
+        {
+            // checking every packet would cost more than the sending
+            haveStats = waitForReceivers();
+            bytesSinceCheck = 0;
+        }
+
+        const ReplaySession& session = sessions[ idMap[ id ] ];
+        unsigned int port = session.port +
+                ( channel == RTPCaptureFormat::channelRTCP ? 1 : 0 );
+        dest.sin_port = htons( port );
+        if ( !data.empty() &&
+                sendto( sock, &data[0], data.size(), 0,
+                        (struct sockaddr*)&dest, sizeof( dest ) ) < 0 )
+        {
+            sendErrors++;
+            continue;
+        }
+        packets++;
+        bytesSinceCheck += data.size();
+    }
+
+    close( sock );
+
+    gravUtil::logMessage( "RTPReplayer::replayLoop: replayed %lu packets "
+            "(%.1f seconds of capture) in %.1f seconds\n", packets,
+            captureTime, gravUtil::getTime() - start );
+    if ( sendErrors > 0 )
+        gravUtil::logWarning( "RTPReplayer::replayLoop: %lu packets couldn't "
+                "be sent\n", sendErrors );
+
+    // anything still queued will still get read, so this is what the
+    // sessions end up with
+    if ( haveStats && readPortStats( stats ) )
+    {
+        unsigned long dropped = getTotalDrops( stats ) - startDrops;
+        unsigned long received = dropped < packets ? packets - dropped : 0;
+        if ( dropped > 0 )
+            gravUtil::logWarning( "RTPReplayer::replayLoop: sent %lu packets, "
+                    "sessions received %lu - %lu dropped by the kernel, so "
+                    "this replay isn't reproducible\n", packets, received,
+                    dropped );
+        else
+            gravUtil::logMessage( "RTPReplayer::replayLoop: sent %lu packets, "
+                    "sessions received %lu (none dropped)\n", packets,
+                    received );
+    }
+    else
+    {
+        gravUtil::logMessage( "RTPReplayer::replayLoop: sent %lu packets, "
+                "packets received by the sessions unknown\n", packets );
+    }
+    finished = true;
+}
+
+bool RTPReplayer::readPortStats( std::map<unsigned int, PortStats>& stats )
+{
+    stats.clear();
+    for ( unsigned int i = 0; i < sessions.size(); i++ )
+    {
+        PortStats empty = { 0, 0, false };
+        stats[ sessions[i].port ] = empty;
+        stats[ sessions[i].port + 1 ] = empty;
+    }
+
+    // sockets that are IPv6 or dual-stack only show up in udp6
+    bool readAny = readUDPTable( "/proc/net/udp", stats );
+    readAny = readUDPTable( "/proc/net/udp6", stats ) || readAny;
+    if ( !readAny )
+        return false;
+
+    // without every port the numbers would be missing some of the traffic,
+    // so they're no good for throttling or for counting what got dropped
+    std::map<unsigned int, PortStats>::iterator it;
+    for ( it = stats.begin(); it != stats.end(); ++it )
+    {
+        if ( !it->second.found )
+            return false;
+    }
+    return true;
+}
+
+bool RTPReplayer::readUDPTable( const char* path,
+                                std::map<unsigned int, PortStats>& stats )
+{
+    FILE* udp = fopen( path, "r" );
+    if ( udp == NULL )
+        return false;
+
+    // sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt
+    // uid timeout inode ref pointer drops - addresses & queues are in hex,
+    // with 32 digit addresses for IPv6
+    char line[512];
+    // skip the header
+    if ( fgets( line, sizeof( line ), udp ) == NULL )
+    {
+        fclose( udp );
+        return false;
+    }
+    while ( fgets( line, sizeof( line ), udp ) != NULL )
+    {
+        unsigned int port;
+        unsigned long rxQueue, drops;
+        char pointer[64];
+        if ( sscanf( line, " %*d: %*[0-9A-Fa-f]:%x %*[0-9A-Fa-f]:%*x %*x "
+                        "%*x:%lx %*x:%*x %*x %*d %*d %*u %*d %63s %lu",
+                        &port, &rxQueue, pointer, &drops ) != 4 )
+            continue;
+
+        std::map<unsigned int, PortStats>::iterator it = stats.find( port );
+        if ( it == stats.end() )
+            continue;
+        it->second.queued += rxQueue;
+        it->second.drops += drops;
+        it->second.found = true;
+    }
+
+    fclose( udp );
+    return true;
+}
+
+unsigned long RTPReplayer::getTotalDrops(
+                                std::map<unsigned int, PortStats>& stats )
+{
+    unsigned long total = 0;
+    std::map<unsigned int, PortStats>::iterator it;
+    for ( it = stats.begin(); it != stats.end(); ++it )
+        total += it->second.drops;
+    return total;
+}
+
+bool RTPReplayer::waitForReceivers()
+{
+    std::map<unsigned int, PortStats> stats;
+    double waitStart = gravUtil::getTime();
+
+    while ( running )
+    {
+        if ( !readPortStats( stats ) )
+            return false;
+
+        bool backedUp = false;
+        std::map<unsigned int, PortStats>::iterator it;
+        for ( it = stats.begin(); it != stats.end() && !backedUp; ++it )
+            backedUp = it->second.queued > maxQueued;
+        if ( !backedUp )
+            return true;
+
+        // a session that's stopped reading shouldn't hang the replay - its
+        // packets will just show up as dropped
+        if ( gravUtil::getTime() - waitStart > maxReceiverWait )
+        {
+            if ( !warnedStalled )
+                gravUtil::logWarning( "RTPReplayer::waitForReceivers: "
+                        "sessions aren't keeping up, carrying on anyway\n" );
+            warnedStalled = true;
+            return true;
+        }
+
+        wxMicroSleep( 1000 );
+    }
+
+    return true;
+}
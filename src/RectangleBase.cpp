@@ -30,7 +30,12 @@
 #include "Point.h"
 
 #include "gravUtil.h"
+#include "BatchRenderer.h"
+#include "TitleTexture.h"
+#include "SDFFont.h"
+#include "TextMetrics.h"
 
+#include <algorithm>
 #include <cmath>
 
 RectangleBase::RectangleBase()
@@ -66,6 +71,7 @@ RectangleBase::RectangleBase( const RectangleBase& other )
 
     enableRendering = other.enableRendering;
     debugDraw = other.debugDraw;
+    batch = NULL;
 
     name = other.name;
     siteID = other.siteID;
@@ -79,6 +85,11 @@ RectangleBase::RectangleBase( const RectangleBase& other )
     titleStyle = other.titleStyle;
     coloredText = other.coloredText;
     nameSizeDirty = other.nameSizeDirty;
+    truncatedWidth = -1.0f;
+    // the texture is per object, so the copy makes its own
+    titleDirty = true;
+    titleShowsUnlocked = false;
+    titleTexture = NULL;
 
     borderTex = other.borderTex;
     twidth = other.twidth; theight = other.theight;
@@ -108,6 +119,8 @@ RectangleBase::~RectangleBase()
 
     // font is not deleted here since the default is to use the global one from
     // GLUtil, and that will delete it
+
+    delete titleTexture;
 }
 
 void RectangleBase::setDefaults()
@@ -129,11 +142,15 @@ void RectangleBase::setDefaults()
 
     enableRendering = true;
     debugDraw = false;
+    batch = NULL;
 
     relativeTextScale = 0.0009;
     titleStyle = TOPTEXT;
     coloredText = true;
     nameSizeDirty = false;
+    titleDirty = true;
+    titleShowsUnlocked = false;
+    titleTexture = NULL;
 
     borderScale = 0.04;
 
@@ -145,6 +162,7 @@ void RectangleBase::setDefaults()
 
     finalName = false;
     cutoffPos = -1;
+    truncatedWidth = -1.0f;
     nameStart = -1; nameEnd = -1;
     name = "";
     altName = "";
@@ -713,12 +731,24 @@ bool RectangleBase::getRendering()
 
 void RectangleBase::draw()
 {
-    // update the text bounds if that function was called - it's here because
-    // BBox() may do a GL call which needs to be on the main thread
-    if ( nameSizeDirty )
+    bool batched = batch != NULL;
+    batch = NULL;
+
+    // update the text bounds if that function was called - it's here so it
+    // doesn't change under draw() from other threads. with metrics it's cheap
+    // enough to redo the cutoff whenever the width changes, too
+    const TextMetrics* metrics = GLUtil::getInstance()->getTextMetrics();
+    if ( metrics != NULL )
+    {
+        if ( nameSizeDirty ||
+                ( titleStyle == TOPTEXT && getWidth() != truncatedWidth ) )
+            fitName( metrics );
+    }
+    // FTGL's BBox() may do a GL call which needs to be on the main thread
+    else if ( nameSizeDirty )
     {
         cutoffPos = -1;
-        textBounds = font->BBox( getSubName().c_str() );
+        textBounds = measureText( getSubName() );
         // only do cutoff if title is at top - so if centered (or other?)
         // display whole name even if it goes out of bounds
         while ( titleStyle == TOPTEXT && getTextWidth() > getWidth() )
@@ -739,13 +769,16 @@ void RectangleBase::draw()
 
             cutoffPos = curEnd - ceil( ( 1.0f -
                   ( getWidth() / getTextWidth() ) ) * numChars ) - 1;
-            textBounds = font->BBox( getSubName().c_str() );
+            textBounds = measureText( getSubName() );
         }
 
         nameSizeDirty = false;
+        titleDirty = true;
     }
 
-    animateValues();
+    // already done along with the border if it was batched
+    if ( !batched )
+        animateValues();
 
     // set up our position
     glPushMatrix();
@@ -819,7 +852,14 @@ void RectangleBase::draw()
         glDisable( GL_BLEND );
     }
 
-    drawBorder( Xdist, Ydist, s, t );
+    if ( batched )
+    {
+        // text color carries over from the border (see below)
+        RGBAColor col = getBorderDrawColor();
+        glColor4f( col.R, col.G, col.B, col.A );
+    }
+    else
+        drawBorder( Xdist, Ydist, s, t );
 
     glPushMatrix();
 
@@ -858,34 +898,53 @@ void RectangleBase::draw()
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
     glEnable( GL_LINE_SMOOTH );
 
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
     if ( font )
     {
-        std::string renderedName = getSubName();
-
-        if ( cutoffPos != -1 )
+        bool showUnlocked = showLockStatus && !locked;
+        if ( titleDirty || showUnlocked != titleShowsUnlocked )
         {
-            renderedName += "...";
-        }
+            renderedTitle = getSubName();
 
-        if ( showLockStatus && !locked )
-            renderedName += " (unlocked)";
+            if ( cutoffPos != -1 )
+            {
+                renderedTitle += "...";
+            }
 
-        if ( debugDraw )
+            if ( showUnlocked )
+                renderedTitle += " (unlocked)";
+
+            titleShowsUnlocked = showUnlocked;
+            titleDirty = false;
+        }
+
+        // same as the border unless it's white
+        RGBAColor textColor;
+        if ( coloredText )
+            textColor = getBorderDrawColor();
+        else
         {
-            char* posString = new char[ 50 ];
-            sprintf( posString, "(%f,%f)", x, y );
-            renderedName += posString;
+            textColor.R = 1.0f; textColor.G = 1.0f; textColor.B = 1.0f;
+            textColor.A = borderColor.A;
         }
 
         // color call from before will carry over otherwise
         if ( !coloredText )
             glColor4f( 1.0f, 1.0f, 1.0f, borderColor.A );
 
-        const char* nc = renderedName.c_str();
-        font->Render(nc);
+        if ( debugDraw )
+        {
+            // position changes all the time, so not worth caching
+            char posString[ 50 ];
+            sprintf( posString, "(%f,%f)", x, y );
+            std::string debugTitle = renderedTitle + posString;
+            SDFFont* textFont = GLUtil::getInstance()->getTextFont();
+            if ( textFont != NULL )
+                textFont->render( debugTitle, textColor );
+            else
+                font->Render( debugTitle.c_str() );
+        }
+        else
+            drawTitle( textColor, batched, textXPos, textYPos );
     }
 
     glDisable( GL_BLEND );
@@ -910,27 +969,113 @@ void RectangleBase::draw()
     xAngle += 0.01f;*/
 }
 
+void RectangleBase::drawTitle( RGBAColor color, bool batched, float textX,
+                                float textY )
+{
+    SDFFont* textFont = GLUtil::getInstance()->getTextFont();
+    if ( textFont != NULL )
+    {
+        // batched objects aren't rotated, so the title can go straight into
+        // world space & get drawn along with all the others
+        if ( batched )
+            textFont->addText( renderedTitle, x + textX, y + textY, z,
+                                getTextScale(), color );
+        else
+            textFont->render( renderedTitle, color );
+        return;
+    }
+
+    if ( TitleTexture::isAvailable() )
+    {
+        // texture pixels per font unit, rounded up to a power of two so
+        // resizing doesn't re-render the text every frame - mipmaps cover
+        // anything in between
+        float scale = getTextScale() * GLUtil::getInstance()->getPixelScale();
+        if ( scale > 0.0f )
+            scale = powf( 2.0f, ceilf( logf( scale ) / logf( 2.0f ) ) );
+        scale = std::max( 1.0f / 64.0f, std::min( scale, 2.0f ) );
+
+        if ( titleTexture == NULL )
+            titleTexture = new TitleTexture();
+        if ( titleTexture->update( font, renderedTitle, scale ) )
+        {
+            titleTexture->draw();
+            return;
+        }
+    }
+
+    font->Render( renderedTitle.c_str() );
+}
+
+FTBBox RectangleBase::measureText( const std::string& text )
+{
+    const TextMetrics* metrics = GLUtil::getInstance()->getTextMetrics();
+    if ( metrics != NULL )
+        return metrics->BBox( text );
+    return font->BBox( text.c_str() );
+}
+
+void RectangleBase::fitName( const TextMetrics* metrics )
+{
+    // only lay the name out again if it actually changed, not just the width
+    if ( nameSizeDirty )
+    {
+        std::string full;
+        if ( nameStart != -1 && nameEnd != -1 )
+            full = name.substr( nameStart, nameEnd - nameStart );
+        else
+            full = name;
+
+        if ( full != measuredName || namePrefixes.ends.empty() )
+        {
+            metrics->measurePrefixes( full, namePrefixes );
+            measuredName = full;
+        }
+    }
+
+    int oldCutoff = cutoffPos;
+    cutoffPos = -1;
+    unsigned int count = namePrefixes.ends.size();
+
+    // only do cutoff if title is at top - so if centered (or other?)
+    // display whole name even if it goes out of bounds
+    if ( titleStyle == TOPTEXT && count > 0 && getTextScale() > 0.0f )
+    {
+        count = TextMetrics::fitPrefix( namePrefixes,
+                                        getWidth() / getTextScale() );
+        if ( count < namePrefixes.ends.size() )
+        {
+            if ( nameStart == -1 || nameEnd == -1 )
+            {
+                nameStart = 0;
+                nameEnd = getName().length();
+            }
+            cutoffPos = nameStart +
+                    ( count > 0 ? namePrefixes.ends[ count - 1 ] : 0 );
+        }
+    }
+
+    textBounds = TextMetrics::getPrefixBBox( namePrefixes, count );
+    truncatedWidth = getWidth();
+
+    if ( nameSizeDirty || cutoffPos != oldCutoff )
+        titleDirty = true;
+    nameSizeDirty = false;
+}
+
 void RectangleBase::drawBorder( float Xdist, float Ydist, float s, float t )
 {
     glEnable( GL_BLEND );
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
+    // filtering & wrap are set when the texture is loaded
     glEnable( GL_TEXTURE_2D );
     glBindTexture( GL_TEXTURE_2D, borderTex );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, twidth );
 
     glBegin( GL_QUADS );
     // set the border color
-    glColor4f( borderColor.R-(effectVal*3.0f),
-               borderColor.G-(effectVal*3.0f),
-               borderColor.B+(effectVal*6.0f),
-               borderColor.A+(effectVal*3.0f) );
+    RGBAColor col = getBorderDrawColor();
+    glColor4f( col.R, col.G, col.B, col.A );
 
     glTexCoord2f(0.0, 0.0);
     glVertex3f(-Xdist, -Ydist, 0.0);
@@ -949,6 +1094,58 @@ void RectangleBase::drawBorder( float Xdist, float Ydist, float s, float t )
     glDisable( GL_TEXTURE_2D );
 }
 
+void RectangleBase::batchBorder( BatchRenderer* b )
+{
+    batch = b;
+    animateValues();
+
+    // same as drawBorder, but in world space since the position isn't on the
+    // matrix stack
+    float s = (float)twidth / (float)GLUtil::getInstance()->pow2( twidth );
+    float t = (float)theight / (float)GLUtil::getInstance()->pow2( theight );
+    float Xdist = (getWidth()/2.0f) + getBorderSize();
+    float Ydist = (getHeight()/2.0f) + getBorderSize();
+
+    b->addQuad( x - Xdist, y - Ydist, x + Xdist, y + Ydist, z,
+                getBorderDrawColor(), borderTex, s, t );
+}
+
+bool RectangleBase::canBatchBorder()
+{
+    // debug drawing goes under the border, so can't be split from it
+    return xAngle == 0.0f && yAngle == 0.0f && zAngle == 0.0f && !debugDraw;
+}
+
+void RectangleBase::getDrawnExtent( float& left, float& right, float& bottom,
+                                    float& top )
+{
+    float Xdist = ( getWidth() / 2.0f ) + getBorderSize();
+    float Ydist = ( getHeight() / 2.0f ) + getBorderSize();
+    float destXdist = ( getDestWidth() / 2.0f ) + getDestBorderSize();
+    float destYdist = ( getDestHeight() / 2.0f ) + getDestBorderSize();
+
+    left = std::min( x - Xdist, destX - destXdist );
+    right = std::max( x + Xdist, destX + destXdist );
+    bottom = std::min( y - Ydist, destY - destYdist );
+    top = std::max( y + Ydist, destY + destYdist );
+
+    float textSpace = getTextOffset() + getTextHeight();
+    if ( titleStyle == TOPTEXT )
+        top += textSpace;
+    else if ( titleStyle == FULLCAPTIONS )
+        bottom -= textSpace;
+}
+
+RGBAColor RectangleBase::getBorderDrawColor()
+{
+    RGBAColor col;
+    col.R = borderColor.R - ( effectVal * 3.0f );
+    col.G = borderColor.G - ( effectVal * 3.0f );
+    col.B = borderColor.B + ( effectVal * 6.0f );
+    col.A = borderColor.A + ( effectVal * 3.0f );
+    return col;
+}
+
 void RectangleBase::animateValues()
 {
     // note the fabs stuff is to snap to the destination, since we'll never
@@ -0,0 +1,346 @@
+/*
+ * @file RenderBenchmark.cpp
+ *
+ * Implementation of the RenderBenchmark class. See RenderBenchmark.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RenderBenchmark.h"
+#include "OffscreenContext.h"
+#include "gravManager.h"
+#include "gravUtil.h"
+#include "SessionManager.h"
+#include "SyntheticSourceManager.h"
+#include "VideoSource.h"
+#include "VideoListener.h"
+#include "GLUtil.h"
+
+#include <wx/utils.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+static const unsigned int sourceCounts[] = { 1, 4, 16, 64, 256 };
+static const unsigned int numSourceCounts = 5;
+
+static const unsigned int resolutions[][2] = { { 352, 288 }, { 640, 480 },
+                                                { 1280, 720 } };
+static const unsigned int numResolutions = 3;
+
+// frames to draw before timing, so textures are allocated & the sources have
+// had time to produce something
+static const long warmupFrames = 30;
+
+// more than this many source pixels in a case gets skipped - 64 720p videos,
+// which is over a gigabyte of sinks & textures already
+static const double maxCasePixels = 64.0 * 1280.0 * 720.0;
+
+RenderBenchmark::RenderBenchmark( gravManager* g, SessionManager* sm,
+                                    VideoListener* vl, OffscreenContext* o )
+    : grav( g ), sessionManager( sm ), listener( vl ), offscreen( o )
+{
+    threads = false;
+    frameInterval = 0;
+}
+
+void RenderBenchmark::setThreads( bool t )
+{
+    threads = t;
+}
+
+void RenderBenchmark::setFrameInterval( int us )
+{
+    frameInterval = us;
+}
+
+FrameStats RenderBenchmark::runFrames( long frames )
+{
+    FrameStats stats;
+    memset( &stats, 0, sizeof( stats ) );
+    if ( frames <= 0 )
+        return stats;
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve( frames );
+    double drawTotal = 0.0;
+    double nonDrawTotal = 0.0;
+    uint64_t startBytes = getUploadedBytes();
+    double cpuStart = sessionManager->getThreadCPUTime();
+
+    double start = gravUtil::getTime();
+    double lastDrawEnd = start;
+
+    for ( long i = 0; i < frames; i++ )
+    {
+        if ( !threads )
+            sessionManager->iterateSessions();
+
+        double frameStart = gravUtil::getTime();
+        nonDrawTotal += frameStart - lastDrawEnd;
+        grav->draw();
+        // make sure the GL work is counted, not just issuing it
+        offscreen->finish();
+        lastDrawEnd = gravUtil::getTime();
+
+        double frameTime = lastDrawEnd - frameStart;
+        drawTotal += frameTime;
+        frameTimes.push_back( frameTime * 1000.0 );
+
+        // with an fps set, hold to that rate like the windowed version
+        if ( frameInterval > 0 )
+        {
+            double wait = frameInterval / 1000000.0 - frameTime;
+            if ( wait > 0.0 )
+                wxMicroSleep( (unsigned long)( wait * 1000000.0 ) );
+        }
+    }
+
+    stats.totalTime = gravUtil::getTime() - start;
+    double cpuEnd = sessionManager->getThreadCPUTime();
+    stats.sessionCPU = -1.0;
+    if ( cpuStart >= 0.0 && cpuEnd >= 0.0 && stats.totalTime > 0.0 )
+        stats.sessionCPU = ( cpuEnd - cpuStart ) / stats.totalTime * 100.0;
+    stats.frames = frameTimes.size();
+    stats.first = frameTimes[0];
+    stats.drawTime = drawTotal * 1000.0 / stats.frames;
+    stats.nonDrawTime = nonDrawTotal * 1000.0 / stats.frames;
+    stats.uploadBytes = (double)( getUploadedBytes() - startBytes ) /
+                            stats.frames;
+
+    std::sort( frameTimes.begin(), frameTimes.end() );
+    unsigned int n = stats.frames;
+    stats.min = frameTimes[0];
+    stats.mean = stats.drawTime;
+    stats.median = frameTimes[ n / 2 ];
+    stats.p95 = frameTimes[ ( n * 95 ) / 100 ];
+    stats.p99 = frameTimes[ ( n * 99 ) / 100 ];
+    stats.max = frameTimes[ n - 1 ];
+
+    return stats;
+}
+
+void RenderBenchmark::printStats( const FrameStats& stats )
+{
+    if ( stats.frames == 0 )
+        return;
+
+    // the first frame includes setting up textures etc., so it's reported on
+    // its own as well as in the totals
+    printf( "headless: %u frames at %ix%i in %.3f s (%.1f fps)\n",
+            stats.frames, offscreen->getWidth(), offscreen->getHeight(),
+            stats.totalTime, stats.frames / stats.totalTime );
+    printf( "frame time (ms): first %.3f, min %.3f, mean %.3f, median %.3f, "
+            "95th %.3f, 99th %.3f, max %.3f\n", stats.first, stats.min,
+            stats.mean, stats.median, stats.p95, stats.p99, stats.max );
+    printf( "per frame: draw %.3f ms, non-draw %.3f ms, %.0f bytes "
+            "uploaded\n", stats.drawTime, stats.nonDrawTime,
+            stats.uploadBytes );
+    if ( stats.sessionCPU >= 0.0 )
+        printf( "session threads: %.1f%% CPU\n", stats.sessionCPU );
+    fflush( stdout );
+}
+
+bool RenderBenchmark::runSuite( long frames, std::string filename )
+{
+    static const Layout layouts[] = {
+        { "plain", false, false, false },
+        { "runway", true, false, false },
+        { "grid", false, true, false },
+        // runway members count as grouped, so no runway for site groups
+        { "groups", false, false, true } };
+    static const unsigned int numLayouts = 4;
+
+    FILE* out = fopen( filename.c_str(), "w" );
+    if ( out == NULL )
+    {
+        gravUtil::logError( "RenderBenchmark::runSuite: couldn't open %s for "
+                "writing\n", filename.c_str() );
+        return false;
+    }
+
+    bool oldRunway = grav->usingRunway();
+    bool oldGrid = grav->usingGridAuto();
+    bool oldGroups = grav->usingSiteIDGroups();
+
+    char timestamp[32];
+    time_t now = time( NULL );
+    strftime( timestamp, sizeof( timestamp ), "%Y-%m-%dT%H:%M:%SZ",
+                gmtime( &now ) );
+    const char* renderer = (const char*)glGetString( GL_RENDERER );
+    const char* glVersion = (const char*)glGetString( GL_VERSION );
+
+    fprintf( out, "{\n" );
+    fprintf( out, "  \"version\": %s,\n",
+            jsonString( gravUtil::getVersionString() ).c_str() );
+    fprintf( out, "  \"timestamp\": \"%s\",\n", timestamp );
+    fprintf( out, "  \"renderer\": %s,\n",
+            jsonString( renderer != NULL ? renderer : "" ).c_str() );
+    fprintf( out, "  \"gl_version\": %s,\n",
+            jsonString( glVersion != NULL ? glVersion : "" ).c_str() );
+    fprintf( out, "  \"screen_width\": %i,\n", offscreen->getWidth() );
+    fprintf( out, "  \"screen_height\": %i,\n", offscreen->getHeight() );
+    fprintf( out, "  \"threads\": %s,\n", threads ? "true" : "false" );
+    fprintf( out, "  \"frames_per_case\": %li,\n", frames );
+    fprintf( out, "  \"warmup_frames\": %li,\n", warmupFrames );
+    fprintf( out, "  \"cases\": [" );
+
+    unsigned int caseNum = 0;
+    unsigned int numCases = numResolutions * numSourceCounts * numLayouts;
+    for ( unsigned int r = 0; r < numResolutions; r++ )
+    {
+        unsigned int w = resolutions[r][0];
+        unsigned int h = resolutions[r][1];
+        for ( unsigned int c = 0; c < numSourceCounts; c++ )
+        {
+            unsigned int count = sourceCounts[c];
+            for ( unsigned int l = 0; l < numLayouts; l++ )
+            {
+                const Layout& layout = layouts[l];
+                FrameStats stats;
+                memset( &stats, 0, sizeof( stats ) );
+                fprintf( out, caseNum > 0 ? ",\n" : "\n" );
+                caseNum++;
+
+                if ( (double)count * w * h > maxCasePixels )
+                {
+                    writeCase( out, count, w, h, layout, true, stats );
+                    continue;
+                }
+
+                gravUtil::logMessage( "RenderBenchmark::runSuite: case %u/%u: "
+                        "%u %ux%u sources, %s\n", caseNum, numCases, count, w,
+                        h, layout.name );
+
+                // layout is applied as sources get added, so set it first
+                grav->setGridAuto( layout.grid );
+                grav->setRunwayUsage( layout.runway );
+                grav->setSiteIDGrouping( layout.groups );
+
+                SyntheticSourceManager* synthetic =
+                        new SyntheticSourceManager( listener );
+                std::ostringstream spec;
+                spec << count << "x" << w << "x" << h;
+                bool added = synthetic->addSources( spec.str() );
+                if ( added )
+                {
+                    if ( layout.groups )
+                        synthetic->setSiteIDs( 4 );
+                    synthetic->start();
+
+                    runFrames( warmupFrames );
+                    stats = runFrames( frames );
+
+                    synthetic->stop();
+                }
+                synthetic->removeSources();
+                // sources & their groups get deleted on the next draw, after
+                // which the sinks can go
+                grav->draw();
+                delete synthetic;
+
+                writeCase( out, count, w, h, layout, !added, stats );
+                fflush( out );
+            }
+        }
+    }
+
+    fprintf( out, "\n  ]\n}\n" );
+    fclose( out );
+
+    grav->setGridAuto( oldGrid );
+    grav->setRunwayUsage( oldRunway );
+    grav->setSiteIDGrouping( oldGroups );
+
+    gravUtil::logMessage( "RenderBenchmark::runSuite: wrote %u cases to %s\n",
+            numCases, filename.c_str() );
+    return true;
+}
+
+uint64_t RenderBenchmark::getUploadedBytes()
+{
+    uint64_t total = 0;
+    grav->lockSources();
+    std::vector<VideoSource*>* sources = grav->getSources();
+    for ( unsigned int i = 0; i < sources->size(); i++ )
+        total += (*sources)[i]->getStats().uploadedBytes;
+    grav->unlockSources();
+    return total;
+}
+
+void RenderBenchmark::writeCase( FILE* out, unsigned int count,
+                                    unsigned int w, unsigned int h,
+                                    const Layout& layout, bool skipped,
+                                    const FrameStats& stats )
+{
+    fprintf( out, "    {\"sources\": %u, \"width\": %u, \"height\": %u, "
+            "\"layout\": \"%s\", \"runway\": %s, \"grid\": %s, "
+            "\"groups\": %s, \"skipped\": %s", count, w, h, layout.name,
+            layout.runway ? "true" : "false", layout.grid ? "true" : "false",
+            layout.groups ? "true" : "false", skipped ? "true" : "false" );
+
+    if ( !skipped )
+    {
+        fprintf( out, ",\n     \"frames\": %u, \"total_s\": %.4f, "
+                "\"fps\": %.2f,\n", stats.frames, stats.totalTime,
+                stats.totalTime > 0.0 ? stats.frames / stats.totalTime : 0.0 );
+        fprintf( out, "     \"frame_ms\": {\"min\": %.4f, \"mean\": %.4f, "
+                "\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+                "\"max\": %.4f},\n", stats.min, stats.mean, stats.median,
+                stats.p95, stats.p99, stats.max );
+        fprintf( out, "     \"draw_ms\": %.4f, \"non_draw_ms\": %.4f, "
+                "\"upload_bytes_per_frame\": %.0f", stats.drawTime,
+                stats.nonDrawTime, stats.uploadBytes );
+        // null when sessions are iterated on the main thread
+        if ( stats.sessionCPU >= 0.0 )
+            fprintf( out, ",\n     \"session_cpu_percent\": %.2f",
+                    stats.sessionCPU );
+        else
+            fprintf( out, ",\n     \"session_cpu_percent\": null" );
+    }
+
+    fprintf( out, "}" );
+}
+
+std::string RenderBenchmark::jsonString( std::string s )
+{
+    std::string out = "\"";
+    for ( unsigned int i = 0; i < s.size(); i++ )
+    {
+        char c = s[i];
+        if ( c == '"' || c == '\\' )
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ( (unsigned char)c < 0x20 )
+        {
+            char escaped[8];
+            snprintf( escaped, sizeof( escaped ), "\\u%04x", c );
+            out += escaped;
+        }
+        else
+            out += c;
+    }
+    out += "\"";
+    return out;
+}
@@ -24,6 +24,7 @@
  */
 
 #include "Runway.h"
+#include "BatchRenderer.h"
 #include <sstream>
 
 Runway::Runway( float _x, float _y ) :
@@ -45,7 +46,11 @@ Runway::Runway( float _x, float _y ) :
 
 void Runway::draw()
 {
-    animateValues();
+    bool batched = batch != NULL;
+    batch = NULL;
+
+    if ( !batched )
+        animateValues();
 
     if ( borderColor.A < 0.01f )
         return;
@@ -55,6 +60,15 @@ void Runway::draw()
 
     intersectCounter = ( intersectCounter + 1 ) % 10;
 
+    if ( batched )
+    {
+        for ( unsigned int i = 0; i < objects.size(); i++ )
+        {
+            objects[i]->draw();
+        }
+        return;
+    }
+
     // note this must set up the position itself, since it doesn't call the
     // inherited draw method from RectangleBase
     glPushMatrix();
@@ -108,6 +122,34 @@ void Runway::draw()
     }
 }
 
+void Runway::batchBorder( BatchRenderer* b )
+{
+    batch = b;
+    animateValues();
+
+    // members don't get drawn either when it's hidden
+    if ( borderColor.A < 0.01f )
+        return;
+
+    float Xdist = scaleX / 2;
+    float Ydist = scaleY / 2;
+
+    RGBAColor fill;
+    fill.R = borderColor.R * 0.2f; fill.G = borderColor.G * 0.2f;
+    fill.B = borderColor.B * 0.25f; fill.A = borderColor.A * 0.25f;
+    b->addQuad( x - Xdist, y - Ydist, x + Xdist, y + Ydist, z, fill );
+
+    RGBAColor outline;
+    outline.R = borderColor.R * 0.4f; outline.G = borderColor.G * 0.4f;
+    outline.B = borderColor.B * 0.45f; outline.A = borderColor.A * 0.35f;
+    b->addOutline( x - Xdist, y - Ydist, x + Xdist, y + Ydist, z, outline );
+
+    for ( unsigned int i = 0; i < objects.size(); i++ )
+    {
+        objects[i]->batchBorder( b );
+    }
+}
+
 void Runway::rearrange()
 {
     if ( objects.size() == 0 ) return;
@@ -0,0 +1,492 @@
+/*
+ * @file SDFFont.cpp
+ *
+ * Implementation of the SDFFont class. See SDFFont.h for details.
+ *
+ * The distance transform is the separable one from Felzenszwalb &
+ * Huttenlocher, "Distance Transforms of Sampled Functions".
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SDFFont.h"
+#include "gravUtil.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// glyphs are rendered at this many pixels per em, then shrunk by the
+// downsample factor into the atlas
+static const int renderSize = 128;
+static const int downsample = 4;
+// how far the distance field reaches past the glyph edges, in atlas pixels
+static const int spread = 4;
+static const int atlasPixelWidth = 512;
+// empty pixels between glyphs in the atlas, so filtering doesn't bleed
+static const int gutter = 1;
+// font units per rendered pixel, to match the FTGL font at FaceSize 100
+static const float unitsPerPixel = 100.0f / renderSize;
+// stands in for infinity in the distance transform
+static const float unreachable = 1e20f;
+
+// a glyph's distance field, before packing
+typedef struct {
+    unsigned int codepoint;
+    int width, height;
+    std::vector<unsigned char> field;
+} GlyphCell;
+
+static const GLchar* sdfVert =
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    texCoord = gl_MultiTexCoord0.st;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+// the edge is at 0.5 - smoothing over about a pixel either side of it keeps
+// it antialiased at any scale
+static const GLchar* sdfFrag =
+    "uniform sampler2D atlas;\n"
+    "\n"
+    "varying vec2 texCoord;\n"
+    "\n"
+    "void main( void )\n"
+    "{\n"
+    "    float dist = texture2D( atlas, texCoord ).a;\n"
+    "    float width = max( fwidth( dist ) * 0.7, 0.001 );\n"
+    "    float alpha = smoothstep( 0.5 - width, 0.5 + width, dist );\n"
+    "    gl_FragColor = vec4( gl_Color.rgb, gl_Color.a * alpha );\n"
+    "}\n";
+
+/*
+ * 1D squared distance transform of f (n samples) into d. v & z are scratch,
+ * with room for n & n+1 entries.
+ */
+static void distanceTransform1D( const float* f, int n, float* d, int* v,
+                                    float* z )
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -unreachable;
+    z[1] = unreachable;
+    for ( int q = 1; q < n; q++ )
+    {
+        float s = ( ( f[q] + q * q ) - ( f[v[k]] + v[k] * v[k] ) ) /
+                    ( 2 * q - 2 * v[k] );
+        while ( s <= z[k] )
+        {
+            k--;
+            s = ( ( f[q] + q * q ) - ( f[v[k]] + v[k] * v[k] ) ) /
+                    ( 2 * q - 2 * v[k] );
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = unreachable;
+    }
+
+    k = 0;
+    for ( int q = 0; q < n; q++ )
+    {
+        while ( z[k+1] < q )
+            k++;
+        d[q] = ( q - v[k] ) * ( q - v[k] ) + f[v[k]];
+    }
+}
+
+/*
+ * Squared distance from each pixel to the nearest pixel where grid is 0, in
+ * place (grid is 0 or unreachable going in).
+ */
+static void distanceTransform2D( std::vector<float>& grid, int w, int h )
+{
+    int n = std::max( w, h );
+    std::vector<float> f( n ), d( n ), z( n + 1 );
+    std::vector<int> v( n );
+
+    for ( int x = 0; x < w; x++ )
+    {
+        for ( int y = 0; y < h; y++ )
+            f[y] = grid[ y * w + x ];
+        distanceTransform1D( &f[0], h, &d[0], &v[0], &z[0] );
+        for ( int y = 0; y < h; y++ )
+            grid[ y * w + x ] = d[y];
+    }
+
+    for ( int y = 0; y < h; y++ )
+    {
+        distanceTransform1D( &grid[ y * w ], w, &d[0], &v[0], &z[0] );
+        for ( int x = 0; x < w; x++ )
+            grid[ y * w + x ] = d[x];
+    }
+}
+
+SDFFont::SDFFont()
+{
+    atlasWidth = 0;
+    atlasHeight = 0;
+    texid = 0;
+    program = 0;
+    vbo = 0;
+    metrics = NULL;
+}
+
+SDFFont::~SDFFont()
+{
+    if ( texid != 0 )
+        glDeleteTextures( 1, &texid );
+    if ( program != 0 )
+        glDeleteProgram( program );
+    if ( vbo != 0 )
+        glDeleteBuffersARB( 1, &vbo );
+}
+
+bool SDFFont::load( const std::string& file, const TextMetrics* m )
+{
+    double start = gravUtil::getTime();
+    metrics = m;
+    if ( !buildAtlas( file ) )
+        return false;
+    if ( !initGL() )
+        return false;
+
+    gravUtil::logVerbose( "SDFFont::load: %u glyphs in %ix%i atlas, took "
+            "%.1f ms\n", (unsigned int)glyphs.size(), atlasWidth, atlasHeight,
+            ( gravUtil::getTime() - start ) * 1000.0 );
+    // only needed for the upload
+    std::vector<unsigned char>().swap( atlas );
+    return true;
+}
+
+void SDFFont::render( const std::string& text, RGBAColor color )
+{
+    appendText( immediate, text, 0.0f, 0.0f, 0.0f, 1.0f, color );
+    drawVertices( immediate );
+}
+
+void SDFFont::addText( const std::string& text, float x, float y, float z,
+                        float scale, RGBAColor color )
+{
+    appendText( batch, text, x, y, z, scale, color );
+}
+
+void SDFFont::flush()
+{
+    drawVertices( batch );
+}
+
+bool SDFFont::buildAtlas( const std::string& file )
+{
+    FT_Library library;
+    if ( FT_Init_FreeType( &library ) != 0 )
+    {
+        gravUtil::logError( "SDFFont::buildAtlas: couldn't initialize "
+                "FreeType\n" );
+        return false;
+    }
+
+    FT_Face face;
+    if ( FT_New_Face( library, file.c_str(), 0, &face ) != 0 ||
+            FT_Set_Pixel_Sizes( face, 0, renderSize ) != 0 )
+    {
+        gravUtil::logError( "SDFFont::buildAtlas: couldn't load %s\n",
+                file.c_str() );
+        FT_Done_FreeType( library );
+        return false;
+    }
+
+    std::vector<GlyphCell> cells;
+
+    int pad = spread * downsample;
+    std::vector<unsigned int> codepoints = metrics->getCodepoints();
+    for ( unsigned int i = 0; i < codepoints.size(); i++ )
+    {
+        unsigned int c = codepoints[i];
+        if ( FT_Load_Char( face, c, FT_LOAD_RENDER ) != 0 )
+            continue;
+
+        FT_GlyphSlot slot = face->glyph;
+        const FT_Bitmap& bitmap = slot->bitmap;
+        int bw = bitmap.width;
+        int bh = bitmap.rows;
+
+        Glyph g;
+        g.left = 0.0f; g.bottom = 0.0f; g.right = 0.0f; g.top = 0.0f;
+        g.s0 = 0.0f; g.t0 = 0.0f; g.s1 = 0.0f; g.t1 = 0.0f;
+
+        if ( bw == 0 || bh == 0 )
+        {
+            // nothing to draw (ie, space)
+            glyphs[c] = g;
+            continue;
+        }
+
+        // padded out to a whole number of atlas pixels
+        int gw = ( ( bw + pad * 2 + downsample - 1 ) / downsample ) *
+                    downsample;
+        int gh = ( ( bh + pad * 2 + downsample - 1 ) / downsample ) *
+                    downsample;
+
+        // distances to the nearest inside & outside pixels. rows go top
+        // down, like the bitmap
+        std::vector<float> toInside( gw * gh, unreachable );
+        std::vector<float> toOutside( gw * gh, 0.0f );
+        for ( int y = 0; y < bh; y++ )
+        {
+            const unsigned char* row = bitmap.buffer + y * bitmap.pitch;
+            for ( int x = 0; x < bw; x++ )
+            {
+                if ( row[x] >= 128 )
+                {
+                    int index = ( y + pad ) * gw + x + pad;
+                    toInside[index] = 0.0f;
+                    toOutside[index] = unreachable;
+                }
+            }
+        }
+        distanceTransform2D( toInside, gw, gh );
+        distanceTransform2D( toOutside, gw, gh );
+
+        GlyphCell cell;
+        cell.codepoint = c;
+        cell.width = gw / downsample;
+        cell.height = gh / downsample;
+        cell.field.resize( cell.width * cell.height );
+        for ( int y = 0; y < cell.height; y++ )
+        {
+            for ( int x = 0; x < cell.width; x++ )
+            {
+                // average the signed distance at the middle four pixels of
+                // the block. positive is inside
+                float total = 0.0f;
+                for ( int sy = 1; sy <= 2; sy++ )
+                {
+                    for ( int sx = 1; sx <= 2; sx++ )
+                    {
+                        int index = ( y * downsample + sy ) * gw +
+                                        x * downsample + sx;
+                        if ( toInside[index] == 0.0f )
+                            total += sqrtf( toOutside[index] ) - 0.5f;
+                        else
+                            total -= sqrtf( toInside[index] ) - 0.5f;
+                    }
+                }
+                float dist = total / 4.0f / downsample;
+                float value = 0.5f + dist / ( 2.0f * spread );
+                value = std::max( 0.0f, std::min( value, 1.0f ) );
+                cell.field[ y * cell.width + x ] =
+                        (unsigned char)( value * 255.0f + 0.5f );
+            }
+        }
+
+        g.left = ( slot->bitmap_left - pad ) * unitsPerPixel;
+        g.top = ( slot->bitmap_top + pad ) * unitsPerPixel;
+        g.right = g.left + gw * unitsPerPixel;
+        g.bottom = g.top - gh * unitsPerPixel;
+        glyphs[c] = g;
+        cells.push_back( cell );
+    }
+
+    FT_Done_Face( face );
+    FT_Done_FreeType( library );
+
+    if ( glyphs.find( '?' ) == glyphs.end() )
+    {
+        gravUtil::logError( "SDFFont::buildAtlas: %s has no usable glyphs\n",
+                file.c_str() );
+        return false;
+    }
+
+    // pack into rows, left to right
+    std::vector<int> cellX( cells.size() ), cellY( cells.size() );
+    int penX = gutter, penY = gutter, rowHeight = 0;
+    for ( unsigned int i = 0; i < cells.size(); i++ )
+    {
+        if ( penX + cells[i].width + gutter > atlasPixelWidth )
+        {
+            penX = gutter;
+            penY += rowHeight + gutter;
+            rowHeight = 0;
+        }
+        cellX[i] = penX;
+        cellY[i] = penY;
+        penX += cells[i].width + gutter;
+        rowHeight = std::max( rowHeight, cells[i].height );
+    }
+
+    atlasWidth = atlasPixelWidth;
+    atlasHeight = GLUtil::getInstance()->pow2( penY + rowHeight + gutter );
+    atlas.assign( atlasWidth * atlasHeight, 0 );
+
+    for ( unsigned int i = 0; i < cells.size(); i++ )
+    {
+        const GlyphCell& cell = cells[i];
+        // flipped, so the atlas goes bottom up like GL expects
+        for ( int y = 0; y < cell.height; y++ )
+        {
+            int atlasRow = cellY[i] + ( cell.height - 1 - y );
+            std::copy( &cell.field[ y * cell.width ],
+                        &cell.field[ y * cell.width ] + cell.width,
+                        &atlas[ atlasRow * atlasWidth + cellX[i] ] );
+        }
+
+        Glyph& g = glyphs[ cell.codepoint ];
+        g.s0 = (float)cellX[i] / atlasWidth;
+        g.t0 = (float)cellY[i] / atlasHeight;
+        g.s1 = (float)( cellX[i] + cell.width ) / atlasWidth;
+        g.t1 = (float)( cellY[i] + cell.height ) / atlasHeight;
+    }
+
+    fallback = glyphs[ '?' ];
+    return true;
+}
+
+bool SDFFont::initGL()
+{
+    program = GLUtil::getInstance()->loadShaders( sdfVert, sdfFrag );
+    if ( program == 0 )
+    {
+        gravUtil::logError( "SDFFont::initGL: shader failed to load\n" );
+        return false;
+    }
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "atlas" ), 0 );
+    glUseProgram( 0 );
+
+    glGenTextures( 1, &texid );
+    glBindTexture( GL_TEXTURE_2D, texid );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA8, atlasWidth, atlasHeight, 0,
+                    GL_ALPHA, GL_UNSIGNED_BYTE, &atlas[0] );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
+    if ( GLEW_ARB_vertex_buffer_object )
+        glGenBuffersARB( 1, &vbo );
+
+    return true;
+}
+
+const SDFFont::Glyph& SDFFont::getGlyph( unsigned int codepoint )
+{
+    std::map<unsigned int, Glyph>::iterator it = glyphs.find( codepoint );
+    if ( it == glyphs.end() )
+        return fallback;
+    return it->second;
+}
+
+void SDFFont::appendText( std::vector<Vertex>& dest, const std::string& text,
+                            float x, float y, float z, float scale,
+                            RGBAColor color )
+{
+    float pen = 0.0f;
+    unsigned int prev = 0;
+    unsigned int i = 0;
+
+    Vertex v;
+    v.z = z;
+    v.r = color.R; v.g = color.G; v.b = color.B; v.a = color.A;
+
+    while ( i < text.size() )
+    {
+        unsigned int c = TextMetrics::decodeUTF8( text, i );
+        if ( prev != 0 )
+            pen += metrics->getKerning( prev, c );
+        const Glyph& g = getGlyph( c );
+
+        if ( g.right > g.left )
+        {
+            float left = x + ( pen + g.left ) * scale;
+            float right = x + ( pen + g.right ) * scale;
+            float bottom = y + g.bottom * scale;
+            float top = y + g.top * scale;
+
+            v.x = left; v.y = bottom; v.s = g.s0; v.t = g.t0;
+            dest.push_back( v );
+            v.x = left; v.y = top; v.s = g.s0; v.t = g.t1;
+            dest.push_back( v );
+            v.x = right; v.y = top; v.s = g.s1; v.t = g.t1;
+            dest.push_back( v );
+            v.x = right; v.y = bottom; v.s = g.s1; v.t = g.t0;
+            dest.push_back( v );
+        }
+
+        pen += metrics->getGlyph( c ).advance;
+        prev = c;
+    }
+}
+
+void SDFFont::drawVertices( std::vector<Vertex>& verts )
+{
+    if ( verts.empty() )
+        return;
+
+    const GLubyte* base;
+    if ( vbo != 0 )
+    {
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, vbo );
+        glBufferDataARB( GL_ARRAY_BUFFER_ARB, verts.size() * sizeof( Vertex ),
+                            &verts[0], GL_STREAM_DRAW_ARB );
+        base = NULL;
+    }
+    else
+    {
+        base = (const GLubyte*)&verts[0];
+    }
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, x ) );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, s ) );
+    glColorPointer( 4, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, r ) );
+
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    glEnable( GL_TEXTURE_2D );
+    glBindTexture( GL_TEXTURE_2D, texid );
+    glUseProgram( program );
+
+    glDrawArrays( GL_QUADS, 0, verts.size() );
+
+    glUseProgram( 0 );
+    glDisable( GL_TEXTURE_2D );
+    glDisable( GL_BLEND );
+
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glDisableClientState( GL_COLOR_ARRAY );
+    if ( vbo != 0 )
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 );
+
+    verts.clear();
+}
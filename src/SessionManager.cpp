@@ -31,10 +31,12 @@
 #include <wx/utils.h>
 
 #include <stdio.h>
+#include <algorithm>
 
 #include "SessionManager.h"
 #include "VideoListener.h"
 #include "AudioManager.h"
+#include "RTPCapture.h"
 #include "grav.h"
 #include "gravUtil.h"
 
@@ -46,25 +48,43 @@ SessionManager::SessionManager( VideoListener* vl, AudioManager* al )
     videoSessionCount = 0;
     audioSessionCount = 0;
     lockCount = 0;
-    pause = false;
+    threadsRunning = false;
+    busyWait = false;
+
+    busyIterateTime = 20;
+    minSleepTime = 100;
+    maxSleepTime = 2000;
+    emptySleepTime = 10000;
+    statsInterval = 10.0;
 
     rotatePos = -1;
+    capture = NULL;
+
+    // everything goes in one shard until threads get started
+    createShards( 1 );
 }
 
 SessionManager::~SessionManager()
 {
-    mutex_free( sessionMutex );
+    stopThreads();
+
     for ( unsigned int i = 0; i < sessions.size(); i++ )
     {
-        delete sessions[i].session;
+        delete sessions[i]->session;
+        delete sessions[i];
     }
+    for ( unsigned int i = 0; i < shards.size(); i++ )
+    {
+        mutex_free( shards[i]->shardMutex );
+        delete shards[i];
+    }
+    mutex_free( sessionMutex );
 }
 
 bool SessionManager::initSession( std::string address, bool audio )
 {
     lockSessions();
 
-    SessionEntry entry;
     VPMSession* session;
     VPMSessionFactory* factory = VPMSessionFactory::getInstance();
     std::string type = std::string( audio ? "audio" : "video" );
@@ -97,18 +117,35 @@ bool SessionManager::initSession( std::string address, bool audio )
         return false;
     }
 
-    gravUtil::logVerbose( "SessionManager::initialized %s session on %s\n",
-            type.c_str(), address.c_str() );
+    // put it on whichever thread has the least to do
+    SessionShard* shard = shards[0];
+    for ( unsigned int i = 1; i < shards.size(); i++ )
+    {
+        if ( shards[i]->entries.size() < shard->entries.size() )
+            shard = shards[i];
+    }
+
+    gravUtil::logVerbose( "SessionManager::initialized %s session on %s "
+            "(shard %i)\n", type.c_str(), address.c_str(), shard->index );
     (*counter)++;
-    entry.sessionTS = random32();
-    entry.address = address;
-    entry.encryptionKey = "";
-    entry.encryptionEnabled = false;
-    entry.audio = audio;
-    entry.enabled = true;
-    entry.session = session;
+    SessionEntry* entry = new SessionEntry();
+    entry->sessionTS = random32();
+    entry->address = address;
+    entry->encryptionKey = "";
+    entry->encryptionEnabled = false;
+    entry->audio = audio;
+    entry->enabled = true;
+    entry->session = session;
+    entry->shard = shard->index;
     sessions.push_back( entry );
 
+    mutex_lock( shard->shardMutex );
+    shard->entries.push_back( entry );
+    mutex_unlock( shard->shardMutex );
+
+    if ( capture != NULL )
+        capture->addSession( address, audio );
+
     unlockSessions();
     return true;
 }
@@ -117,8 +154,8 @@ bool SessionManager::removeSession( std::string addr )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
+    std::vector<SessionEntry*>::iterator it = sessions.begin();
+    while ( it != sessions.end() && (*it)->address.compare( addr ) != 0 )
         ++it;
 
     if ( it == sessions.end() )
@@ -129,14 +166,39 @@ bool SessionManager::removeSession( std::string addr )
         return false;
     }
 
-    int* counter = (*it).audio ? &audioSessionCount : &videoSessionCount;
+    SessionEntry* entry = *it;
+    int* counter = entry->audio ? &audioSessionCount : &videoSessionCount;
     (*counter)--;
-    delete (*it).session;
     sessions.erase( it );
+
+    // the shard's thread doesn't hold on to entries between iterates, so once
+    // it's out of the shard list (and we have the lock, ie, it isn't in the
+    // middle of iterating it) it's safe to delete
+    SessionShard* shard = shards[ entry->shard ];
+    mutex_lock( shard->shardMutex );
+    std::vector<SessionEntry*>::iterator sit = shard->entries.begin();
+    while ( sit != shard->entries.end() && (*sit) != entry )
+        ++sit;
+    if ( sit != shard->entries.end() )
+        shard->entries.erase( sit );
+    delete entry->session;
+    mutex_unlock( shard->shardMutex );
+
+    if ( capture != NULL )
+        capture->removeSession( addr );
+
+    delete entry;
     unlockSessions();
     return true;
 }
 
+void SessionManager::setCapture( RTPCapture* c )
+{
+    lockSessions();
+    capture = c;
+    unlockSessions();
+}
+
 void SessionManager::addAvailableSession( std::string addr, bool audio )
 {
     lockSessions();
@@ -168,19 +230,10 @@ void SessionManager::removeAvailableSession( std::string addr, bool audio )
         if ( i <= rotatePos )
             rotatePos--;
         // find session & remove it from main list if it's active
-        std::vector<SessionEntry>::iterator it2 = sessions.begin();
-        while ( it2 != sessions.end() && (*it2).address.compare( addr ) != 0 )
-            ++it2;
-        if ( it2 == sessions.end() )
-        {
-            unlockSessions();
-            return;
-        }
-        else
-        {
-            unlockSessions();
-            removeSession( (*it2).address );
-        }
+        SessionEntry* entry = findSession( addr );
+        unlockSessions();
+        if ( entry != NULL )
+            removeSession( addr );
     }
 }
 
@@ -302,16 +355,18 @@ bool SessionManager::setSessionEnable( std::string addr, bool set )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
-        ++it;
-    if ( it == sessions.end() )
+    SessionEntry* entry = findSession( addr );
+    if ( entry == NULL )
     {
         unlockSessions();
         return false;
     }
 
-    (*it).enabled = set;
+    SessionShard* shard = shards[ entry->shard ];
+    mutex_lock( shard->shardMutex );
+    entry->enabled = set;
+    mutex_unlock( shard->shardMutex );
+
     unlockSessions();
     return true;
 }
@@ -320,16 +375,14 @@ bool SessionManager::isSessionEnabled( std::string addr )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
-        ++it;
-    if ( it == sessions.end() )
+    SessionEntry* entry = findSession( addr );
+    if ( entry == NULL )
     {
         unlockSessions();
         return false;
     }
 
-    bool ret = (*it).enabled;
+    bool ret = entry->enabled;
     unlockSessions();
     return ret;
 }
@@ -338,18 +391,19 @@ bool SessionManager::setEncryptionKey( std::string addr, std::string key )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
-        ++it;
-    if ( it == sessions.end() )
+    SessionEntry* entry = findSession( addr );
+    if ( entry == NULL )
     {
         unlockSessions();
         return false;
     }
 
-    (*it).encryptionKey = key;
-    (*it).encryptionEnabled = true;
-    (*it).session->setEncryptionKey( key.c_str() );
+    SessionShard* shard = shards[ entry->shard ];
+    mutex_lock( shard->shardMutex );
+    entry->encryptionKey = key;
+    entry->encryptionEnabled = true;
+    entry->session->setEncryptionKey( key.c_str() );
+    mutex_unlock( shard->shardMutex );
 
     unlockSessions();
     return true;
@@ -359,17 +413,18 @@ bool SessionManager::disableEncryption( std::string addr )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
-        ++it;
-    if ( it == sessions.end() )
+    SessionEntry* entry = findSession( addr );
+    if ( entry == NULL )
     {
         unlockSessions();
         return false;
     }
 
-    (*it).encryptionEnabled = false;
-    (*it).session->setEncryptionKey( NULL );
+    SessionShard* shard = shards[ entry->shard ];
+    mutex_lock( shard->shardMutex );
+    entry->encryptionEnabled = false;
+    entry->session->setEncryptionKey( NULL );
+    mutex_unlock( shard->shardMutex );
 
     unlockSessions();
     return true;
@@ -379,57 +434,244 @@ bool SessionManager::isEncryptionEnabled( std::string addr )
 {
     lockSessions();
 
-    std::vector<SessionEntry>::iterator it = sessions.begin();
-    while ( it != sessions.end() && (*it).address.compare( addr ) != 0 )
-        ++it;
-    if ( it == sessions.end() )
+    SessionEntry* entry = findSession( addr );
+    if ( entry == NULL )
     {
         unlockSessions();
         return false; // this doesn't quite make sense - should throw some other
                       // kind of error for session not found?
     }
 
-    bool ret = (*it).encryptionEnabled;
+    bool ret = entry->encryptionEnabled;
     unlockSessions();
     return ret;
 }
 
-bool SessionManager::iterateSessions()
+void SessionManager::startThreads( int numThreads )
+{
+    if ( threadsRunning )
+        return;
+    if ( numThreads < 1 )
+        numThreads = 1;
+
+    lockSessions();
+    createShards( numThreads );
+    unlockSessions();
+
+    gravUtil::logVerbose( "SessionManager::startThreads: starting %i "
+            "session thread(s)\n", numThreads );
+    threadsRunning = true;
+    for ( unsigned int i = 0; i < shards.size(); i++ )
+        shards[i]->worker = thread_start( threadMain, shards[i] );
+}
+
+void SessionManager::stopThreads()
 {
-    // kind of a hack to force this to wait, when removing etc.
-    // mutex should do this but this thread seems way too eager
-    if ( pause )
+    if ( !threadsRunning )
+        return;
+
+    threadsRunning = false;
+    for ( unsigned int i = 0; i < shards.size(); i++ )
     {
-        //gravUtil::logVerbose( "Sessions temporarily paused...\n" );
-        wxMicroSleep( 10 );
+        thread_join( shards[i]->worker );
+        shards[i]->worker = NULL;
     }
+    gravUtil::logVerbose( "SessionManager::stopThreads: session threads "
+            "stopped\n" );
+}
 
-    // note: iterate doesn't do lockSessions() since it shouldn't affect pause
-    mutex_lock( sessionMutex );
-    lockCount++;
+bool SessionManager::areThreadsRunning()
+{
+    return threadsRunning;
+}
 
-    bool haveSessions = false;
-    for ( unsigned int i = 0; i < sessions.size(); i++ )
+void SessionManager::setBusyWait( bool b )
+{
+    busyWait = b;
+}
+
+double SessionManager::getThreadCPUTime()
+{
+    if ( !threadsRunning )
+        return -1.0;
+
+    double total = 0.0;
+    for ( unsigned int i = 0; i < shards.size(); i++ )
     {
-        if ( sessions[i].enabled )
-            sessions[i].session->iterate( sessions[i].sessionTS++ );
-        haveSessions = haveSessions || sessions[i].enabled;
+        if ( shards[i]->cpuTime < 0.0 )
+            return -1.0;
+        total += shards[i]->cpuTime;
     }
-    if ( sessions.size() >= 1 && gravApp::threadDebug )
+    return total;
+}
+
+void* SessionManager::threadMain( void* args )
+{
+    SessionShard* shard = (SessionShard*)args;
+    SessionManager* manager = shard->manager;
+    gravUtil::logVerbose( "SessionManager::starting network/decoding thread "
+            "%i...\n", shard->index );
+
+    // wait a bit before starting this thread, since doing it too early might
+    // affect the WX tree before it's fully initialized somehow, rarely
+    // resulting in broken text or a crash
+    wxMilliSleep( 100 );
+
+    int sleepTime = manager->minSleepTime;
+    int wakeups = 0;
+    double statsStart = gravUtil::getTime();
+    double cpuStart = gravUtil::getThreadCPUTime();
+    // the usage can only be read on the thread itself, so keep a copy for
+    // getThreadCPUTime() - not every pass, since that'd add a syscall to
+    // every iteration when busy waiting
+    double cpuSampleTime = statsStart;
+    shard->cpuTime = cpuStart;
+
+    while ( manager->threadsRunning )
     {
-        if ( sessions[0].sessionTS % 1000 == 0 )
+        double passStart = gravUtil::getTime();
+        int iterated = manager->iterateShard( shard );
+        double passTime = ( gravUtil::getTime() - passStart ) * 1000000.0;
+
+        if ( iterated == 0 )
+        {
+            // no sessions, so sleep so as not to spin and consume CPU
+            // needlessly
+            wxMicroSleep( manager->emptySleepTime );
+            sleepTime = manager->minSleepTime;
+            wakeups++;
+        }
+        else if ( manager->busyWait ||
+                passTime > manager->busyIterateTime * iterated )
+        {
+            // something came in, so there's probably more - check again
+            // right away, and start backing off from the bottom once it's
+            // drained
+            sleepTime = manager->minSleepTime;
+        }
+        else
+        {
+            wxMicroSleep( sleepTime );
+            sleepTime = std::min( sleepTime * 2, manager->maxSleepTime );
+            wakeups++;
+        }
+
+        double now = gravUtil::getTime();
+        if ( now - cpuSampleTime > 0.005 )
+        {
+            shard->cpuTime = gravUtil::getThreadCPUTime();
+            cpuSampleTime = now;
+        }
+
+        if ( now - statsStart > manager->statsInterval )
         {
-            gravUtil::logVerbose( "SessionManager::iterate: "
-                    "have %u sessions, TS=%u\n",
-                    sessions.size(), sessions[0].sessionTS );
+            double cpuNow = shard->cpuTime;
+            if ( cpuStart >= 0.0 && cpuNow >= 0.0 )
+            {
+                gravUtil::logVerbose( "SessionManager::thread %i: %.1f%% CPU, "
+                        "%.0f wakeups/sec\n", shard->index,
+                        ( cpuNow - cpuStart ) / ( now - statsStart ) * 100.0,
+                        (double)wakeups / ( now - statsStart ) );
+            }
+            statsStart = now;
+            cpuStart = cpuNow;
+            wakeups = 0;
+        }
+
+        if ( gravApp::threadDebug && shard->index == 0 )
+        {
+            if ( gravApp::threadCounter == 0 )
+                gravUtil::logVerbose( "grav::thread still running\n" );
+            gravApp::threadCounter = (gravApp::threadCounter+1)%1000;
         }
     }
+    gravUtil::logVerbose( "SessionManager::thread %i ending...\n",
+            shard->index );
+    return 0;
+}
 
-    mutex_unlock( sessionMutex );
-    lockCount--;
+bool SessionManager::iterateSessions()
+{
+    bool haveSessions = false;
+    for ( unsigned int i = 0; i < shards.size(); i++ )
+        haveSessions = iterateShard( shards[i] ) > 0 || haveSessions;
     return haveSessions;
 }
 
+int SessionManager::iterateShard( SessionShard* shard )
+{
+    int iterated = 0;
+
+    // lock per session rather than for the whole pass, so adding or removing
+    // sessions from another thread only has to wait for a single iterate.
+    // the index may skip an entry if one gets removed in between, which just
+    // means it gets iterated next pass
+    for ( unsigned int i = 0; ; i++ )
+    {
+        mutex_lock( shard->shardMutex );
+        if ( i >= shard->entries.size() )
+        {
+            mutex_unlock( shard->shardMutex );
+            break;
+        }
+
+        SessionEntry* entry = shard->entries[i];
+        if ( entry->enabled )
+        {
+            entry->session->iterate( entry->sessionTS++ );
+            iterated++;
+        }
+
+        if ( i == 0 && gravApp::threadDebug && entry->sessionTS % 1000 == 0 )
+        {
+            gravUtil::logVerbose( "SessionManager::iterate: shard %i "
+                    "has %u sessions, TS=%u\n", shard->index,
+                    shard->entries.size(), entry->sessionTS );
+        }
+        mutex_unlock( shard->shardMutex );
+    }
+
+    return iterated;
+}
+
+SessionEntry* SessionManager::findSession( std::string addr )
+{
+    for ( unsigned int i = 0; i < sessions.size(); i++ )
+    {
+        if ( sessions[i]->address.compare( addr ) == 0 )
+            return sessions[i];
+    }
+    return NULL;
+}
+
+void SessionManager::createShards( int numShards )
+{
+    for ( unsigned int i = 0; i < shards.size(); i++ )
+    {
+        mutex_free( shards[i]->shardMutex );
+        delete shards[i];
+    }
+    shards.clear();
+
+    for ( int i = 0; i < numShards; i++ )
+    {
+        SessionShard* shard = new SessionShard();
+        shard->shardMutex = mutex_create();
+        shard->worker = NULL;
+        shard->manager = this;
+        shard->index = i;
+        shard->cpuTime = -1.0;
+        shards.push_back( shard );
+    }
+
+    // deal out existing sessions evenly
+    for ( unsigned int i = 0; i < sessions.size(); i++ )
+    {
+        sessions[i]->shard = i % numShards;
+        shards[ i % numShards ]->entries.push_back( sessions[i] );
+    }
+}
+
 int SessionManager::getVideoSessionCount()
 {
     return videoSessionCount;
@@ -442,14 +684,12 @@ int SessionManager::getAudioSessionCount()
 
 void SessionManager::lockSessions()
 {
-    pause = true;
     mutex_lock( sessionMutex );
     lockCount++;
 }
 
 void SessionManager::unlockSessions()
 {
-    pause = false;
     mutex_unlock( sessionMutex );
     lockCount--;
 }
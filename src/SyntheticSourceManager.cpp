@@ -0,0 +1,337 @@
+/*
+ * @file SyntheticSourceManager.cpp
+ *
+ * Implementation of the SyntheticSourceManager class. See
+ * SyntheticSourceManager.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SyntheticSourceManager.h"
+#include "VideoListener.h"
+#include "VideoSource.h"
+#include "TripleBufferSink.h"
+#include "gravUtil.h"
+
+#include <wx/utils.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+// 75% color bars: white, yellow, cyan, green, magenta, red, blue, black
+static const int numBars = 8;
+static const uint8_t barRGB[ numBars ][3] = {
+    { 191, 191, 191 }, { 191, 191, 0 }, { 0, 191, 191 }, { 0, 191, 0 },
+    { 191, 0, 191 }, { 191, 0, 0 }, { 0, 0, 191 }, { 0, 0, 0 } };
+// same bars in BT.601 video range
+static const uint8_t barYUV[ numBars ][3] = {
+    { 180, 128, 128 }, { 162, 44, 142 }, { 131, 156, 44 },
+    { 112, 72, 58 }, { 84, 184, 198 }, { 65, 100, 212 }, { 35, 212, 114 },
+    { 16, 128, 128 } };
+
+/*
+ * Position moving back & forth between 0 and range.
+ */
+static unsigned int bounce( unsigned int t, unsigned int range )
+{
+    if ( range == 0 )
+        return 0;
+    t %= range * 2;
+    return t > range ? range * 2 - t : t;
+}
+
+SyntheticSourceManager::SyntheticSourceManager( VideoListener* l )
+    : listener( l )
+{
+    width = 0;
+    height = 0;
+    fps = 30.0f;
+    format = VIDEO_FORMAT_RGB24;
+    boxSize = 0;
+    producer = NULL;
+    running = false;
+}
+
+SyntheticSourceManager::~SyntheticSourceManager()
+{
+    stop();
+    for ( unsigned int i = 0; i < sources.size(); i++ )
+        delete sources[i].sink;
+}
+
+bool SyntheticSourceManager::addSources( std::string spec )
+{
+    if ( !sources.empty() )
+    {
+        gravUtil::logError( "SyntheticSourceManager::addSources: synthetic "
+                "sources already added\n" );
+        return false;
+    }
+
+    unsigned int count, w, h;
+    float f = 30.0f;
+    int parsed = sscanf( spec.c_str(), "%ux%ux%u@%f", &count, &w, &h, &f );
+    // 4:2:0 needs even dimensions, & the pattern needs a bit of room
+    if ( parsed < 3 || count == 0 || w < 16 || h < 16 || w % 2 != 0 ||
+            h % 2 != 0 || f <= 0.0f )
+    {
+        gravUtil::logError( "SyntheticSourceManager::addSources: invalid "
+                "spec \"%s\", should be <count>x<width>x<height>[@fps], "
+                "with even width & height\n", spec.c_str() );
+        return false;
+    }
+
+    width = w;
+    height = h;
+    fps = f;
+
+    bool convert;
+    format = listener->getSinkFormat( VIDEO_FORMAT_YUV420, &convert );
+    buildPatterns();
+
+    gravUtil::logMessage( "SyntheticSourceManager::addSources: adding %u "
+            "%ux%u %s sources at %.1f fps\n", count, width, height,
+            format == VIDEO_FORMAT_YUV420 ? "YUV420" : "RGB24", fps );
+
+    double now = gravUtil::getTime();
+    for ( unsigned int i = 0; i < count; i++ )
+    {
+        TripleBufferSink* sink = new TripleBufferSink( format );
+        if ( !sink->initialise() )
+        {
+            gravUtil::logError( "SyntheticSourceManager::addSources: failed "
+                    "to initialise video sink\n" );
+            delete sink;
+            break;
+        }
+
+        SyntheticSource s;
+        s.sink = sink;
+        s.source = listener->addSource( NULL, i, sink, convert );
+        // spread the sources out over the frame interval so they don't all
+        // produce a frame at the same moment
+        s.nextFrameTime = now + ( (double)i / count ) / fps;
+        s.frame = 0;
+        s.phase = i * 37;
+
+        std::ostringstream name;
+        name << "Synthetic " << ( i + 1 );
+        s.source->setName( name.str() );
+
+        sources.push_back( s );
+    }
+
+    return !sources.empty();
+}
+
+void SyntheticSourceManager::start()
+{
+    if ( running || sources.empty() )
+        return;
+
+    running = true;
+    producer = thread_start( threadMain, this );
+}
+
+void SyntheticSourceManager::stop()
+{
+    if ( !running )
+        return;
+
+    running = false;
+    thread_join( producer );
+    producer = NULL;
+}
+
+void SyntheticSourceManager::removeSources()
+{
+    for ( unsigned int i = 0; i < sources.size(); i++ )
+    {
+        if ( sources[i].source != NULL )
+        {
+            listener->removeSource( sources[i].source );
+            sources[i].source = NULL;
+        }
+    }
+}
+
+void SyntheticSourceManager::setSiteIDs( unsigned int perSite )
+{
+    if ( perSite == 0 )
+        return;
+
+    for ( unsigned int i = 0; i < sources.size(); i++ )
+    {
+        if ( sources[i].source == NULL )
+            continue;
+
+        std::ostringstream siteID;
+        siteID << "Synthetic site " << ( i / perSite + 1 );
+        listener->setSiteID( sources[i].source, siteID.str() );
+    }
+}
+
+unsigned int SyntheticSourceManager::getSourceCount()
+{
+    return sources.size();
+}
+
+void* SyntheticSourceManager::threadMain( void* args )
+{
+    SyntheticSourceManager* manager = (SyntheticSourceManager*)args;
+    manager->producerLoop();
+    return 0;
+}
+
+void SyntheticSourceManager::producerLoop()
+{
+    double interval = 1.0 / fps;
+
+    while ( running )
+    {
+        double now = gravUtil::getTime();
+        // wake up at least this often so stopping doesn't take long
+        double nextWake = now + 0.05;
+
+        for ( unsigned int i = 0; i < sources.size(); i++ )
+        {
+            SyntheticSource& s = sources[i];
+            if ( now >= s.nextFrameTime )
+            {
+                if ( !s.source->isMuted() && !s.source->isAutoPaused() )
+                    generateFrame( s );
+
+                s.nextFrameTime += interval;
+                // if we've fallen behind, drop frames rather than bursting to
+                // catch up, same as a real source would look
+                if ( s.nextFrameTime < now )
+                    s.nextFrameTime = now + interval;
+            }
+            if ( s.nextFrameTime < nextWake )
+                nextWake = s.nextFrameTime;
+        }
+
+        double sleep = nextWake - gravUtil::getTime();
+        if ( sleep > 0.0 )
+            wxMicroSleep( (unsigned long)( sleep * 1000000.0 ) );
+    }
+}
+
+void SyntheticSourceManager::buildPatterns()
+{
+    unsigned int rowLen = width * 2;
+    barRowY.resize( rowLen );
+    barRowRGB.resize( rowLen * 3 );
+    rampRowY.resize( rowLen );
+    rampRowRGB.resize( rowLen * 3 );
+    barRowU.resize( rowLen / 2 );
+    barRowV.resize( rowLen / 2 );
+
+    for ( unsigned int x = 0; x < rowLen; x++ )
+    {
+        int bar = ( ( x % width ) * numBars ) / width;
+        barRowY[x] = barYUV[ bar ][0];
+        for ( int c = 0; c < 3; c++ )
+            barRowRGB[ x*3 + c ] = barRGB[ bar ][c];
+
+        rampRowY[x] = (uint8_t)( 16 + ( ( x % width ) * 219 ) / width );
+        uint8_t gray = (uint8_t)( ( ( x % width ) * 255 ) / width );
+        for ( int c = 0; c < 3; c++ )
+            rampRowRGB[ x*3 + c ] = gray;
+    }
+    for ( unsigned int x = 0; x < rowLen / 2; x++ )
+    {
+        int bar = ( ( ( x * 2 ) % width ) * numBars ) / width;
+        barRowU[x] = barYUV[ bar ][1];
+        barRowV[x] = barYUV[ bar ][2];
+    }
+
+    boxSize = ( std::min( width, height ) / 8 ) & ~1u;
+}
+
+void SyntheticSourceManager::generateFrame( SyntheticSource& s )
+{
+    uint8_t* dest = s.sink->getWriteBuffer( width, height );
+
+    // bars scroll sideways, box bounces around over them. even positions
+    // keep things lined up with the chroma
+    unsigned int offset = ( ( s.frame * 8 + s.phase ) % width ) & ~1u;
+    int boxX = bounce( s.frame * 6 + s.phase * 7, width - boxSize ) & ~1u;
+    int boxY = bounce( s.frame * 4 + s.phase * 3, height - boxSize ) & ~1u;
+
+    if ( format == VIDEO_FORMAT_YUV420 )
+        generateYUV420( dest, offset, boxX, boxY );
+    else
+        generateRGB24( dest, offset, boxX, boxY );
+
+    s.sink->publishFrame();
+    s.frame++;
+}
+
+void SyntheticSourceManager::generateYUV420( uint8_t* dest,
+                                                unsigned int offset, int boxX,
+                                                int boxY )
+{
+    uint8_t* y = dest;
+    uint8_t* u = y + width * height;
+    uint8_t* v = u + ( width / 2 ) * ( height / 2 );
+    unsigned int cw = width / 2;
+    unsigned int ch = height / 2;
+    // bars on the top three quarters, ramp on the rest
+    unsigned int barRows = ( height * 3 / 4 ) & ~1u;
+
+    for ( unsigned int row = 0; row < barRows; row++ )
+        memcpy( y + row * width, &barRowY[ offset ], width );
+    for ( unsigned int row = barRows; row < height; row++ )
+        memcpy( y + row * width, &rampRowY[ offset ], width );
+
+    for ( unsigned int row = 0; row < barRows / 2; row++ )
+    {
+        memcpy( u + row * cw, &barRowU[ offset / 2 ], cw );
+        memcpy( v + row * cw, &barRowV[ offset / 2 ], cw );
+    }
+    memset( u + ( barRows / 2 ) * cw, 128, ( ch - barRows / 2 ) * cw );
+    memset( v + ( barRows / 2 ) * cw, 128, ( ch - barRows / 2 ) * cw );
+
+    for ( unsigned int row = 0; row < boxSize; row++ )
+        memset( y + ( boxY + row ) * width + boxX, 235, boxSize );
+    for ( unsigned int row = 0; row < boxSize / 2; row++ )
+    {
+        memset( u + ( boxY / 2 + row ) * cw + boxX / 2, 128, boxSize / 2 );
+        memset( v + ( boxY / 2 + row ) * cw + boxX / 2, 128, boxSize / 2 );
+    }
+}
+
+void SyntheticSourceManager::generateRGB24( uint8_t* dest,
+                                            unsigned int offset, int boxX,
+                                            int boxY )
+{
+    unsigned int stride = width * 3;
+    unsigned int barRows = height * 3 / 4;
+
+    for ( unsigned int row = 0; row < barRows; row++ )
+        memcpy( dest + row * stride, &barRowRGB[ offset * 3 ], stride );
+    for ( unsigned int row = barRows; row < height; row++ )
+        memcpy( dest + row * stride, &rampRowRGB[ offset * 3 ], stride );
+
+    for ( unsigned int row = 0; row < boxSize; row++ )
+        memset( dest + ( boxY + row ) * stride + boxX * 3, 255, boxSize * 3 );
+}
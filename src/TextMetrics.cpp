@@ -0,0 +1,268 @@
+/*
+ * @file TextMetrics.cpp
+ *
+ * Implementation of the TextMetrics class. See TextMetrics.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextMetrics.h"
+#include "gravUtil.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+
+// same as the FTGL main font's FaceSize, so a pixel here is a font unit
+static const int unitsPerEm = 100;
+
+TextMetrics::TextMetrics()
+{
+    fallback.advance = 0.0f;
+    fallback.left = 0.0f; fallback.bottom = 0.0f;
+    fallback.right = 0.0f; fallback.top = 0.0f;
+}
+
+bool TextMetrics::load( const std::string& file )
+{
+    FT_Library library;
+    if ( FT_Init_FreeType( &library ) != 0 )
+    {
+        gravUtil::logError( "TextMetrics::load: couldn't initialize "
+                "FreeType\n" );
+        return false;
+    }
+
+    FT_Face face;
+    if ( FT_New_Face( library, file.c_str(), 0, &face ) != 0 ||
+            FT_Set_Pixel_Sizes( face, 0, unitsPerEm ) != 0 )
+    {
+        gravUtil::logError( "TextMetrics::load: couldn't load %s\n",
+                file.c_str() );
+        FT_Done_FreeType( library );
+        return false;
+    }
+
+    for ( unsigned int c = 32; c < 256; c++ )
+    {
+        // no glyphs for the C1 controls
+        if ( c >= 127 && c < 160 )
+            continue;
+        // metrics only, no need to render
+        if ( FT_Get_Char_Index( face, c ) == 0 ||
+                FT_Load_Char( face, c, FT_LOAD_DEFAULT ) != 0 )
+            continue;
+
+        const FT_Glyph_Metrics& m = face->glyph->metrics;
+        Glyph g;
+        g.advance = face->glyph->advance.x / 64.0f;
+        g.left = m.horiBearingX / 64.0f;
+        g.right = ( m.horiBearingX + m.width ) / 64.0f;
+        g.top = m.horiBearingY / 64.0f;
+        g.bottom = ( m.horiBearingY - m.height ) / 64.0f;
+        glyphs[c] = g;
+    }
+
+    if ( FT_HAS_KERNING( face ) )
+    {
+        std::map<unsigned int, Glyph>::iterator l, r;
+        for ( l = glyphs.begin(); l != glyphs.end(); ++l )
+        {
+            FT_UInt leftIndex = FT_Get_Char_Index( face, l->first );
+            for ( r = glyphs.begin(); r != glyphs.end(); ++r )
+            {
+                FT_Vector delta;
+                FT_Get_Kerning( face, leftIndex,
+                                FT_Get_Char_Index( face, r->first ),
+                                FT_KERNING_UNFITTED, &delta );
+                if ( delta.x != 0 )
+                    kerning[ ( l->first << 16 ) | r->first ] =
+                            delta.x / 64.0f;
+            }
+        }
+    }
+
+    FT_Done_Face( face );
+    FT_Done_FreeType( library );
+
+    if ( glyphs.find( '?' ) == glyphs.end() )
+    {
+        gravUtil::logError( "TextMetrics::load: %s has no usable glyphs\n",
+                file.c_str() );
+        glyphs.clear();
+        kerning.clear();
+        return false;
+    }
+
+    fallback = glyphs[ '?' ];
+    return true;
+}
+
+FTBBox TextMetrics::BBox( const std::string& text ) const
+{
+    TextPrefixes prefixes;
+    measurePrefixes( text, prefixes );
+    return getPrefixBBox( prefixes, prefixes.ends.size() );
+}
+
+void TextMetrics::measurePrefixes( const std::string& text,
+                                    TextPrefixes& prefixes ) const
+{
+    prefixes.ends.clear();
+    prefixes.left.clear(); prefixes.right.clear();
+    prefixes.bottom.clear(); prefixes.top.clear();
+
+    float lowerX = 0.0f, lowerY = 0.0f, upperX = 0.0f, upperY = 0.0f;
+    bool inked = false;
+    float pen = 0.0f;
+    unsigned int prev = 0;
+    unsigned int i = 0;
+
+    while ( i < text.size() )
+    {
+        unsigned int c = decodeUTF8( text, i );
+        if ( prev != 0 )
+            pen += getKerning( prev, c );
+        const Glyph& g = getGlyph( c );
+
+        if ( g.right > g.left )
+        {
+            if ( !inked )
+            {
+                lowerX = pen + g.left; upperX = pen + g.right;
+                lowerY = g.bottom; upperY = g.top;
+                inked = true;
+            }
+            else
+            {
+                lowerX = std::min( lowerX, pen + g.left );
+                upperX = std::max( upperX, pen + g.right );
+                lowerY = std::min( lowerY, g.bottom );
+                upperY = std::max( upperY, g.top );
+            }
+        }
+
+        pen += g.advance;
+        prev = c;
+
+        prefixes.ends.push_back( i );
+        prefixes.left.push_back( lowerX );
+        prefixes.bottom.push_back( lowerY );
+        prefixes.top.push_back( upperY );
+        // trailing spaces still take up room
+        prefixes.right.push_back( inked ? std::max( upperX, pen ) : 0.0f );
+    }
+}
+
+FTBBox TextMetrics::getPrefixBBox( const TextPrefixes& prefixes,
+                                    unsigned int count )
+{
+    if ( count == 0 )
+        return FTBBox();
+
+    unsigned int last = std::min( count, (unsigned int)prefixes.ends.size() )
+                            - 1;
+    return FTBBox( prefixes.left[last], prefixes.bottom[last], 0.0f,
+                    prefixes.right[last], prefixes.top[last], 0.0f );
+}
+
+unsigned int TextMetrics::fitPrefix( const TextPrefixes& prefixes,
+                                        float width )
+{
+    // first prefix that's too wide
+    unsigned int low = 0, high = prefixes.ends.size();
+    while ( low < high )
+    {
+        unsigned int mid = ( low + high ) / 2;
+        if ( prefixes.right[mid] - prefixes.left[mid] > width )
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+std::vector<unsigned int> TextMetrics::getCodepoints() const
+{
+    std::vector<unsigned int> codepoints;
+    std::map<unsigned int, Glyph>::const_iterator it;
+    for ( it = glyphs.begin(); it != glyphs.end(); ++it )
+        codepoints.push_back( it->first );
+    return codepoints;
+}
+
+unsigned int TextMetrics::decodeUTF8( const std::string& text,
+                                        unsigned int& i )
+{
+    unsigned char c = text[i++];
+    if ( c < 0x80 )
+        return c;
+
+    int extra;
+    unsigned int codepoint;
+    if ( ( c & 0xE0 ) == 0xC0 )
+    {
+        extra = 1;
+        codepoint = c & 0x1F;
+    }
+    else if ( ( c & 0xF0 ) == 0xE0 )
+    {
+        extra = 2;
+        codepoint = c & 0x0F;
+    }
+    else if ( ( c & 0xF8 ) == 0xF0 )
+    {
+        extra = 3;
+        codepoint = c & 0x07;
+    }
+    else
+    {
+        // stray continuation byte - names from the network aren't always
+        // valid UTF-8, so treat it as Latin-1
+        return c;
+    }
+
+    for ( int j = 0; j < extra; j++ )
+    {
+        if ( i >= text.size() || ( text[i] & 0xC0 ) != 0x80 )
+            return '?';
+        codepoint = ( codepoint << 6 ) | ( text[i++] & 0x3F );
+    }
+    return codepoint;
+}
+
+const TextMetrics::Glyph& TextMetrics::getGlyph( unsigned int codepoint ) const
+{
+    std::map<unsigned int, Glyph>::const_iterator it =
+            glyphs.find( codepoint );
+    if ( it == glyphs.end() )
+        return fallback;
+    return it->second;
+}
+
+float TextMetrics::getKerning( unsigned int left, unsigned int right ) const
+{
+    if ( kerning.empty() || left > 0xFFFF || right > 0xFFFF )
+        return 0.0f;
+
+    std::map<unsigned int, float>::const_iterator it =
+            kerning.find( ( left << 16 ) | right );
+    return it != kerning.end() ? it->second : 0.0f;
+}
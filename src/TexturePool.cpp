@@ -0,0 +1,202 @@
+/*
+ * @file TexturePool.cpp
+ *
+ * Implementation of the TexturePool class. See TexturePool.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TexturePool.h"
+#include "gravUtil.h"
+
+#include <cstring>
+
+bool TexturePool::KeyCompare::operator()( const TextureKey& a,
+                                            const TextureKey& b ) const
+{
+    if ( a.width != b.width )
+        return a.width < b.width;
+    if ( a.height != b.height )
+        return a.height < b.height;
+    return a.internalFormat < b.internalFormat;
+}
+
+TexturePool::TexturePool()
+{
+    pooledBytes = 0;
+    // enough for a few dozen SD videos or a handful of HD ones
+    maxPooledBytes = 64 * 1024 * 1024;
+
+    hits = 0;
+    misses = 0;
+
+    grayBuffer = 0;
+    grayBufferSize = 0;
+}
+
+TexturePool::~TexturePool()
+{
+    clear();
+    if ( grayBuffer != 0 )
+        glDeleteBuffersARB( 1, &grayBuffer );
+}
+
+GLuint TexturePool::acquire( unsigned int w, unsigned int h,
+                                GLint internalFormat )
+{
+    TextureKey key;
+    key.width = w;
+    key.height = h;
+    key.internalFormat = internalFormat;
+
+    GLuint tex;
+    bool reused = false;
+    std::map<TextureKey, std::vector<GLuint>, KeyCompare>::iterator it =
+        freeTextures.find( key );
+    if ( it != freeTextures.end() && !it->second.empty() )
+    {
+        tex = it->second.back();
+        it->second.pop_back();
+        pooledBytes -= getByteSize( w, h, internalFormat );
+        reused = true;
+        hits++;
+    }
+    else
+    {
+        glGenTextures( 1, &tex );
+        misses++;
+    }
+
+    gravUtil::logVerbose( "TexturePool::acquire: %ix%i texture %s (%lu "
+            "reused, %lu new so far)\n", w, h, reused ? "reused" : "created",
+            hits, misses );
+
+    glBindTexture( GL_TEXTURE_2D, tex );
+    // a reused texture already has storage of the right size, so only needs
+    // its contents replaced
+    fillGray( w, h, internalFormat, !reused );
+
+    return tex;
+}
+
+void TexturePool::release( GLuint tex, unsigned int w, unsigned int h,
+                            GLint internalFormat )
+{
+    if ( tex == 0 )
+        return;
+
+    unsigned long size = getByteSize( w, h, internalFormat );
+    if ( pooledBytes + size > maxPooledBytes )
+    {
+        glDeleteTextures( 1, &tex );
+        return;
+    }
+
+    TextureKey key;
+    key.width = w;
+    key.height = h;
+    key.internalFormat = internalFormat;
+    freeTextures[key].push_back( tex );
+    pooledBytes += size;
+}
+
+void TexturePool::clear()
+{
+    std::map<TextureKey, std::vector<GLuint>, KeyCompare>::iterator it;
+    for ( it = freeTextures.begin(); it != freeTextures.end(); ++it )
+    {
+        if ( !it->second.empty() )
+            glDeleteTextures( it->second.size(), &(it->second[0]) );
+    }
+    freeTextures.clear();
+    pooledBytes = 0;
+}
+
+void TexturePool::fillGray( unsigned int w, unsigned int h,
+                            GLint internalFormat, bool allocate )
+{
+    // source is always one byte of luminance per pixel, regardless of the
+    // texture's format
+    unsigned int size = w * h;
+    const GLubyte* data = NULL;
+    bool useBuffer = GLUtil::getInstance()->arePBOsAvailable();
+
+    if ( useBuffer )
+    {
+        if ( grayBuffer == 0 )
+            glGenBuffersARB( 1, &grayBuffer );
+        glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, grayBuffer );
+        if ( size > grayBufferSize )
+        {
+            glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL,
+                                GL_STATIC_DRAW_ARB );
+            GLubyte* dest = (GLubyte*)glMapBufferARB(
+                                GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB );
+            if ( dest != NULL )
+            {
+                memset( dest, 128, size );
+                glUnmapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB );
+                grayBufferSize = size;
+            }
+            else
+            {
+                gravUtil::logWarning( "TexturePool::fillGray: failed to map "
+                        "buffer, using client memory\n" );
+                glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+                grayBufferSize = 0;
+                useBuffer = false;
+            }
+        }
+        // if bound, data is an offset into the buffer from here on
+    }
+
+    if ( !useBuffer && size > 0 )
+    {
+        if ( grayClientBuffer.size() < size )
+            grayClientBuffer.resize( size, 128 );
+        data = &grayClientBuffer[0];
+    }
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    if ( allocate )
+    {
+        glTexImage2D( GL_TEXTURE_2D, 0, internalFormat, w, h, 0,
+                        GL_LUMINANCE, GL_UNSIGNED_BYTE, data );
+    }
+    else
+    {
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, w, h, GL_LUMINANCE,
+                            GL_UNSIGNED_BYTE, data );
+    }
+
+    if ( useBuffer )
+        glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+}
+
+unsigned long TexturePool::getByteSize( unsigned int w, unsigned int h,
+                                        GLint internalFormat )
+{
+    int bytesPerPixel = 1;
+    if ( internalFormat == GL_RGBA )
+        bytesPerPixel = 4;
+    else if ( internalFormat == GL_RGB )
+        bytesPerPixel = 3;
+    return (unsigned long)w * h * bytesPerPixel;
+}
@@ -0,0 +1,184 @@
+/*
+ * @file TileRenderer.cpp
+ *
+ * Implementation of the TileRenderer class. See TileRenderer.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TileRenderer.h"
+
+#include <cstddef>
+
+TileRenderer::TileRenderer()
+{
+    vbo = 0;
+    vboChecked = false;
+}
+
+TileRenderer::~TileRenderer()
+{
+    if ( vbo != 0 )
+        glDeleteBuffersARB( 1, &vbo );
+}
+
+bool TileRenderer::isFormatAvailable( Format f )
+{
+    // fixed function is always there
+    return f == FORMAT_RGB || getProgram( f ) != 0;
+}
+
+void TileRenderer::addTile( Format f, float left, float bottom, float right,
+                            float top, float z, float s, float t, float alpha,
+                            GLuint tex, GLuint uTex, GLuint vTex )
+{
+    Tile tile;
+    tile.textures[0] = tex;
+    tile.textures[1] = uTex;
+    tile.textures[2] = vTex;
+    tiles[f].push_back( tile );
+
+    addVertex( f, left, bottom, z, 0.0f, 0.0f, s, t, alpha );
+    addVertex( f, left, top, z, 0.0f, t, s, t, alpha );
+    addVertex( f, right, top, z, s, t, s, t, alpha );
+    addVertex( f, right, bottom, z, s, 0.0f, s, t, alpha );
+}
+
+void TileRenderer::flush()
+{
+    unsigned int firstVertex[NUM_FORMATS];
+    for ( int f = 0; f < NUM_FORMATS; f++ )
+    {
+        firstVertex[f] = vertices.size();
+        vertices.insert( vertices.end(), formatVertices[f].begin(),
+                            formatVertices[f].end() );
+        formatVertices[f].clear();
+    }
+
+    if ( vertices.empty() )
+        return;
+
+    if ( !vboChecked )
+    {
+        if ( GLEW_ARB_vertex_buffer_object )
+            glGenBuffersARB( 1, &vbo );
+        vboChecked = true;
+    }
+
+    const GLubyte* base;
+    if ( vbo != 0 )
+    {
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, vbo );
+        glBufferDataARB( GL_ARRAY_BUFFER_ARB,
+                            vertices.size() * sizeof( Vertex ), &vertices[0],
+                            GL_STREAM_DRAW_ARB );
+        base = NULL;
+    }
+    else
+    {
+        base = (const GLubyte*)&vertices[0];
+    }
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+    glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, x ) );
+    glColorPointer( 4, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, r ) );
+    glClientActiveTexture( GL_TEXTURE1 );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, os ) );
+    glClientActiveTexture( GL_TEXTURE0 );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ),
+                        base + offsetof( Vertex, s ) );
+
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    glEnable( GL_TEXTURE_2D );
+
+    for ( int f = 0; f < NUM_FORMATS; f++ )
+    {
+        if ( tiles[f].empty() )
+            continue;
+
+        GLuint program = getProgram( (Format)f );
+        if ( program != 0 )
+            glUseProgram( program );
+
+        for ( unsigned int i = 0; i < tiles[f].size(); i++ )
+        {
+            const Tile& tile = tiles[f][i];
+            if ( f == FORMAT_YUV420_PLANAR )
+            {
+                glActiveTexture( GL_TEXTURE1 );
+                glBindTexture( GL_TEXTURE_2D, tile.textures[1] );
+                glActiveTexture( GL_TEXTURE2 );
+                glBindTexture( GL_TEXTURE_2D, tile.textures[2] );
+                glActiveTexture( GL_TEXTURE0 );
+            }
+            glBindTexture( GL_TEXTURE_2D, tile.textures[0] );
+            glDrawArrays( GL_QUADS, firstVertex[f] + i * 4, 4 );
+        }
+
+        if ( program != 0 )
+            glUseProgram( 0 );
+        tiles[f].clear();
+    }
+
+    glDisable( GL_TEXTURE_2D );
+    glDisable( GL_BLEND );
+
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glDisableClientState( GL_COLOR_ARRAY );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glClientActiveTexture( GL_TEXTURE1 );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glClientActiveTexture( GL_TEXTURE0 );
+    if ( vbo != 0 )
+        glBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 );
+
+    vertices.clear();
+}
+
+GLuint TileRenderer::getProgram( Format f )
+{
+    GLUtil* glUtil = GLUtil::getInstance();
+    switch ( f )
+    {
+    case FORMAT_YUV420:
+        return glUtil->getYUV420BatchProgram();
+    case FORMAT_YUV420_PLANAR:
+        return glUtil->getYUV420PlanarBatchProgram();
+    default:
+        return 0;
+    }
+}
+
+void TileRenderer::addVertex( Format f, float x, float y, float z, float s,
+                                float t, float os, float ot, float alpha )
+{
+    Vertex v;
+    v.x = x; v.y = y; v.z = z;
+    v.s = s; v.t = t;
+    v.os = os; v.ot = ot;
+    v.r = 1.0f; v.g = 1.0f; v.b = 1.0f; v.a = alpha;
+    formatVertices[f].push_back( v );
+}
@@ -26,6 +26,7 @@
 #include "Timers.h"
 #include "SessionTreeControl.h"
 #include "GLCanvas.h"
+#include "VideoInfoDialog.h"
 #include "gravUtil.h"
 
 RenderTimer::RenderTimer( GLCanvas* c, int i ) :
@@ -89,3 +90,14 @@ bool RotateTimer::Start( int milliseconds, bool oneShot )
     Notify();
     return wxTimer::Start( milliseconds, oneShot );
 }
+
+VideoInfoTimer::VideoInfoTimer( VideoInfoDialog* d ) :
+    dialog( d )
+{
+
+}
+
+void VideoInfoTimer::Notify()
+{
+    dialog->updateStats();
+}
@@ -0,0 +1,246 @@
+/*
+ * @file TitleTexture.cpp
+ *
+ * Implementation of the TitleTexture class. See TitleTexture.h for details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TitleTexture.h"
+#include "gravUtil.h"
+
+#include <algorithm>
+#include <cmath>
+
+// empty pixels around the text, so filtering doesn't pull in the edge
+static const int padding = 2;
+
+GLuint TitleTexture::fbo = 0;
+bool TitleTexture::useEXT = false;
+
+TitleTexture::TitleTexture()
+{
+    font = NULL;
+    scale = 0.0f;
+    texid = 0;
+    texWidth = 0; texHeight = 0;
+    pixelWidth = 0; pixelHeight = 0;
+    left = 0.0f; bottom = 0.0f; right = 0.0f; top = 0.0f;
+}
+
+TitleTexture::~TitleTexture()
+{
+    if ( texid != 0 )
+        glDeleteTextures( 1, &texid );
+}
+
+bool TitleTexture::isAvailable()
+{
+    return GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object ||
+            GLEW_EXT_framebuffer_object;
+}
+
+bool TitleTexture::update( FTFont* f, const std::string& t, float s )
+{
+    if ( f == font && s == scale && t.compare( text ) == 0 )
+        return texid != 0 || text.empty();
+
+    font = f;
+    text = t;
+    scale = s;
+
+    if ( text.empty() )
+        return true;
+
+    if ( !render() )
+    {
+        // make sure the stale text doesn't get drawn
+        if ( texid != 0 )
+            glDeleteTextures( 1, &texid );
+        texid = 0;
+        return false;
+    }
+    return true;
+}
+
+void TitleTexture::draw()
+{
+    if ( texid == 0 )
+        return;
+
+    float s = (float)pixelWidth / (float)texWidth;
+    float t = (float)pixelHeight / (float)texHeight;
+
+    glEnable( GL_TEXTURE_2D );
+    glBindTexture( GL_TEXTURE_2D, texid );
+
+    glBegin( GL_QUADS );
+
+    glTexCoord2f( 0.0f, 0.0f );
+    glVertex3f( left, bottom, 0.0f );
+
+    glTexCoord2f( 0.0f, t );
+    glVertex3f( left, top, 0.0f );
+
+    glTexCoord2f( s, t );
+    glVertex3f( right, top, 0.0f );
+
+    glTexCoord2f( s, 0.0f );
+    glVertex3f( right, bottom, 0.0f );
+
+    glEnd();
+
+    glDisable( GL_TEXTURE_2D );
+}
+
+bool TitleTexture::render()
+{
+    GLUtil* glUtil = GLUtil::getInstance();
+
+    FTBBox box = font->BBox( text.c_str() );
+    float lowerX = box.Lower().Xf();
+    float lowerY = box.Lower().Yf();
+    float textWidth = box.Upper().Xf() - lowerX;
+    float textHeight = box.Upper().Yf() - lowerY;
+
+    // very long titles at a large scale could be too big for a texture, so
+    // drop the scale for those
+    GLint maxSize;
+    glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize );
+    float renderScale = scale;
+    float largest = std::max( textWidth, textHeight ) * renderScale +
+                        padding * 2;
+    if ( largest > maxSize )
+        renderScale *= ( maxSize - padding * 2 ) / ( largest - padding * 2 );
+
+    pixelWidth = (int)ceilf( textWidth * renderScale ) + padding * 2;
+    pixelHeight = (int)ceilf( textHeight * renderScale ) + padding * 2;
+    left = lowerX - padding / renderScale;
+    bottom = lowerY - padding / renderScale;
+    right = left + pixelWidth / renderScale;
+    top = bottom + pixelHeight / renderScale;
+
+    int newWidth = pixelWidth;
+    int newHeight = pixelHeight;
+    if ( !glUtil->areNPOTTexturesAvailable() )
+    {
+        newWidth = glUtil->pow2( pixelWidth );
+        newHeight = glUtil->pow2( pixelHeight );
+    }
+
+    bool mipmaps = glUtil->areMipmapsAvailable();
+    if ( texid == 0 || newWidth != texWidth || newHeight != texHeight )
+    {
+        if ( texid == 0 )
+            glGenTextures( 1, &texid );
+        texWidth = newWidth;
+        texHeight = newHeight;
+
+        glBindTexture( GL_TEXTURE_2D, texid );
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, texWidth, texHeight, 0,
+                        GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+        // titles shrink a lot when zoomed out or in a big grid
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                            mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    }
+
+    // the headless version renders into its own FBO, so put back whatever
+    // was there rather than assuming the window
+    GLint oldFBO = 0;
+    if ( fbo == 0 )
+        useEXT = !( GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object );
+    if ( useEXT )
+    {
+        glGetIntegerv( GL_FRAMEBUFFER_BINDING_EXT, &oldFBO );
+        if ( fbo == 0 )
+            glGenFramebuffersEXT( 1, &fbo );
+        glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, fbo );
+        glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT,
+                                    GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D,
+                                    texid, 0 );
+    }
+    else
+    {
+        glGetIntegerv( GL_FRAMEBUFFER_BINDING, &oldFBO );
+        if ( fbo == 0 )
+            glGenFramebuffers( 1, &fbo );
+        glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_2D, texid, 0 );
+    }
+
+    GLenum status = useEXT ?
+            glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT ) :
+            glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    bool complete = status == GL_FRAMEBUFFER_COMPLETE;
+
+    if ( complete )
+    {
+        glPushAttrib( GL_VIEWPORT_BIT | GL_COLOR_BUFFER_BIT |
+                        GL_ENABLE_BIT | GL_CURRENT_BIT );
+        glViewport( 0, 0, pixelWidth, pixelHeight );
+
+        glMatrixMode( GL_PROJECTION );
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho( 0.0, pixelWidth, 0.0, pixelHeight, -1.0, 1.0 );
+        glMatrixMode( GL_MODELVIEW );
+        glPushMatrix();
+        glLoadIdentity();
+        glTranslatef( padding - lowerX * renderScale,
+                        padding - lowerY * renderScale, 0.0f );
+        glScalef( renderScale, renderScale, 1.0f );
+
+        // white everywhere, with the glyphs composited into the alpha
+        glClearColor( 1.0f, 1.0f, 1.0f, 0.0f );
+        glClear( GL_COLOR_BUFFER_BIT );
+        glDisable( GL_DEPTH_TEST );
+        glEnable( GL_BLEND );
+        glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+        glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
+        font->Render( text.c_str() );
+
+        glPopMatrix();
+        glMatrixMode( GL_PROJECTION );
+        glPopMatrix();
+        glMatrixMode( GL_MODELVIEW );
+        glPopAttrib();
+    }
+    else
+    {
+        gravUtil::logWarning( "TitleTexture::render: framebuffer incomplete "
+                "(0x%x), rendering titles directly\n", status );
+    }
+
+    if ( useEXT )
+        glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, oldFBO );
+    else
+        glBindFramebuffer( GL_FRAMEBUFFER, oldFBO );
+
+    if ( complete && mipmaps )
+    {
+        glBindTexture( GL_TEXTURE_2D, texid );
+        glUtil->generateMipmaps();
+    }
+
+    return complete;
+}
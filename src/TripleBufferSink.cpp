@@ -0,0 +1,176 @@
+/*
+ * @file TripleBufferSink.cpp
+ *
+ * Implementation of the TripleBufferSink class. See TripleBufferSink.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TripleBufferSink.h"
+
+#include <cstring>
+
+TripleBufferSink::TripleBufferSink( VPMVideoFormat f )
+    : VPMVideoBufferSink( f ), format( f )
+{
+    for ( int i = 0; i < 3; i++ )
+    {
+        slots[i].data = NULL;
+        slots[i].size = 0;
+        slots[i].width = 0;
+        slots[i].height = 0;
+    }
+    writeSlot = 0;
+    middleSlot = 1;
+    readSlot = 2;
+
+    frameCallback = NULL;
+    frameCallbackData = NULL;
+
+    pushedCount = 0;
+    droppedCount = 0;
+
+    addNewFrameCallback( &TripleBufferSink::baseFrameCallback, (void*)this );
+}
+
+TripleBufferSink::~TripleBufferSink()
+{
+    for ( int i = 0; i < 3; i++ )
+        delete[] slots[i].data;
+}
+
+void TripleBufferSink::setFrameCallback(
+        void (*callback)( VPMVideoSink*, int, void* ), void* userData )
+{
+    frameCallbackData = userData;
+    frameCallback = callback;
+}
+
+void TripleBufferSink::baseFrameCallback( VPMVideoSink* sink, int bufferIdx,
+                                            void* userData )
+{
+    TripleBufferSink* tbs = (TripleBufferSink*)userData;
+    if ( tbs != NULL )
+        tbs->pushFrame( bufferIdx );
+}
+
+void TripleBufferSink::pushFrame( int bufferIdx )
+{
+    lockImage();
+    uint32_t w = getImageWidth();
+    uint32_t h = getImageHeight();
+    uint8_t* dest = getWriteBuffer( w, h );
+    unsigned int size = getSizeFor( w, h );
+    if ( size > 0 )
+        memcpy( dest, getImageData(), size );
+    unlockImage();
+
+    publishFrame( bufferIdx );
+}
+
+uint8_t* TripleBufferSink::getWriteBuffer( uint32_t w, uint32_t h )
+{
+    FrameSlot& slot = slots[ writeSlot ];
+
+    unsigned int size = getSizeFor( w, h );
+    if ( size > slot.size )
+    {
+        delete[] slot.data;
+        slot.data = new uint8_t[ size ];
+        slot.size = size;
+    }
+    slot.width = w;
+    slot.height = h;
+
+    return slot.data;
+}
+
+void TripleBufferSink::publishFrame( int bufferIdx )
+{
+    // make sure the frame is fully written before it's published, then swap
+    // it in as the middle slot, taking whatever was there as the next place
+    // to write
+    __sync_synchronize();
+    int old = __sync_lock_test_and_set( &middleSlot,
+                                        writeSlot | newFrameFlag );
+    writeSlot = old & ~newFrameFlag;
+
+    pushedCount++;
+    // reader never got to the frame that was in the middle
+    if ( old & newFrameFlag )
+        droppedCount++;
+
+    if ( frameCallback != NULL )
+        frameCallback( this, bufferIdx, frameCallbackData );
+}
+
+bool TripleBufferSink::takeNewestFrame()
+{
+    if ( !( middleSlot & newFrameFlag ) )
+        return false;
+
+    int old = __sync_lock_test_and_set( &middleSlot, readSlot );
+    __sync_synchronize();
+    readSlot = old & ~newFrameFlag;
+    return true;
+}
+
+bool TripleBufferSink::hasNewFrame()
+{
+    return ( middleSlot & newFrameFlag ) != 0;
+}
+
+uint8_t* TripleBufferSink::getFrameData()
+{
+    return slots[ readSlot ].data;
+}
+
+uint32_t TripleBufferSink::getFrameWidth()
+{
+    return slots[ readSlot ].width;
+}
+
+uint32_t TripleBufferSink::getFrameHeight()
+{
+    return slots[ readSlot ].height;
+}
+
+VPMVideoFormat TripleBufferSink::getFrameFormat()
+{
+    return format;
+}
+
+unsigned long TripleBufferSink::getPushedCount()
+{
+    return pushedCount;
+}
+
+unsigned long TripleBufferSink::getDroppedCount()
+{
+    return droppedCount;
+}
+
+unsigned int TripleBufferSink::getSizeFor( uint32_t w, uint32_t h )
+{
+    if ( format == VIDEO_FORMAT_YUV420 )
+        return w * h * 3 / 2;
+    else
+        return w * h * 3;
+}
@@ -0,0 +1,183 @@
+/*
+ * @file UploadScheduler.cpp
+ *
+ * Implementation of the UploadScheduler class. See UploadScheduler.h for
+ * details.
+ *
+ * @author Andrew Ford
+ * Copyright (C) 2011 Rochester Institute of Technology
+ *
+ * This file is part of grav.
+ *
+ * grav is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * grav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with grav.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "UploadScheduler.h"
+#include "VideoSource.h"
+#include "AudioManager.h"
+#include "RectangleBase.h"
+#include "gravUtil.h"
+
+#include <algorithm>
+
+UploadScheduler::UploadScheduler()
+{
+    // a couple of HD frames, or a lot of small ones
+    budget = 8 * 1024 * 1024;
+    maxStaleness = 1.0f;
+
+    statsTime = gravUtil::getTime();
+    allowedCount = 0;
+    deferredCount = 0;
+    forcedCount = 0;
+}
+
+void UploadScheduler::setBudget( unsigned long b )
+{
+    budget = b;
+}
+
+unsigned long UploadScheduler::getBudget()
+{
+    return budget;
+}
+
+void UploadScheduler::schedule( std::vector<VideoSource*>* sources,
+                                RectangleBase screen, AudioManager* audio )
+{
+    float screenL = screen.getX() - screen.getWidth() / 2.0f;
+    float screenR = screen.getX() + screen.getWidth() / 2.0f;
+    float screenU = screen.getY() + screen.getHeight() / 2.0f;
+    float screenD = screen.getY() - screen.getHeight() / 2.0f;
+
+    double now = gravUtil::getTime();
+    candidates.clear();
+
+    for ( unsigned int i = 0; i < sources->size(); i++ )
+    {
+        VideoSource* source = (*sources)[i];
+        // anything not in the running is free to do whatever it would anyway
+        source->setUploadAllowed( true );
+
+        if ( budget == 0 || !source->hasPendingFrame() ||
+                !source->getRendering() || source->isAutoPaused() )
+            continue;
+
+        float l = std::max( source->getX() - source->getWidth() / 2.0f,
+                            screenL );
+        float r = std::min( source->getX() + source->getWidth() / 2.0f,
+                            screenR );
+        float u = std::min( source->getY() + source->getHeight() / 2.0f,
+                            screenU );
+        float d = std::max( source->getY() - source->getHeight() / 2.0f,
+                            screenD );
+        // off the screen or covered up, so nothing would see the new frame -
+        // it'll be stale & go near the top once it's back in view
+        if ( r <= l || u <= d || !source->isVisible() )
+        {
+            source->setUploadAllowed( false );
+            deferredCount++;
+            continue;
+        }
+
+        Candidate c;
+        c.source = source;
+        c.bytes = source->getUploadSize();
+        double last = source->getLastUploadTime();
+        // never updated means it's still gray, so get something up asap
+        double staleness = last > 0.0 ? now - last : maxStaleness;
+        c.overdue = staleness >= maxStaleness;
+        c.priority = getPriority( source, audio, ( r - l ) * ( u - d ),
+                                    staleness );
+        candidates.push_back( c );
+    }
+
+    std::sort( candidates.begin(), candidates.end(), &compareCandidates );
+
+    unsigned long used = 0;
+    for ( unsigned int i = 0; i < candidates.size(); i++ )
+    {
+        Candidate& c = candidates[i];
+        // the top one always goes, so a single frame bigger than the budget
+        // doesn't block everything
+        if ( i == 0 || used + c.bytes <= budget )
+        {
+            used += c.bytes;
+            allowedCount++;
+        }
+        else if ( c.overdue )
+        {
+            used += c.bytes;
+            forcedCount++;
+        }
+        else
+        {
+            c.source->setUploadAllowed( false );
+            deferredCount++;
+        }
+    }
+
+    if ( now - statsTime > 10.0 )
+    {
+        if ( deferredCount > 0 || forcedCount > 0 )
+        {
+            gravUtil::logVerbose( "UploadScheduler::schedule: in the last "
+                    "%.0fs, %lu uploads allowed, %lu deferred, %lu forced "
+                    "over budget (%lu bytes per frame)\n", now - statsTime,
+                    allowedCount, deferredCount, forcedCount, budget );
+        }
+        statsTime = now;
+        allowedCount = 0;
+        deferredCount = 0;
+        forcedCount = 0;
+    }
+}
+
+bool UploadScheduler::compareCandidates( const Candidate& a,
+                                            const Candidate& b )
+{
+    return a.priority > b.priority;
+}
+
+float UploadScheduler::getPriority( VideoSource* source, AudioManager* audio,
+                                    float visibleArea, double staleness )
+{
+    // all the videos are on the same plane, so world size is proportional to
+    // on-screen size
+    float priority = visibleArea;
+
+    if ( source->isSelected() )
+        priority *= 4.0f;
+    // unselectable videos are the translucent runway members
+    if ( !source->isSelectable() )
+        priority *= 0.5f;
+
+    // same matching & threshold as the audio focus in gravManager, but with
+    // the instantaneous level so the focus averages aren't reset
+    if ( audio != NULL && audio->getSourceCount() > 0 )
+    {
+        float level = 0.0f;
+        if ( source->getSiteID().compare( "" ) != 0 )
+            level = audio->getLevel( source->getSiteID(), false, false );
+        else if ( source->getAltName().compare( "" ) != 0 )
+            level = audio->getLevel( source->getAltName(), false, true );
+        if ( level > 0.01f )
+            priority *= 3.0f;
+    }
+
+    // the longer it's been waiting, the more it moves up
+    priority *= 1.0f + (float)staleness * 4.0f;
+
+    return priority;
+}
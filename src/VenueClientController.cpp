@@ -98,6 +98,11 @@ VenueClientController::~VenueClientController()
     removeAll();
 }
 
+bool VenueClientController::canBatchBorder()
+{
+    return false;
+}
+
 void VenueClientController::draw()
 {
     animateValues();
@@ -26,13 +26,26 @@
 #include "VideoInfoDialog.h"
 #include "VideoSource.h"
 #include "Group.h"
+#include "gravManager.h"
+#include "Timers.h"
 
 #include <wx/stattext.h>
 #include <wx/sizer.h>
 
-VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o )
-    : wxDialog( parent, wxID_ANY, _("Video Info") ), obj( o )
+#include <algorithm>
+#include <cstdio>
+
+BEGIN_EVENT_TABLE(VideoInfoDialog, wxDialog)
+EVT_CLOSE(VideoInfoDialog::OnCloseWindow)
+END_EVENT_TABLE()
+
+VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o,
+                                    gravManager* g )
+    : wxDialog( parent, wxID_ANY, _("Video Info") ), obj( o ), grav( g )
 {
+    statsText = NULL;
+    timer = NULL;
+
     SetSize( wxSize( 250, 150 ) );
     wxStaticText* labelText = new wxStaticText( this, wxID_ANY, _("") );
     wxStaticText* infoText = new wxStaticText( this, wxID_ANY, _("") );
@@ -40,7 +53,7 @@ VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o )
 
     labelTextStd += "Name:\n";
     infoTextStd += obj->getName() + "\n";
-    VideoSource* video = dynamic_cast<VideoSource*>( obj );
+    video = dynamic_cast<VideoSource*>( obj );
     if ( video )
     {
         labelTextStd += "RTP name:\n";
@@ -77,6 +90,100 @@ VideoInfoDialog::VideoInfoDialog( wxWindow* parent, RectangleBase* o )
     textSizer->Add( labelText, wxSizerFlags(0).Align(0).Border( wxALL, 10 ) );
     textSizer->Add( infoText, wxSizerFlags(0).Align(0).Border( wxALL, 10 ) );
 
-    SetSizer( textSizer );
-    textSizer->SetSizeHints( this );
+    wxBoxSizer* mainSizer = new wxBoxSizer( wxVERTICAL );
+    mainSizer->Add( textSizer );
+
+    // live frame stats for videos
+    if ( video )
+    {
+        wxStaticText* statsLabelText = new wxStaticText( this, wxID_ANY,
+                _("Decoded:\nDropped:\nUploaded:\nPresented:\n"
+                  "Frame jitter:\nLast frame:\nProcessing queue:\n"
+                  "Processing latency:\nMipmaps:") );
+        // make room for the widest the values are likely to get, since
+        // they'll be changing
+        statsText = new wxStaticText( this, wxID_ANY,
+                _("0000000 (000.0/sec)\n\n\n\n\n\n\n\n") );
+
+        wxBoxSizer* statsSizer = new wxBoxSizer( wxHORIZONTAL );
+        statsSizer->Add( statsLabelText,
+                            wxSizerFlags(0).Align(0).Border( wxALL, 10 ) );
+        statsSizer->Add( statsText,
+                            wxSizerFlags(0).Align(0).Border( wxALL, 10 ) );
+        mainSizer->Add( statsSizer );
+    }
+
+    SetSizer( mainSizer );
+    mainSizer->SetSizeHints( this );
+
+    if ( video )
+    {
+        updateStats();
+        timer = new VideoInfoTimer( this );
+        timer->Start( 500 );
+    }
+}
+
+VideoInfoDialog::~VideoInfoDialog()
+{
+    if ( timer != NULL )
+    {
+        timer->Stop();
+        delete timer;
+    }
+}
+
+void VideoInfoDialog::updateStats()
+{
+    if ( video == NULL || statsText == NULL )
+        return;
+
+    // make sure the video still exists before touching it
+    VideoStats stats;
+    bool found = false;
+    grav->lockSources();
+    std::vector<VideoSource*>* sources = grav->getSources();
+    if ( std::find( sources->begin(), sources->end(), video ) !=
+            sources->end() )
+    {
+        stats = video->getStats();
+        found = true;
+    }
+    grav->unlockSources();
+
+    if ( !found )
+    {
+        video = NULL;
+        timer->Stop();
+        statsText->SetLabel( _("(video removed)") );
+        return;
+    }
+
+    char text[512];
+    char age[32];
+    char mipmaps[32];
+    if ( stats.lastFrameAge < 0.0f )
+        sprintf( age, "none yet" );
+    else
+        sprintf( age, "%.0f ms ago", stats.lastFrameAge );
+    if ( stats.mipmapped )
+        sprintf( mipmaps, "on (%.2f ms each)", stats.mipmapTime );
+    else
+        sprintf( mipmaps, "off" );
+    sprintf( text, "%lu (%.1f/sec)\n%lu (%.1f/sec)\n%lu (%.1f/sec)\n"
+            "%lu (%.1f/sec)\n%.1f ms\n%s\n%i\n%.1f ms\n%s",
+            stats.decoded, stats.decodedRate,
+            stats.dropped, stats.droppedRate,
+            stats.uploaded, stats.uploadedRate,
+            stats.presented, stats.presentedRate,
+            stats.jitter, age, stats.queueDepth, stats.pipelineLatency,
+            mipmaps );
+    statsText->SetLabel( wxString( text, wxConvUTF8 ) );
+}
+
+void VideoInfoDialog::OnCloseWindow( wxCloseEvent& evt )
+{
+    // modeless, so nothing else will clean this up - and the timer shouldn't
+    // keep going while hidden
+    Destroy();
 }
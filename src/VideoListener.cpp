@@ -30,9 +30,11 @@
 #include "TreeControl.h"
 #include "GLUtil.h"
 #include "gravUtil.h"
+#include "TripleBufferSink.h"
 
 #include <VPMedia/video/VPMVideoDecoder.h>
 #include <VPMedia/video/VPMVideoBufferSink.h>
+#include <VPMedia/thread_helper.h>
 
 #include <wx/wx.h>
 
@@ -46,6 +48,16 @@ VideoListener::VideoListener( gravManager* g ) :
 
     sourceCount = 0;
     pixelCount = 0;
+
+    listenerMutex = mutex_create();
+
+    pipeline = NULL;
+    cpuConversion = false;
+}
+
+VideoListener::~VideoListener()
+{
+    mutex_free( listenerMutex );
 }
 
 void VideoListener::vpmsession_source_created( VPMSession &session,
@@ -56,21 +68,10 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
 
     if ( d )
     {
-        sourceCount++;
-        VPMVideoFormat format = d->getOutputFormat();
-        VPMVideoBufferSink *sink;
-
-        // if we have shaders available, set the output format to YUV420P so
-        // the videosource class will apply the YUV420P -> RGB conversion shader
-        gravUtil::logVerbose( "VideoListener::vpmsession_source_created: "
-                "creating source, have shaders? %i format? %i (yuv420p: %i)\n",
-                GLUtil::getInstance()->areShadersAvailable(), format,
-                VIDEO_FORMAT_YUV420 );
-        if ( GLUtil::getInstance()->areShadersAvailable() &&
-                format == VIDEO_FORMAT_YUV420 )
-            sink = new VPMVideoBufferSink( format );
-        else
-            sink = new VPMVideoBufferSink( VIDEO_FORMAT_RGB24 );
+        bool convert;
+        VPMVideoFormat format = getSinkFormat( d->getOutputFormat(),
+                                                &convert );
+        TripleBufferSink *sink = new TripleBufferSink( format );
 
         // note that the buffer sink will be deleted when the decoder for the
         // source is (inside VPMedia), so that's why it isn't deleted here or in
@@ -85,54 +86,107 @@ void VideoListener::vpmsession_source_created( VPMSession &session,
 
         d->connectVideoProcessor(sink);
 
-        VideoSource* source = new VideoSource( &session, this, ssrc, sink, x,
-													y );
-        grav->addNewSource( source );
+        addSource( &session, ssrc, sink, convert );
 
         // new frame callback mostly just used for testing
         //sink->addNewFrameCallback( &newFrameCallbackTest, (void*)timer );
+    }
+}
 
-        // do some basic grid positions
-        // TODO make this better, use layoutmanager somehow?
-        x += 8.8f;
-        if ( x > 15.0f )
-        {
-            x = -7.5f;
-            y -= 5.9f;
-        }
-        // reset to top
-        if ( y < -11.0f )
-        {
-            x = initialX + ( 0.5f * ( sourceCount / 9 ) );
-            y = initialY - ( 0.5f * ( sourceCount / 9 ) );
-        }
+VPMVideoFormat VideoListener::getSinkFormat( VPMVideoFormat decoderFormat,
+                                                bool* convert )
+{
+    bool shaders = GLUtil::getInstance()->areShadersAvailable();
+    *convert = false;
+
+    // if we have shaders available, set the output format to YUV420P so
+    // the videosource class will apply the YUV420P -> RGB conversion
+    // shader. otherwise keep YUV420P anyway if we're doing the conversion
+    // ourselves, off the decoding thread
+    gravUtil::logVerbose( "VideoListener::getSinkFormat: have shaders? %i "
+            "cpu conversion? %i format? %i (yuv420p: %i)\n", shaders,
+            cpuConversion, decoderFormat, VIDEO_FORMAT_YUV420 );
+    if ( ( shaders || cpuConversion ) && decoderFormat == VIDEO_FORMAT_YUV420 )
+    {
+        *convert = !shaders;
+        return decoderFormat;
     }
+    return VIDEO_FORMAT_RGB24;
+}
+
+VideoSource* VideoListener::addSource( VPMSession* session, uint32_t ssrc,
+                                        TripleBufferSink* sink, bool convert )
+{
+    // sessions on different threads can create sources at the same time,
+    // so the count & grid position need to be updated as one
+    mutex_lock( listenerMutex );
+    sourceCount++;
+    VideoSource* source = new VideoSource( session, this, ssrc, sink, x, y );
+    source->setCPUConversion( convert );
+    source->setPipeline( pipeline );
+    grav->addNewSource( source );
+
+    // lets the source process new frames, either on this (the decoding)
+    // thread or by passing them to the pipeline
+    sink->setFrameCallback( &VideoSource::newFrameCallback, (void*)source );
+
+    // do some basic grid positions
+    // TODO make this better, use layoutmanager somehow?
+    x += 8.8f;
+    if ( x > 15.0f )
+    {
+        x = -7.5f;
+        y -= 5.9f;
+    }
+    // reset to top
+    if ( y < -11.0f )
+    {
+        x = initialX + ( 0.5f * ( sourceCount / 9 ) );
+        y = initialY - ( 0.5f * ( sourceCount / 9 ) );
+    }
+    mutex_unlock( listenerMutex );
+
+    return source;
 }
 
 void VideoListener::vpmsession_source_deleted( VPMSession &session,
         uint32_t ssrc, const char *reason)
 {
     gravUtil::logVerbose( "VideoListener::deleting ssrc 0x%08x\n", ssrc );
-    std::vector<VideoSource*>::iterator si;
-    for ( si = grav->getSources()->begin();
-            si != grav->getSources()->end(); ++si )
+    // sources only get added/removed through here & source_created, so holding
+    // this keeps the lookup valid against other session threads
+    mutex_lock( listenerMutex );
+    VideoSource* source = grav->findSource( &session, ssrc );
+    if ( source != NULL )
     {
-        if ( &session == (*si)->getSession() && (*si)->getssrc() == ssrc )
-        {
-            gravUtil::logVerbose( "VideoListener::found ssrc as source"
-                    " 0x%08x\n", (*si) );
-            sourceCount--;
-            updatePixelCount( -( (*si)->getVideoWidth() *
-                                 (*si)->getVideoHeight() ) );
-            grav->deleteSource( si );
-            return;
-        }
+        gravUtil::logVerbose( "VideoListener::found ssrc as source"
+                " 0x%08x\n", source );
+        removeSourceLocked( source );
     }
+    mutex_unlock( listenerMutex );
     // seems to get a lot of "sources deleted but not in video sources list" on
     // exit - may be that view-only clients are listed in the session. need to
     // test more, but not that much of an issue
 }
 
+void VideoListener::removeSource( VideoSource* source )
+{
+    mutex_lock( listenerMutex );
+    removeSourceLocked( source );
+    mutex_unlock( listenerMutex );
+}
+
+void VideoListener::removeSourceLocked( VideoSource* source )
+{
+    sourceCount--;
+    updatePixelCount( -( source->getVideoWidth() *
+                         source->getVideoHeight() ) );
+    // the sink goes away with the decoder once this returns, so make
+    // sure no pipeline worker is still using it
+    source->setPipeline( NULL );
+    grav->deleteSource( source );
+}
+
 void VideoListener::vpmsession_source_description( VPMSession &session,
         uint32_t ssrc )
 {
@@ -152,56 +206,66 @@ void VideoListener::vpmsession_source_app( VPMSession &session,
         // vic sends 4 nulls at the end of the rtcp_app string for some
         // reason, so chop those off
         dataS = std::string( dataS, 0, 32 );
-        std::vector<VideoSource*>::iterator i = grav->getSources()->begin();
 
-        // sometimes, if groups are enabled by default, we can get RTCP APP
-        // before we get any sources added, resulting in a crash when we try
-        // and dereference the sources pointer - so skip this if we don't have
-        // any sources yet
-        if ( grav->getSources()->size() == 0 )
+        // we can get RTCP APP before the source is added (or for non-video
+        // sources), so skip it if it's not there
+        VideoSource* source = grav->findSource( &session, ssrc );
+        if ( source == NULL )
         {
             grav->unlockSources();
             return;
         }
 
-        while ( (*i)->getssrc() != ssrc )
-        {
-            ++i;
-            if ( i == grav->getSources()->end() )
-            {
-                grav->unlockSources();
-                return;
-            }
-        }
-
-        if ( !(*i)->isGrouped() )
-        {
-            Group* g;
-            std::map<std::string,Group*>::iterator mapi =
-                                     grav->getSiteIDGroups()->find(dataS);
-
-            if ( mapi == grav->getSiteIDGroups()->end() )
-                g = grav->createSiteIDGroup( dataS );
-            else
-                g = mapi->second;
-
-            (*i)->setSiteID( dataS );
-            g->add( *i );
-
-            // adding & removing will replace the object under its group
-            if ( grav->getTree() )
-            {
-                grav->getTree()->removeObject( (*i) );
-                grav->getTree()->addObject( (*i) );
-
-                grav->getTree()->updateObjectName( g );
-            }
-        }
+        setSiteIDLocked( source, dataS );
 
         grav->unlockSources();
     }
 }
 
+void VideoListener::setSiteID( VideoSource* source, std::string siteID )
+{
+    grav->lockSources();
+    setSiteIDLocked( source, siteID );
+    grav->unlockSources();
+}
+
+void VideoListener::setSiteIDLocked( VideoSource* source, std::string siteID )
+{
+    if ( source->isGrouped() )
+        return;
+
+    Group* g;
+    std::map<std::string,Group*>::iterator mapi =
+                             grav->getSiteIDGroups()->find( siteID );
+
+    if ( mapi == grav->getSiteIDGroups()->end() )
+        g = grav->createSiteIDGroup( siteID );
+    else
+        g = mapi->second;
+
+    source->setSiteID( siteID );
+    g->add( source );
+
+    // adding & removing will replace the object under its group
+    if ( grav->getTree() )
+    {
+        grav->getTree()->removeObject( source );
+        grav->getTree()->addObject( source );
+
+        grav->getTree()->updateObjectName( g );
+    }
+}
+
+void VideoListener::setPipeline( FramePipeline* p )
+{
+    pipeline = p;
+}
+
+void VideoListener::setCPUConversion( bool c )
+{
+    cpuConversion = c;
+}
+
 void VideoListener::setTimer( wxStopWatch* t )
 {
     timer = t;
@@ -219,7 +283,9 @@ long VideoListener::getPixelCount()
 
 void VideoListener::updatePixelCount( long mod )
 {
-	pixelCount += mod;
+    // can be called from either the main thread or session threads - atomic
+    // rather than locked since callers may be holding the source lock
+    __sync_fetch_and_add( &pixelCount, mod );
 }
 
 /*static void newFrameCallbackTest( VPMVideoSink* sink, int buffer_idx,
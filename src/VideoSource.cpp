@@ -23,26 +23,95 @@
  */
 
 #include "VideoSource.h"
+#include "TripleBufferSink.h"
 #include "VideoListener.h"
+#include "FrameScaler.h"
+#include "FramePipeline.h"
+#include "TexturePool.h"
+#include "ColorConverter.h"
+#include "BatchRenderer.h"
+#include "TileRenderer.h"
+#include "SDFFont.h"
 #include "GLUtil.h"
 #include "gravUtil.h"
 #include <cmath>
+#include <algorithm>
 
 #include <VPMedia/video/VPMVideoDecoder.h>
 
 VideoSource::VideoSource( VPMSession* _session, VideoListener* l,
-							uint32_t _ssrc, VPMVideoBufferSink* vs,
+							uint32_t _ssrc, TripleBufferSink* vs,
 							float _x, float _y ) :
     RectangleBase( _x, _y ), session( _session ), listener( l ), ssrc( _ssrc ),
 		videoSink( vs )
 {
-    vwidth = videoSink->getImageWidth();
-    vheight = videoSink->getImageHeight();
+    vwidth = videoSink->getFrameWidth();
+    vheight = videoSink->getFrameHeight();
     aspect = (float)vwidth / (float)vheight;
+    fwidth = 0; fheight = 0;
     tex_width = 0; tex_height = 0;
     texid = 0;
     aspect = 1.33f;
     useAlpha = false;
+
+    planar = false;
+    chromaTexids[0] = 0; chromaTexids[1] = 0;
+    chromaWidth = 0; chromaHeight = 0;
+    texturePool = NULL;
+
+    targetWidth = 0; targetHeight = 0;
+    scaler = new FrameScaler();
+    scaleMutex = mutex_create();
+
+    cpuConvert = false;
+    for ( int i = 0; i < 3; i++ )
+    {
+        processedFrames[i].width = 0; processedFrames[i].height = 0;
+        processedFrames[i].sourceWidth = 0;
+        processedFrames[i].sourceHeight = 0;
+    }
+    processedWrite = 0; processedLatest = 1; processedRead = 2;
+    processedFrameNew = false;
+    processing = false;
+    drawReadingSink = false;
+
+    pipeline = NULL;
+
+    statsMutex = mutex_create();
+    processedDropped = 0;
+    uploadedCount = 0;
+    presentedCount = 0;
+    uploadedBytes = 0;
+    lastFrameTime = 0.0;
+    lastFrameInterval = 0.0;
+    frameJitter = 0.0f;
+    lastUploadTime = 0.0;
+    uploadAllowed = true;
+
+    mipmapRequested = false;
+    mipmapActive = false;
+    mipmapsDirty = false;
+    mipmapTime = 0.0;
+    mipmapCount = 0;
+    rateTime = gravUtil::getTime();
+    for ( int i = 0; i < 4; i++ )
+    {
+        rateCounts[i] = 0;
+        rates[i] = 0.0f;
+    }
+
+    userMuted = false;
+    autoPaused = false;
+    visible = true;
+    lastVisibleTime = gravUtil::getTime();
+    resumeTime = 0.0;
+    resumeSettleTime = 0.5f;
+
+    for ( int i = 0; i < numPBOs; i++ )
+        pbos[i] = 0;
+    pboIndex = 0;
+    pboPending = false;
+    usePBOs = GLUtil::getInstance()->arePBOsAvailable();
 }
 
 VideoSource::~VideoSource()
@@ -51,46 +120,130 @@ VideoSource::~VideoSource()
     // is (inside VPMedia), so that's why it isn't deleted here or in
     // videolistener
 
+    setPipeline( NULL );
+
     // gl destructors
-    glDeleteTextures( 1, &texid );
+    releaseTextures();
+    if ( usePBOs && pbos[0] != 0 )
+        glDeleteBuffersARB( numPBOs, pbos );
+
+    delete scaler;
+    mutex_free( scaleMutex );
+    mutex_free( statsMutex );
 }
 
 void VideoSource::draw()
 {
+    // if the border was batched, the X below goes in the same batch, which
+    // gets drawn after all the videos. RectangleBase::draw() clears this
+    BatchRenderer* overlay = batch;
+
     // to draw the border/text/common stuff, also calls animateValues
     RectangleBase::draw();
 
-    // set up our position
-    glPushMatrix();
-
-    glRotatef( xAngle, 1.0, 0.0, 0.0 );
-    glRotatef( yAngle, 0.0, 1.0, 0.0 );
-    glRotatef( zAngle, 0.0, 0.0, 1.0 );
-
-    glTranslatef(x,y,z);
-
-    //glDepthMask( GL_FALSE );
-    //glDepthRange (0.0, 0.9);
-    //glPolygonOffset( 0.2, 0.8 );
-
     float s = 1.0;
     float t = 1.0;
     // if the texture id hasn't been initialized yet, this must be the
     // first draw call
     init = (texid == 0);
 
-    // allocate the buffer if it's the first time or if it's been resized
-    if ( init || vwidth != videoSink->getImageWidth() ||
-         vheight != videoSink->getImageHeight() )
+    // hold the last good frame while the decoder settles after a resume
+    bool holdFrame = false;
+    if ( resumeTime > 0.0 )
     {
-        resizeBuffer();
+        if ( gravUtil::getTime() - resumeTime < resumeSettleTime )
+            holdFrame = true;
+        else
+            resumeTime = 0.0;
     }
 
-    s = (float)vwidth/(float)tex_width;
-    //if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
-    //    t = (float)(3*vheight/2)/(float)tex_height;
-    //else
-    t = (float)vheight/(float)tex_height;
+    // only the buffer indices & flags are shared with the frame processing
+    // thread - the lock is just held to swap them, never over a conversion
+    // or a texture push
+    mutex_lock( scaleMutex );
+
+    // take the latest converted or downscaled frame if it's allowed to go up
+    // now. a held-off frame stays new until we're allowed to push it, unless
+    // it's a different size (which would need a push anyway)
+    bool newProcessed = false;
+    if ( ( cpuConvert || targetWidth > 0 ) && processedFrameNew &&
+            enableRendering && !holdFrame && !autoPaused )
+    {
+        const ProcessedFrame& latest = processedFrames[ processedLatest ];
+        if ( uploadAllowed || latest.width != fwidth ||
+                latest.height != fheight )
+        {
+            std::swap( processedRead, processedLatest );
+            processedFrameNew = false;
+            newProcessed = true;
+        }
+    }
+    const ProcessedFrame& processedFrame = processedFrames[ processedRead ];
+
+    // push the converted or downscaled frame if there is one, the native
+    // frame otherwise. when converting or downscaling, processFrame() is what
+    // takes frames from the sink - if it's still busy with one after
+    // switching back to native, leave the sink alone until it's done
+    bool useProcessed = cpuConvert ||
+                        ( targetWidth > 0 && processedFrame.width > 0 );
+    bool readSink = !useProcessed && !processing;
+    drawReadingSink = readSink;
+
+    mutex_unlock( scaleMutex );
+
+    bool newFrame = false;
+    if ( readSink && enableRendering && !holdFrame && !autoPaused &&
+            uploadAllowed )
+        newFrame = videoSink->takeNewestFrame();
+
+    unsigned int videoWidth, videoHeight, frameWidth, frameHeight;
+    const GLubyte* frameData;
+    if ( useProcessed )
+    {
+        videoWidth = processedFrame.sourceWidth;
+        videoHeight = processedFrame.sourceHeight;
+        frameWidth = processedFrame.width;
+        frameHeight = processedFrame.height;
+        frameData = processedFrame.data.empty() ? NULL :
+                        &processedFrame.data[0];
+        newFrame = newProcessed;
+    }
+    else if ( readSink )
+    {
+        videoWidth = videoSink->getFrameWidth();
+        videoHeight = videoSink->getFrameHeight();
+        frameWidth = videoWidth;
+        frameHeight = videoHeight;
+        frameData = videoSink->getFrameData();
+    }
+    else
+    {
+        // keep what's there for now
+        videoWidth = vwidth;
+        videoHeight = vheight;
+        frameWidth = fwidth;
+        frameHeight = fheight;
+        frameData = NULL;
+    }
+
+    // allocate the buffer if it's the first time or if it's been resized.
+    // if the frame size changed (ie, switching to/from downscaled frames) the
+    // texture needs to be refilled even if there's no new frame
+    bool resized = false;
+    if ( init || vwidth != videoWidth || vheight != videoHeight ||
+         fwidth != frameWidth || fheight != frameHeight )
+    {
+        resizeBuffer( videoWidth, videoHeight, frameWidth, frameHeight );
+        resized = true;
+    }
+
+    // with exact-size textures (NPOT or planar) the video may be 0x0 before
+    // the first frame comes in, so avoid dividing by that
+    if ( tex_width > 0 && tex_height > 0 )
+    {
+        s = (float)fwidth/(float)tex_width;
+        t = (float)fheight/(float)tex_height;
+    }
 
     // X & Y distances from center to edge
     float Xdist = aspect*scaleX/2;
@@ -99,85 +252,169 @@ void VideoSource::draw()
     glBindTexture( GL_TEXTURE_2D, texid );
 
     glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glPixelStorei( GL_UNPACK_ROW_LENGTH, vwidth );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, fwidth );
+
+    // new frames copied to GL & new frames made it into the texture, for
+    // stats - resize re-pushes don't count
+    int uploads = 0;
+    int presents = 0;
 
     // only do this texture stuff if rendering is enabled
-    if ( enableRendering )
+    if ( holdFrame || autoPaused || frameData == NULL )
     {
-        videoSink->lockImage();
-        // only bother doing a texture push if there's a new frame
-        if ( videoSink->haveNewFrameAvailable() )
+        // nothing to push - any frame that comes in will be picked up once
+        // the hold is over
+    }
+    else if ( enableRendering && usePBOs )
+    {
+        // first push the frame that was copied in last time - since the
+        // source is a bound PBO this returns right away and the driver does
+        // the transfer asynchronously
+        if ( pboPending )
         {
-            if ( videoSink->getImageFormat() == VIDEO_FORMAT_RGB24 )
+            glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pbos[pboIndex] );
+            uploadFrame( NULL );
+            pboPending = false;
+            presents++;
+        }
+
+        if ( newFrame || resized )
+        {
+            pboIndex = ( pboIndex + 1 ) % numPBOs;
+            glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pbos[pboIndex] );
+            // orphan the old storage so mapping doesn't have to wait for a
+            // pending transfer out of this buffer to finish
+            glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, getFrameSize(), NULL,
+                                GL_STREAM_DRAW_ARB );
+            GLubyte* dest = (GLubyte*)glMapBufferARB(
+                                GL_PIXEL_UNPACK_BUFFER_ARB,
+                                GL_WRITE_ONLY_ARB );
+            if ( dest != NULL )
             {
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      0,
-                      vwidth,
-                      vheight,
-                      GL_RGB,
-                      GL_UNSIGNED_BYTE,
-                      videoSink->getImageData() );
+                memcpy( dest, frameData, getFrameSize() );
+                pboPending = glUnmapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB );
+                if ( newFrame )
+                    uploads++;
             }
-
-            // if we're doing yuv420, do the texture mapping for all 3 channels
-            // so the shader can properly work its magic
-            else if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
+            else
             {
-                // experimental single-push method
-                /*glTexSubImage2D( GL_TEXTURE_2D,
-                                 0,
-                                 0,
-                                 0,
-                                 vwidth,
-                                 3*vheight/2,
-                                 GL_LUMINANCE,
-                                 GL_UNSIGNED_BYTE,
-                                 videoSink->getImageData() );*/
-
-                // 3 pushes separate
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      0,
-                      vwidth,
-                      vheight,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      videoSink->getImageData() );
-
-                // now map the U & V to the bottom chunk of the image
-                // each is 1/4 of the size of the Y (half width, half height)
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, vwidth/2);
-
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      0,
-                      vheight,
-                      vwidth/2,
-                      vheight/2,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      (GLubyte*)videoSink->getImageData() + (vwidth*vheight) );
-
-                glTexSubImage2D( GL_TEXTURE_2D,
-                      0,
-                      vwidth/2,
-                      vheight,
-                      vwidth/2,
-                      vheight/2,
-                      GL_LUMINANCE,
-                      GL_UNSIGNED_BYTE,
-                      (GLubyte*)videoSink->getImageData() + 5*(vwidth*vheight)/4 );
+                gravUtil::logWarning( "VideoSource::draw: failed to map "
+                        "PBO, pushing frame directly\n" );
+                glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+                uploadFrame( frameData );
+                if ( newFrame )
+                {
+                    uploads++;
+                    presents++;
+                }
             }
         }
-        videoSink->unlockImage();
+
+        glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+    }
+    else if ( enableRendering )
+    {
+        // only bother doing a texture push if there's a new frame
+        if ( newFrame || resized )
+            uploadFrame( frameData );
+        if ( newFrame )
+        {
+            uploads++;
+            presents++;
+        }
     }
 
+    if ( readSink )
+    {
+        mutex_lock( scaleMutex );
+        drawReadingSink = false;
+        mutex_unlock( scaleMutex );
+    }
+
+    double now = gravUtil::getTime();
+    mutex_lock( statsMutex );
+    uploadedCount += uploads;
+    presentedCount += presents;
+    uploadedBytes += (uint64_t)uploads * getFrameSize();
+    if ( uploads > 0 )
+        lastUploadTime = now;
+    updateRates( now );
+    mutex_unlock( statsMutex );
+
+    if ( enableRendering )
+        updateMipmaps();
+
+    // with the borders batched, the video can go in with all the others of
+    // its format, unless there's no video yet & the waiting message has to
+    // go on top of it
+    TileRenderer::Format format;
+    if ( planar )
+        format = TileRenderer::FORMAT_YUV420_PLANAR;
+    else if ( GLUtil::getInstance()->areShadersAvailable() && !cpuConvert )
+        format = TileRenderer::FORMAT_YUV420;
+    else
+        format = TileRenderer::FORMAT_RGB;
+    TileRenderer* tiles = overlay != NULL ? overlay->getTileRenderer() : NULL;
+    bool batchTile = tiles != NULL && vwidth > 0 && vheight > 0 &&
+                        tiles->isFormatAvailable( format );
+
+    if ( batchTile )
+    {
+        tiles->addTile( format, x - Xdist, y - Ydist, x + Xdist, y + Ydist, z,
+                        s, t, useAlpha ? borderColor.A : 1.0f, texid,
+                        chromaTexids[0], chromaTexids[1] );
+    }
+    else
+        drawTexture( Xdist, Ydist, s, t, overlay == NULL );
+
+    // draw a basic X in the top-left corner for signifying that rendering is
+    // disabled, differentiating between muting and just having the texture
+    // push disabled via the color. when batched, this goes in the overlay
+    // along with the tile
+    if ( !enableRendering && overlay != NULL )
+    {
+        float dist = getWidth() * 0.1f;
+        overlay->addLine( x - Xdist, y + Ydist - dist, x - Xdist + dist,
+                            y + Ydist, z, secondaryColor );
+        overlay->addLine( x - Xdist, y + Ydist, x - Xdist + dist,
+                            y + Ydist - dist, z, secondaryColor );
+    }
+}
+
+void VideoSource::drawTexture( float Xdist, float Ydist, float s, float t,
+                                bool drawX )
+{
+    // set up our position
+    glPushMatrix();
+
+    glRotatef( xAngle, 1.0, 0.0, 0.0 );
+    glRotatef( yAngle, 0.0, 1.0, 0.0 );
+    glRotatef( zAngle, 0.0, 0.0, 1.0 );
+
+    glTranslatef(x,y,z);
+
+    //glDepthMask( GL_FALSE );
+    //glDepthRange (0.0, 0.9);
+    //glPolygonOffset( 0.2, 0.8 );
+
     // draw video texture, regardless of whether we just pushed something
     // new or not
-    if ( GLUtil::getInstance()->areShadersAvailable() )
+    if ( planar )
+    {
+        glActiveTexture( GL_TEXTURE1 );
+        glBindTexture( GL_TEXTURE_2D, chromaTexids[0] );
+        glActiveTexture( GL_TEXTURE2 );
+        glBindTexture( GL_TEXTURE_2D, chromaTexids[1] );
+        glActiveTexture( GL_TEXTURE0 );
+
+        glUseProgram( GLUtil::getInstance()->getYUV420PlanarProgram() );
+        if ( useAlpha )
+        {
+            glUniform1f( GLUtil::getInstance()->getYUV420PlanaralphaID(),
+                            borderColor.A );
+        }
+    }
+    else if ( GLUtil::getInstance()->areShadersAvailable() && !cpuConvert )
     {
         glUseProgram( GLUtil::getInstance()->getYUV420Program() );
         glUniform1f( GLUtil::getInstance()->getYUV420xOffsetID(), s );
@@ -234,19 +471,25 @@ void VideoSource::draw()
         float scaleFactor = getTextScale();
         glScalef( scaleFactor, scaleFactor, scaleFactor );
         std::string waitingMessage( "Waiting for video..." );
-        font->Render( waitingMessage.c_str() );
+        SDFFont* textFont = GLUtil::getInstance()->getTextFont();
+        if ( textFont != NULL )
+        {
+            RGBAColor white;
+            white.R = 1.0f; white.G = 1.0f; white.B = 1.0f;
+            white.A = useAlpha ? borderColor.A : 1.0f;
+            textFont->render( waitingMessage, white );
+        }
+        else
+            font->Render( waitingMessage.c_str() );
         glPopMatrix();
     }
 
-    // draw a basic X in the top-left corner for signifying that rendering is
-    // disabled, differentiating between muting and just having the texture
-    // push disabled via the color
-    if ( !enableRendering )
+    // see draw() for the batched version
+    if ( !enableRendering && drawX )
     {
         float dist = getWidth() * 0.1f;
 
         glBegin( GL_LINES );
-        glLineWidth( 3.0f );
 
         glColor4f( secondaryColor.R, secondaryColor.G, secondaryColor.B,
                     secondaryColor.A );
@@ -270,58 +513,588 @@ void VideoSource::draw()
 
 }
 
-void VideoSource::resizeBuffer()
+void VideoSource::uploadFrame( const GLubyte* data )
+{
+    mipmapsDirty = true;
+
+    if ( cpuConvert )
+    {
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth,
+              fheight,
+              GL_RGBA,
+              GL_UNSIGNED_BYTE,
+              data );
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    }
+
+    else if ( videoSink->getFrameFormat() == VIDEO_FORMAT_RGB24 )
+    {
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth,
+              fheight,
+              GL_RGB,
+              GL_UNSIGNED_BYTE,
+              data );
+    }
+
+    // planar yuv420: each plane goes to its own texture at the origin
+    else if ( planar )
+    {
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth,
+              fheight,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data );
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, fwidth/2);
+
+        glBindTexture( GL_TEXTURE_2D, chromaTexids[0] );
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth/2,
+              fheight/2,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data + (fwidth*fheight) );
+
+        glBindTexture( GL_TEXTURE_2D, chromaTexids[1] );
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth/2,
+              fheight/2,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data + 5*(fwidth*fheight)/4 );
+
+        glBindTexture( GL_TEXTURE_2D, texid );
+    }
+
+    // if we're doing packed yuv420, do the texture mapping for all 3 channels
+    // so the shader can properly work its magic
+    else if ( videoSink->getFrameFormat() == VIDEO_FORMAT_YUV420 )
+    {
+        // 3 pushes separate
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              0,
+              fwidth,
+              fheight,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data );
+
+        // now map the U & V to the bottom chunk of the image
+        // each is 1/4 of the size of the Y (half width, half height)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, fwidth/2);
+
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              0,
+              fheight,
+              fwidth/2,
+              fheight/2,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data + (fwidth*fheight) );
+
+        glTexSubImage2D( GL_TEXTURE_2D,
+              0,
+              fwidth/2,
+              fheight,
+              fwidth/2,
+              fheight/2,
+              GL_LUMINANCE,
+              GL_UNSIGNED_BYTE,
+              data + 5*(fwidth*fheight)/4 );
+    }
+}
+
+unsigned int VideoSource::getFrameSize()
+{
+    if ( cpuConvert )
+        return fwidth * fheight * 4;
+    else if ( videoSink->getFrameFormat() == VIDEO_FORMAT_YUV420 )
+        return fwidth * fheight * 3 / 2;
+    else
+        return fwidth * fheight * 3;
+}
+
+GLuint VideoSource::createTexture( unsigned int w, unsigned int h,
+                                    GLint internalFormat )
+{
+    // comes back bound & filled with gray
+    GLuint tex = texturePool->acquire( w, h, internalFormat );
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    return tex;
+}
+
+void VideoSource::releaseTextures()
+{
+    if ( texid == 0 )
+        return;
+
+    GLint format = planar ? GL_LUMINANCE : ( cpuConvert ? GL_RGBA : GL_RGB );
+    // the pool only exists if we were drawn, which is the only way we'd
+    // have textures - but be safe
+    if ( texturePool != NULL )
+    {
+        texturePool->release( texid, tex_width, tex_height, format );
+        if ( planar )
+        {
+            texturePool->release( chromaTexids[0], chromaWidth, chromaHeight,
+                                    GL_LUMINANCE );
+            texturePool->release( chromaTexids[1], chromaWidth, chromaHeight,
+                                    GL_LUMINANCE );
+        }
+    }
+    else
+    {
+        glDeleteTextures( 1, &texid );
+        if ( planar )
+            glDeleteTextures( 2, chromaTexids );
+    }
+
+    texid = 0;
+    chromaTexids[0] = 0; chromaTexids[1] = 0;
+}
+
+void VideoSource::setTexturePool( TexturePool* p )
+{
+    texturePool = p;
+}
+
+void VideoSource::setCPUConversion( bool c )
+{
+    mutex_lock( scaleMutex );
+    cpuConvert = c;
+    mutex_unlock( scaleMutex );
+}
+
+void VideoSource::resizeBuffer( unsigned int videoWidth,
+                                    unsigned int videoHeight,
+                                    unsigned int frameWidth,
+                                    unsigned int frameHeight )
 {
 	listener->updatePixelCount( -( vwidth * vheight ) );
-    vwidth = videoSink->getImageWidth();
-    vheight = videoSink->getImageHeight();
+    vwidth = videoWidth;
+    vheight = videoHeight;
     listener->updatePixelCount(  vwidth * vheight );
+    fwidth = frameWidth;
+    fheight = frameHeight;
 
     if ( vheight > 0 )
         aspect = (float)vwidth / (float)vheight;
     else
         aspect = 1.33f;
 
-    tex_width = GLUtil::getInstance()->pow2(vwidth);
-    if ( videoSink->getImageFormat() == VIDEO_FORMAT_YUV420 )
-        tex_height = GLUtil::getInstance()->pow2( 3*vheight/2 );
-    else
-        tex_height = GLUtil::getInstance()->pow2( vheight );
-
-    gravUtil::logVerbose( "VideoSource::resizeBuffer: image size is %ix%i\n",
-            vwidth, vheight );
-    gravUtil::logVerbose( "VideoSource::resizeBuffer: texture size is %ix%i\n",
-            tex_width, tex_height );
+    // converted frames are plain RGBA, whatever the sink has
+    bool yuv = videoSink->getFrameFormat() == VIDEO_FORMAT_YUV420 &&
+                !cpuConvert;
+    bool npot = GLUtil::getInstance()->areNPOTTexturesAvailable();
 
     // if it's not the first time we're allocating a texture
-    // (ie, it's a resize) delete the previous texture
-    if ( !init ) glDeleteTextures( 1, &texid );
-    glGenTextures(1, &texid);
+    // (ie, it's a resize) give the previous texture(s) back
+    releaseTextures();
+    // new textures come back with plain linear filtering
+    mipmapActive = false;
 
-    glBindTexture(GL_TEXTURE_2D, texid);
+    planar = yuv && GLUtil::getInstance()->isPlanarYUVAvailable();
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    if ( planar )
+    {
+        // Y at full size plus two quarter-size chroma planes, so texture
+        // memory matches the actual pixel count
+        tex_width = fwidth;
+        tex_height = fheight;
+        chromaWidth = fwidth/2;
+        chromaHeight = fheight/2;
+        texid = createTexture( tex_width, tex_height, GL_LUMINANCE );
+        chromaTexids[0] = createTexture( chromaWidth, chromaHeight,
+                                            GL_LUMINANCE );
+        chromaTexids[1] = createTexture( chromaWidth, chromaHeight,
+                                            GL_LUMINANCE );
+    }
+    else
+    {
+        // packed YUV needs room for the chroma planes below the Y plane
+        unsigned int h = yuv ? 3*fheight/2 : fheight;
+        tex_width = npot ? fwidth : GLUtil::getInstance()->pow2( fwidth );
+        tex_height = npot ? h : GLUtil::getInstance()->pow2( h );
+        texid = createTexture( tex_width, tex_height,
+                                cpuConvert ? GL_RGBA : GL_RGB );
+    }
+
+    gravUtil::logVerbose( "VideoSource::resizeBuffer: image size is %ix%i "
+            "(frames %ix%i)\n", vwidth, vheight, fwidth, fheight );
+    gravUtil::logVerbose( "VideoSource::resizeBuffer: texture size is %ix%i%s\n",
+            tex_width, tex_height, planar ? " (planar)" : "" );
+
+    glBindTexture( GL_TEXTURE_2D, texid );
 
-    unsigned char *buffer = new unsigned char[tex_width * tex_height * 3];
-    memset(buffer, 128, tex_width * tex_height * 3);
-    glTexImage2D( GL_TEXTURE_2D,
-                  0,
-                  GL_RGB,
-                  tex_width,
-                  tex_height,
-                  0,
-                  GL_LUMINANCE,
-                  GL_UNSIGNED_BYTE,
-                  buffer);
-    delete [] buffer;
+    // the PBO contents are sized for the old dimensions, so drop anything
+    // pending and reallocate the ring
+    if ( usePBOs )
+    {
+        if ( pbos[0] == 0 )
+            glGenBuffersARB( numPBOs, pbos );
+        for ( int i = 0; i < numPBOs; i++ )
+        {
+            glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pbos[i] );
+            glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, getFrameSize(), NULL,
+                                GL_STREAM_DRAW_ARB );
+        }
+        glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+        pboPending = false;
+    }
 
     // update text bounds since the width might be different
     updateTextBounds();
 }
 
+void VideoSource::setDisplaySize( unsigned int w, unsigned int h )
+{
+    unsigned int newWidth = 0;
+    unsigned int newHeight = 0;
+
+    if ( vwidth > 0 && vheight > 0 )
+    {
+        float needed = std::max( (float)w / (float)vwidth,
+                                 (float)h / (float)vheight );
+        // only bother scaling if it'd cut out a good chunk of the frame -
+        // otherwise the scale costs more than the upload it saves
+        if ( needed < 0.75f )
+        {
+            // round up to a multiple of 16 so small size changes (ie, during
+            // animation) don't make a new scaling context every time, and
+            // keep the height even so the chroma planes line up
+            newWidth = ( ( (unsigned int)( needed * vwidth ) + 15 ) / 16 ) * 16;
+            newWidth = std::min( newWidth, vwidth );
+            newHeight = ( newWidth * vheight / vwidth ) & ~1u;
+            if ( newWidth < 16 || newHeight < 2 )
+            {
+                newWidth = 16;
+                newHeight = ( 16 * vheight / vwidth + 1 ) & ~1u;
+            }
+        }
+    }
+
+    mutex_lock( scaleMutex );
+    if ( newWidth != targetWidth || newHeight != targetHeight )
+    {
+        gravUtil::logVerbose( "VideoSource::setDisplaySize: %s now using "
+                "%ix%i frames (native %ix%i)\n", name.c_str(),
+                newWidth ? newWidth : vwidth, newHeight ? newHeight : vheight,
+                vwidth, vheight );
+        targetWidth = newWidth;
+        targetHeight = newHeight;
+        // going back to native (ie, enlarging) takes effect on the next draw
+        // since the sink always has the native frame, so drop the scaled
+        // frames (converted ones still stand in until the next one comes
+        // in). going to a different scaled size keeps the old scaled frame
+        // until the next one comes in. draw() is on this thread, so the read
+        // buffer is ours to change
+        if ( targetWidth == 0 && !cpuConvert )
+        {
+            processedFrames[ processedRead ].width = 0;
+            processedFrames[ processedRead ].height = 0;
+            processedFrameNew = false;
+        }
+    }
+    mutex_unlock( scaleMutex );
+}
+
+void VideoSource::newFrameCallback( VPMVideoSink* sink, int bufferIdx,
+                                        void* userData )
+{
+    VideoSource* source = (VideoSource*)userData;
+    if ( source == NULL )
+        return;
+
+    source->recordFrameDecoded();
+
+    if ( source->pipeline != NULL )
+        source->pipeline->frameReady( source );
+    else
+        source->processFrame();
+}
+
+void VideoSource::setPipeline( FramePipeline* p )
+{
+    if ( pipeline == p )
+        return;
+
+    if ( pipeline != NULL )
+        pipeline->removeSource( this );
+    if ( p != NULL )
+        p->addSource( this );
+    pipeline = p;
+}
+
+void VideoSource::processFrame()
+{
+    // work out what to do & claim the sink, then let go of the lock for the
+    // actual scaling & conversion so draw() never waits on it. only this
+    // thread touches the write buffer, so it's safe to fill outside the lock
+    mutex_lock( scaleMutex );
+    unsigned int destWidth = targetWidth;
+    unsigned int destHeight = targetHeight;
+    bool convert = cpuConvert;
+    bool take = ( destWidth > 0 || convert ) && !drawReadingSink;
+    if ( take )
+        processing = true;
+    ProcessedFrame& frame = processedFrames[ processedWrite ];
+    mutex_unlock( scaleMutex );
+
+    if ( !take )
+        return;
+
+    bool processed = false;
+    if ( videoSink->takeNewestFrame() )
+    {
+        const uint8_t* data = videoSink->getFrameData();
+        unsigned int w = videoSink->getFrameWidth();
+        unsigned int h = videoSink->getFrameHeight();
+        VPMVideoFormat format = videoSink->getFrameFormat();
+        frame.sourceWidth = w;
+        frame.sourceHeight = h;
+        processed = true;
+
+        // scale first so there's less to convert
+        if ( destWidth > 0 )
+        {
+            processed = scaler->scale( data, w, h, format, destWidth,
+                                        destHeight );
+            if ( processed )
+            {
+                data = scaler->getData();
+                w = scaler->getWidth();
+                h = scaler->getHeight();
+            }
+        }
+
+        if ( processed && ( data == NULL || w == 0 || h == 0 ) )
+            processed = false;
+
+        if ( processed && convert )
+        {
+            frame.data.resize( w * h * 4 );
+            ColorConverter::yuv420ToRGBA( data, w, h, &frame.data[0] );
+        }
+        else if ( processed )
+        {
+            // the scaler's output gets overwritten by the next frame, so it
+            // needs its own copy - it's downscaled, so this is the cheap part
+            unsigned int size = format == VIDEO_FORMAT_YUV420 ?
+                                    w * h * 3 / 2 : w * h * 3;
+            frame.data.assign( data, data + size );
+        }
+        frame.width = w;
+        frame.height = h;
+    }
+
+    mutex_lock( scaleMutex );
+    processing = false;
+    // the size or mode changed while this one was being made, so it's stale
+    if ( processed && destWidth == targetWidth &&
+            destHeight == targetHeight && convert == cpuConvert )
+    {
+        // the last processed frame never got pushed
+        if ( processedFrameNew )
+        {
+            mutex_lock( statsMutex );
+            processedDropped++;
+            mutex_unlock( statsMutex );
+        }
+        std::swap( processedWrite, processedLatest );
+        processedFrameNew = true;
+    }
+    mutex_unlock( scaleMutex );
+}
+
+void VideoSource::recordFrameDecoded()
+{
+    double now = gravUtil::getTime();
+
+    mutex_lock( statsMutex );
+    if ( lastFrameTime > 0.0 )
+    {
+        double interval = now - lastFrameTime;
+        // jitter as the smoothed change in interval between frames, like
+        // RTP's interarrival jitter
+        if ( lastFrameInterval > 0.0 )
+        {
+            float d = (float)fabs( interval - lastFrameInterval ) * 1000.0f;
+            frameJitter += ( d - frameJitter ) / 16.0f;
+        }
+        lastFrameInterval = interval;
+    }
+    lastFrameTime = now;
+    updateRates( now );
+    mutex_unlock( statsMutex );
+}
+
+void VideoSource::updateRates( double now )
+{
+    // called with statsMutex held. only recalculate every second or so, so
+    // the rates aren't just noise
+    double elapsed = now - rateTime;
+    if ( elapsed < 1.0 )
+        return;
+
+    unsigned long counts[4] = { videoSink->getPushedCount(),
+                                videoSink->getDroppedCount() + processedDropped,
+                                uploadedCount, presentedCount };
+    for ( int i = 0; i < 4; i++ )
+    {
+        rates[i] = (float)( ( counts[i] - rateCounts[i] ) / elapsed );
+        rateCounts[i] = counts[i];
+    }
+    rateTime = now;
+}
+
+VideoStats VideoSource::getStats()
+{
+    VideoStats stats;
+    double now = gravUtil::getTime();
+
+    mutex_lock( statsMutex );
+    updateRates( now );
+    stats.decoded = videoSink->getPushedCount();
+    stats.dropped = videoSink->getDroppedCount() + processedDropped;
+    stats.uploaded = uploadedCount;
+    stats.presented = presentedCount;
+    stats.uploadedBytes = uploadedBytes;
+    stats.decodedRate = rates[0];
+    stats.droppedRate = rates[1];
+    stats.uploadedRate = rates[2];
+    stats.presentedRate = rates[3];
+    stats.jitter = frameJitter;
+    stats.lastFrameAge = lastFrameTime > 0.0 ?
+                            (float)( ( now - lastFrameTime ) * 1000.0 ) : -1.0f;
+    stats.mipmapTime = mipmapCount > 0 ?
+                        (float)( mipmapTime * 1000.0 / mipmapCount ) : 0.0f;
+    mutex_unlock( statsMutex );
+    stats.mipmapped = mipmapActive;
+
+    if ( pipeline != NULL )
+    {
+        stats.queueDepth = pipeline->getQueueDepth( this );
+        stats.pipelineLatency = pipeline->getAverageLatency( this );
+    }
+    else
+    {
+        stats.queueDepth = 0;
+        stats.pipelineLatency = 0.0f;
+    }
+
+    return stats;
+}
+
+bool VideoSource::hasPendingFrame()
+{
+    // scaleMutex is only ever held for the buffer swaps, never over a
+    // conversion, so this doesn't wait on any processing in progress
+    mutex_lock( scaleMutex );
+    bool pending = processedFrameNew;
+    mutex_unlock( scaleMutex );
+    return pending || videoSink->hasNewFrame();
+}
+
+unsigned int VideoSource::getUploadSize()
+{
+    return getFrameSize();
+}
+
+double VideoSource::getLastUploadTime()
+{
+    // only written on the main thread (in draw), which is the only reader
+    return lastUploadTime;
+}
+
+void VideoSource::setUploadAllowed( bool a )
+{
+    uploadAllowed = a;
+}
+
+void VideoSource::setMipmapped( bool m )
+{
+    mipmapRequested = m;
+}
+
+void VideoSource::updateMipmaps()
+{
+    GLUtil* glUtil = GLUtil::getInstance();
+    bool packedYUV = videoSink->getFrameFormat() == VIDEO_FORMAT_YUV420 &&
+                        !cpuConvert && !planar;
+    bool want = mipmapRequested && texid != 0 && !packedYUV &&
+                    glUtil->areMipmapsAvailable();
+
+    if ( want != mipmapActive )
+    {
+        GLint filter = want ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+        if ( planar )
+        {
+            for ( int i = 0; i < 2; i++ )
+            {
+                glBindTexture( GL_TEXTURE_2D, chromaTexids[i] );
+                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                                    filter );
+            }
+            glBindTexture( GL_TEXTURE_2D, texid );
+        }
+        mipmapActive = want;
+        // the levels are stale (or were never made) either way
+        mipmapsDirty = true;
+    }
+
+    if ( !mipmapActive || !mipmapsDirty )
+        return;
+
+    // note that on hardware GL this mostly times queuing the work, but
+    // software GL does the whole thing here
+    double start = gravUtil::getTime();
+    glUtil->generateMipmaps();
+    if ( planar )
+    {
+        for ( int i = 0; i < 2; i++ )
+        {
+            glBindTexture( GL_TEXTURE_2D, chromaTexids[i] );
+            glUtil->generateMipmaps();
+        }
+        glBindTexture( GL_TEXTURE_2D, texid );
+    }
+    double elapsed = gravUtil::getTime() - start;
+    mipmapsDirty = false;
+
+    mutex_lock( statsMutex );
+    mipmapTime += elapsed;
+    mipmapCount++;
+    mutex_unlock( statsMutex );
+}
+
 void VideoSource::scaleNative()
 {
     // no point in scaling to 0x0
@@ -354,7 +1127,8 @@ std::string VideoSource::getMetadata( VPMSession::VPMSession_SDES type )
     uint32_t bufferLen = sizeof( buffer );
     std::string temp = std::string();
 
-    if ( session->getRemoteSDES( ssrc, type, buffer, bufferLen ) )
+    // locally generated sources don't have a session to get SDES from
+    if ( session != NULL && session->getRemoteSDES( ssrc, type, buffer, bufferLen ) )
         temp = std::string( buffer );
 
     return temp;
@@ -414,7 +1188,10 @@ std::string VideoSource::getName()
 
 const char* VideoSource::getPayloadDesc()
 {
-    return videoSink->getVideoDecoder()->getDesc();
+    VPMVideoDecoder* decoder = videoSink->getVideoDecoder();
+    if ( decoder == NULL )
+        return "synthetic";
+    return decoder->getDesc();
 }
 
 VPMSession* VideoSource::getSession()
@@ -464,7 +1241,8 @@ void VideoSource::setHeight( float h )
 
 void VideoSource::toggleMute()
 {
-    session->enableSource( ssrc, isMuted() );
+    userMuted = !userMuted;
+    updateDecoderState();
     enableRendering = !isMuted();
 
     if ( isMuted() )
@@ -486,7 +1264,54 @@ void VideoSource::toggleMute()
 
 bool VideoSource::isMuted()
 {
-    return !session->isSourceEnabled( ssrc );
+    return userMuted;
+}
+
+void VideoSource::setAutoPaused( bool p )
+{
+    if ( p == autoPaused )
+        return;
+
+    autoPaused = p;
+    updateDecoderState();
+
+    // only need to wait for the decoder if it's actually starting back up
+    if ( !autoPaused && !userMuted )
+        resumeTime = gravUtil::getTime();
+
+    gravUtil::logVerbose( "VideoSource::setAutoPaused: %s %s\n",
+            autoPaused ? "pausing" : "resuming", name.c_str() );
+}
+
+bool VideoSource::isAutoPaused()
+{
+    return autoPaused;
+}
+
+void VideoSource::setVisible( bool v )
+{
+    visible = v;
+    if ( visible )
+        lastVisibleTime = gravUtil::getTime();
+}
+
+bool VideoSource::isVisible()
+{
+    return visible;
+}
+
+double VideoSource::getLastVisibleTime()
+{
+    return lastVisibleTime;
+}
+
+void VideoSource::updateDecoderState()
+{
+    bool enable = !userMuted && !autoPaused;
+    if ( session == NULL )
+        return;
+    if ( session->isSourceEnabled( ssrc ) != enable )
+        session->enableSource( ssrc, enable );
 }
 
 void VideoSource::setRendering( bool r )
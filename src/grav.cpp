@@ -40,6 +40,12 @@
 #include "SideFrame.h"
 #include "Timers.h"
 #include "VenueClientController.h"
+#include "FramePipeline.h"
+#include "SyntheticSourceManager.h"
+#include "RTPCapture.h"
+#include "RTPReplayer.h"
+#include "OffscreenContext.h"
+#include "RenderBenchmark.h"
 
 #include <VPMedia/VPMLog.h>
 #include <VPMedia/VPMPayloadDecoderFactory.h>
@@ -70,6 +76,12 @@ bool gravApp::OnInit()
     audioSessionListener = new AudioManager();
     sessionManager = new SessionManager( videoSessionListener,
                                             audioSessionListener );
+    syntheticSources = NULL;
+    capture = NULL;
+    replayer = NULL;
+    offscreen = NULL;
+    headlessFrames = 0;
+    venueClientController = NULL;
     //videoInitialized = false; audioInitialized = false;
 
     if ( !handleArgs() )
@@ -86,6 +98,25 @@ bool gravApp::OnInit()
     if ( VPMverbose )
         vpmlog_set_log_level( VPMLOG_LEVEL_DEBUG );
 
+    framePipeline = new FramePipeline( pipelineThreads );
+    videoSessionListener->setPipeline( framePipeline );
+    videoSessionListener->setCPUConversion( !disableCPUConvert );
+
+    if ( captureFile.compare( "" ) != 0 )
+    {
+        capture = new RTPCapture();
+        if ( capture->open( captureFile ) )
+            sessionManager->setCapture( capture );
+        else
+        {
+            delete capture;
+            capture = NULL;
+        }
+    }
+
+    if ( headless )
+        return initHeadless();
+
     // GUI setup
     mainFrame = new Frame( (wxFrame*)NULL, -1, _("grav"),
                         wxPoint( startX, startY ),
@@ -157,17 +188,10 @@ bool gravApp::OnInit()
         PythonTools::disableInit = true;
     }
 
-    // since these bools are used in glinit, set them before glinit
-    GLUtil::getInstance()->setShaderEnable( enableShaders );
-    GLUtil::getInstance()->setBufferFontUsage( bufferFont );
-
     // initialize GL stuff (+ shaders) needs to be done AFTER attriblist is
     // used in making the canvas
-    if ( !GLUtil::getInstance()->initGL() )
+    if ( !initGL() )
     {
-        // bail out if something failed
-        gravUtil::logError( "grav::OnInit(): ERROR: initGL() failed, "
-                "exiting\n" );
         delete grav;
         return false;
     }
@@ -212,39 +236,221 @@ bool gravApp::OnInit()
     mapRTP();
 
     sessionTree->setSessionManager( sessionManager );
+    addInitialSources();
+
+    if ( getAGVenueStreams && !disablePython )
+    {
+        venueClientController->updateVenueStreams();
+        venueClientController->addAllVenueStreams();
+    }
+
+    if ( autoRotateAvailableVideo )
+        sessionTree->startTimer( rotateIntervalMS );
+
+    gravUtil::logVerbose( "grav::init function complete\n" );
+    return true;
+}
+
+bool gravApp::initHeadless()
+{
+    mainFrame = NULL;
+    treeFrame = NULL;
+    canvas = NULL;
+    timer = NULL;
+    sourceTree = NULL;
+    sessionTree = NULL;
+
+    if ( printVersion )
+    {
+        std::string ver = "grav ";
+        ver += gravUtil::getVersionString();
+        gravUtil::logMessage( ver.c_str() );
+    }
+
+    // the window size options give the size of the offscreen buffer
+    offscreen = new OffscreenContext();
+    if ( !offscreen->create( windowWidth, windowHeight ) || !initGL() ||
+            !offscreen->initTarget() )
+    {
+        gravUtil::logError( "grav::initHeadless: couldn't set up offscreen "
+                "rendering, exiting\n" );
+        delete grav;
+        delete offscreen;
+        return false;
+    }
+
+    if ( headerSet )
+        grav->setHeaderString( header );
+
+    earth = new Earth();
+    // only used for the selection state, since there's no window to get
+    // events from
+    input = new InputHandler( earth, grav, NULL );
+
+    grav->setEarth( earth );
+    grav->setInput( input );
+    grav->setTree( NULL );
+    grav->setBorderTex( "border.png" );
+    grav->setVideoListener( videoSessionListener );
+    grav->setCanvas( NULL );
+    grav->setVenueClientController( NULL );
+    grav->setAudio( audioSessionListener );
+
+    GLCanvas::setupView( grav, windowWidth, windowHeight );
+
+    mapRTP();
+    addInitialSources();
+
+    gravUtil::logVerbose( "grav::initHeadless: rendering %li frames at "
+            "%ix%i\n", headlessFrames, windowWidth, windowHeight );
+    return true;
+}
+
+bool gravApp::initGL()
+{
+    // since these bools are used in glinit, set them before glinit
+    GLUtil::getInstance()->setShaderEnable( enableShaders );
+    GLUtil::getInstance()->setBufferFontUsage( bufferFont );
+    GLUtil::getInstance()->setSDFTextEnable( !disableSDFText );
+    GLUtil::getInstance()->setPBOEnable( !disablePBOs );
+
+    if ( !GLUtil::getInstance()->initGL() )
+    {
+        // bail out if something failed
+        gravUtil::logError( "grav::OnInit(): ERROR: initGL() failed, "
+                "exiting\n" );
+        return false;
+    }
+    return true;
+}
+
+void gravApp::addSession( std::string address, bool audio, bool available )
+{
+    // the session tree keeps its list in sync with the session manager, but
+    // there isn't one when running headless
+    if ( sessionTree != NULL )
+        sessionTree->addSession( address, audio, available );
+    else if ( available )
+        sessionManager->addAvailableSession( address, audio );
+    else
+        sessionManager->initSession( address, audio );
+}
+
+void gravApp::setEncryptionKey( std::string address, std::string key )
+{
+    if ( sessionTree != NULL )
+        sessionTree->setEncryptionKey( address, key );
+    else
+        sessionManager->setEncryptionKey( address, key );
+}
+
+void gravApp::addInitialSources()
+{
     for ( unsigned int i = 0; i < initialVideoAddresses.size(); i++ )
     {
         gravUtil::logVerbose ( "grav::initializing video address %s\n",
                     initialVideoAddresses[i].c_str() );
-        sessionTree->addSession( initialVideoAddresses[i], false,
+        addSession( initialVideoAddresses[i], false,
                     addToAvailableVideoList );
 
         if ( haveVideoKey )
-            sessionTree->setEncryptionKey( initialVideoAddresses[i],
-                                            initialVideoKey );
+            setEncryptionKey( initialVideoAddresses[i], initialVideoKey );
     }
     for ( unsigned int i = 0; i < initialAudioAddresses.size(); i++ )
     {
         gravUtil::logVerbose ( "grav::initializing audio address %s\n",
                     initialAudioAddresses[i].c_str() );
-        sessionTree->addSession( initialAudioAddresses[i], true, false );
+        addSession( initialAudioAddresses[i], true, false );
 
         if ( haveAudioKey )
-            sessionTree->setEncryptionKey( initialAudioAddresses[i],
-                                            initialAudioKey );
+            setEncryptionKey( initialAudioAddresses[i], initialAudioKey );
     }
 
-    if ( getAGVenueStreams && !disablePython )
+    if ( replayFile.compare( "" ) != 0 )
     {
-        venueClientController->updateVenueStreams();
-        venueClientController->addAllVenueStreams();
+        replayer = new RTPReplayer();
+        replayer->setSpeed( (float)replaySpeed );
+        if ( replayer->load( replayFile ) )
+        {
+            for ( int i = 0; i < replayer->getSessionCount(); i++ )
+            {
+                gravUtil::logVerbose( "grav::replaying %s on %s\n",
+                        replayer->getOriginalAddress( i ).c_str(),
+                        replayer->getReplayAddress( i ).c_str() );
+                addSession( replayer->getReplayAddress( i ),
+                            replayer->isAudio( i ), false );
+            }
+            replayer->start();
+        }
     }
 
-    if ( autoRotateAvailableVideo )
-        sessionTree->startTimer( rotateIntervalMS );
+    if ( syntheticSpec.compare( "" ) != 0 )
+    {
+        syntheticSources = new SyntheticSourceManager( videoSessionListener );
+        if ( syntheticSources->addSources( syntheticSpec ) )
+            syntheticSources->start();
+    }
+}
 
-    gravUtil::logVerbose( "grav::init function complete\n" );
-    return true;
+bool gravApp::Initialize( int& argc, wxChar** argv )
+{
+    // the GUI initialisation needs a display (& fails without an X server),
+    // so for headless mode only do the non-GUI part. this happens before
+    // OnInit, so the options have to be picked out by hand. the benchmark is
+    // always headless
+    headless = false;
+    for ( int i = 1; i < argc; i++ )
+    {
+        wxString arg( argv[i] );
+        if ( arg.StartsWith( _("-hl") ) || arg.StartsWith( _("--headless") ) ||
+                arg.StartsWith( _("-bm") ) ||
+                arg.StartsWith( _("--benchmark") ) )
+            headless = true;
+    }
+
+    if ( headless )
+        return wxAppConsole::Initialize( argc, argv );
+    return wxApp::Initialize( argc, argv );
+}
+
+bool gravApp::OnInitGui()
+{
+    if ( headless )
+        return true;
+    return wxApp::OnInitGui();
+}
+
+void gravApp::CleanUp()
+{
+    if ( headless )
+        wxAppConsole::CleanUp();
+    else
+        wxApp::CleanUp();
+}
+
+int gravApp::OnRun()
+{
+    if ( !headless )
+        return wxApp::OnRun();
+
+    // same as the idle handler, but no event loop to drive it
+    if ( usingThreads )
+    {
+        grav->setThreads( usingThreads );
+        sessionManager->setBusyWait( sessionBusyWait );
+        sessionManager->startThreads( sessionThreads );
+    }
+
+    RenderBenchmark benchmark( grav, sessionManager, videoSessionListener,
+                                offscreen );
+    benchmark.setThreads( usingThreads );
+    benchmark.setFrameInterval( timerIntervalUS );
+
+    if ( benchmarkFile.compare( "" ) != 0 )
+        return benchmark.runSuite( headlessFrames, benchmarkFile ) ? 0 : 1;
+
+    benchmark.printStats( benchmark.runFrames( headlessFrames ) );
+    return 0;
 }
 
 int gravApp::OnExit()
@@ -253,9 +459,20 @@ int gravApp::OnExit()
     // TODO: test this stuff more, valgrind etc
 
     if ( usingThreads )
+        sessionManager->stopThreads();
+
+    if ( replayer != NULL )
+    {
+        replayer->stop();
+        delete replayer;
+    }
+
+    // these go through the video listener, so take them out while it's still
+    // around. their sinks stay until the sources are actually deleted
+    if ( syntheticSources != NULL )
     {
-        threadRunning = false;
-        thread_join( VPMthread );
+        syntheticSources->stop();
+        syntheticSources->removeSources();
     }
 
     // note, tree and canvas get deleted automatically since they're children
@@ -265,6 +482,9 @@ int gravApp::OnExit()
     delete timer;
 
     delete sessionManager;
+    // after the sessions, so the capture includes everything up to the end
+    if ( capture != NULL )
+        delete capture;
     delete videoSessionListener;
     delete audioSessionListener;
 
@@ -274,10 +494,18 @@ int gravApp::OnExit()
     if ( venueClientController != NULL )
         delete venueClientController;
     delete grav;
+    // the sinks for these are used by the sources up until they're deleted
+    if ( syntheticSources != NULL )
+        delete syntheticSources;
+    // after grav since deleting sources takes them out of the pipeline
+    delete framePipeline;
 
     VPMPayloadDecoderFactory::shutdown();
 
     GLUtil::cleanupGL();
+    // last, since the GL cleanup needs the context
+    if ( offscreen != NULL )
+        delete offscreen;
     PythonTools::cleanup();
     gravUtil::cleanup();
 
@@ -286,12 +514,12 @@ int gravApp::OnExit()
 
 void gravApp::idleHandler( wxIdleEvent& evt )
 {
-    // start secondary thread if not running
-    if ( usingThreads && !threadRunning )
+    // start session threads if not running
+    if ( usingThreads && !sessionManager->areThreadsRunning() )
     {
         grav->setThreads( usingThreads );
-        threadRunning = true;
-        VPMthread = thread_start( threadTest, this );
+        sessionManager->setBusyWait( sessionBusyWait );
+        sessionManager->startThreads( sessionThreads );
     }
 
     if ( !usingThreads )
@@ -323,16 +551,6 @@ void gravApp::idleHandler( wxIdleEvent& evt )
     evt.RequestMore();
 }
 
-void gravApp::iterateSessions()
-{
-    bool haveSessions = sessionManager->iterateSessions();
-
-    // if there are no sessions, sleep so as not to spin and consume CPU
-    // needlessly
-    if ( !haveSessions )
-        wxMicroSleep( 500 );
-}
-
 bool gravApp::handleArgs()
 {
     parser.SetDesc( cmdLineDesc );
@@ -370,12 +588,58 @@ bool gravApp::handleArgs()
 
     usingThreads = !parser.Found( _("no-threads") );
 
+    long int sessionThreadsTemp;
+    if ( parser.Found( _("session-threads"), &sessionThreadsTemp ) &&
+            sessionThreadsTemp > 0 )
+        sessionThreads = (int)sessionThreadsTemp;
+    else
+        sessionThreads = 1;
+
+    sessionBusyWait = parser.Found( _("session-busy-wait") );
+
+    long int pipelineThreadsTemp;
+    if ( parser.Found( _("pipeline-threads"), &pipelineThreadsTemp ) &&
+            pipelineThreadsTemp >= 0 )
+        pipelineThreads = (int)pipelineThreadsTemp;
+    else
+        pipelineThreads = 2;
+
     disablePython = parser.Found( _("no-python") );
 
     enableShaders = parser.Found( _("enable-shaders") );
 
+    disableCPUConvert = parser.Found( _("no-cpu-convert") );
+
+    wxString benchmarkWX;
+    if ( parser.Found( _("benchmark"), &benchmarkWX ) )
+        benchmarkFile = std::string( (char*)benchmarkWX.char_str() );
+
+    if ( ( parser.Found( _("headless"), &headlessFrames ) ||
+                benchmarkFile.compare( "" ) != 0 ) && headlessFrames <= 0 )
+        headlessFrames = 100;
+
+    wxString captureWX;
+    if ( parser.Found( _("capture"), &captureWX ) )
+        captureFile = std::string( (char*)captureWX.char_str() );
+
+    wxString replayWX;
+    if ( parser.Found( _("replay"), &replayWX ) )
+        replayFile = std::string( (char*)replayWX.char_str() );
+
+    if ( !parser.Found( _("replay-speed"), &replaySpeed ) ||
+            replaySpeed < 0 )
+        replaySpeed = 1;
+
+    wxString syntheticWX;
+    if ( parser.Found( _("synthetic-sources"), &syntheticWX ) )
+        syntheticSpec = std::string( (char*)syntheticWX.char_str() );
+
     bufferFont = parser.Found( _("use-buffer-font") );
 
+    disableSDFText = parser.Found( _("no-sdf-text") );
+
+    disablePBOs = parser.Found( _("no-pbo") );
+
     startFullscreen = parser.Found( _("fullscreen") );
 
     addToAvailableVideoList = parser.Found( _("available-video-list") );
@@ -386,6 +650,19 @@ bool gravApp::handleArgs()
 
     grav->setGridAuto( parser.Found( _("gridauto") ) );
 
+    grav->setAutoPause( !parser.Found( _("no-auto-pause") ) );
+
+    grav->setDownscaling( !parser.Found( _("no-downscale") ) );
+
+    long int mipmapTemp;
+    if ( parser.Found( _("mipmaps"), &mipmapTemp ) && mipmapTemp > 0 )
+        grav->setMipmapThreshold( (unsigned int)mipmapTemp );
+
+    long int uploadBudgetTemp;
+    if ( parser.Found( _("upload-budget"), &uploadBudgetTemp ) &&
+            uploadBudgetTemp >= 0 )
+        grav->setUploadBudget( (unsigned long)uploadBudgetTemp * 1024 );
+
     fps = 0;
     if ( parser.Found( _("fps"), &fps ) )
     {
@@ -478,30 +755,3 @@ void gravApp::mapRTP()
     decoderFactory->mapPayloadType( 116, "L16_48k_mono" );
     decoderFactory->mapPayloadType( 117, "L16_48k_stereo" );
 }
-
-void* gravApp::threadTest( void* args )
-{
-    gravUtil::logVerbose( "grav::starting network/decoding thread...\n" );
-    gravApp* g = (gravApp*)args;
-    // wait a bit before starting this thread, since doing it too early might
-    // affect the WX tree before it's fully initialized somehow, rarely
-    // resulting in broken text or a crash
-    wxMilliSleep( 100 );
-    while ( g->isThreadRunning() )
-    {
-        g->iterateSessions();
-        if ( threadDebug )
-        {
-            if ( threadCounter == 0 )
-                gravUtil::logVerbose( "grav::thread still running\n" );
-            threadCounter = (threadCounter+1)%1000;
-        }
-    }
-    gravUtil::logVerbose( "grav::thread ending...\n" );
-    return 0;
-}
-
-bool gravApp::isThreadRunning()
-{
-    return threadRunning;
-}
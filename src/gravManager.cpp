@@ -49,6 +49,12 @@
 #include "VenueClientController.h"
 #include "Camera.h"
 #include "Point.h"
+#include "TexturePool.h"
+#include "UploadScheduler.h"
+#include "BatchRenderer.h"
+#include "TileRenderer.h"
+#include "SDFFont.h"
+#include "TextMetrics.h"
 
 #include "gravManager.h"
 
@@ -123,14 +129,34 @@ gravManager::gravManager()
     graphicsDebugView = false;
     pixelCount = 0;
 
+    autoPause = true;
+    autoPauseDelay = 2.0f;
+    minVisibleSize = 4.0f;
+    downscaling = true;
+    mipmapMaxSize = 0;
+
     borderTex = 0;
 
+    // doesn't do any GL until used, so fine to make before GL is set up
+    texturePool = new TexturePool();
+
+    uploadScheduler = new UploadScheduler();
+
+    batchRenderer = new BatchRenderer();
+    tileRenderer = new TileRenderer();
+
     venueClientController = NULL; // just for before it gets set
+    canvas = NULL;
 }
 
 gravManager::~gravManager()
 {
     doDelayedDelete();
+    // after the delete, since deleted videos give their textures back to it
+    delete texturePool;
+    delete uploadScheduler;
+    delete batchRenderer;
+    delete tileRenderer;
 
     delete sources;
     delete drawnObjects;
@@ -240,29 +266,17 @@ void gravManager::draw()
     // delete sources that need to be deleted - see deleteSource for the reason
     doDelayedDelete();
 
-    // draw point on geographical position, selected ones on top (and bigger)
-    for ( si = drawnObjects->begin(); si != drawnObjects->end(); si++ )
-    {
-        RGBAColor col = (*si)->getColor();
-        glColor4f( col.R, col.G, col.B, col.A );
-        if ( !(*si)->isGrouped() && !(*si)->isSelected() )
-        {
-            //drawCurvedEarthLine( (*si)->getLat(), (*si)->getLon(),
-            //                    (*si)->getX(), (*si)->getY(), (*si)->getZ() );
-            drawEarthPoint( (*si)->getLat(), (*si)->getLon(), 3.0f );
-        }
-    }
-    for ( si = selectedObjects->begin(); si != selectedObjects->end(); si++ )
-    {
-        RGBAColor col = (*si)->getColor();
-        glColor4f( col.R, col.G, col.B, col.A );
-        if ( !(*si)->isGrouped() )
-        {
-            //drawCurvedEarthLine( (*si)->getLat(), (*si)->getLon(),
-            //                    (*si)->getX(), (*si)->getY(), (*si)->getZ() );
-            drawEarthPoint( (*si)->getLat(), (*si)->getLon(), 6.0f );
-        }
-    }
+    // visibility doesn't need to be exact to the frame, so don't check every
+    // time
+    if ( ( autoPause || downscaling || mipmapMaxSize > 0 ) &&
+            drawCounter % 10 == 0 )
+        updateSourceVisibility();
+
+    // pick which of the videos with new frames get to push them this time
+    uploadScheduler->schedule( sources, getScreenRect( true ),
+                                audioAvailable() ? audio : NULL );
+
+    drawEarthPoints();
 
     earth->draw();
 
@@ -270,6 +284,24 @@ void gravManager::draw()
     // z-fighting on the videos which are coplanar
     glDepthMask( GL_FALSE );
 
+    // if possible, do all the borders (& the runway background) up front in
+    // one go - the objects then skip them when drawn below
+    bool batching = canBatchBorders();
+    // videos go with the borders - if they're not being batched, objects
+    // get drawn one by one like before
+    batchRenderer->setTileRenderer( batching ? tileRenderer : NULL );
+    // titles of batched objects go here too
+    SDFFont* textFont = GLUtil::getInstance()->getTextFont();
+    if ( batching )
+    {
+        for ( si = drawnObjects->begin(); si != drawnObjects->end(); si++ )
+        {
+            if ( !(*si)->isGrouped() )
+                (*si)->batchBorder( batchRenderer );
+        }
+        batchRenderer->flush();
+    }
+
     // iterate through all objects to be drawn, and draw
     for ( si = drawnObjects->begin(); si != drawnObjects->end(); si++ )
     {
@@ -324,6 +356,17 @@ void gravManager::draw()
         }
     }
 
+    // then the videos, & anything the objects batched to go on top of them.
+    // titles were drawn in the loop, but nothing overlaps so it's fine for
+    // the videos to come after
+    if ( batching )
+    {
+        tileRenderer->flush();
+        batchRenderer->flush();
+        if ( textFont != NULL )
+            textFont->flush();
+    }
+
     // do the audio focus if it triggered
     if ( audioAvailable() )
     {
@@ -347,79 +390,102 @@ void gravManager::draw()
     // draw the click-and-drag selection box
     if ( holdCounter > 1 && drawSelectionBox )
     {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        float alpha = holdCounter/25.0f * 0.25f;
 
         // the main box
-        glBegin(GL_QUADS);
-
-        glColor4f( 0.1f, 0.2f, 1.0f, holdCounter/25.0f * 0.25f );
-
-        glVertex3f(input->getDragStartX(), input->getDragStartY(), 0.0f);
-        glVertex3f(input->getDragEndX(), input->getDragStartY(), 0.0f);
-        glVertex3f(input->getDragEndX(), input->getDragEndY(), 0.0f);
-        glVertex3f(input->getDragStartX(), input->getDragEndY(), 0.0f);
-
-        glEnd();
+        RGBAColor boxColor;
+        boxColor.R = 0.1f; boxColor.G = 0.2f; boxColor.B = 1.0f;
+        boxColor.A = alpha;
+        batchRenderer->addQuad( input->getDragStartX(),
+                                input->getDragStartY(), input->getDragEndX(),
+                                input->getDragEndY(), 0.0f, boxColor );
 
         // the outline
-        glBegin(GL_LINE_LOOP);
-
-        glColor4f( 0.5f, 0.6f, 1.0f, holdCounter/25.0f * 0.25f );
-
-        glVertex3f(input->getDragStartX(), input->getDragStartY(), 0.0f);
-        glVertex3f(input->getDragEndX(), input->getDragStartY(), 0.0f);
-        glVertex3f(input->getDragEndX(), input->getDragEndY(), 0.0f);
-        glVertex3f(input->getDragStartX(), input->getDragEndY(), 0.0f);
-
-        glEnd();
-
-        glDisable(GL_BLEND);
+        RGBAColor outlineColor;
+        outlineColor.R = 0.5f; outlineColor.G = 0.6f; outlineColor.B = 1.0f;
+        outlineColor.A = alpha;
+        batchRenderer->addOutline( input->getDragStartX(),
+                                    input->getDragStartY(),
+                                    input->getDragEndX(),
+                                    input->getDragEndY(), 0.0f,
+                                    outlineColor );
+
+        batchRenderer->flush();
     }
 
+    // with the distance field font, the header & debug text get batched &
+    // drawn together below
     // header text drawing
     if ( useHeader )
     {
-        glPushMatrix();
-
-        glEnable( GL_BLEND );
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glColor4f( 0.953f, 0.431f, 0.129f, 0.5f );
         float textXPos = screenRectFull.getLBound() + textOffset;
         float textYPos = screenRectFull.getUBound() -
                 ( ( headerTextBox.Upper().Yf() - headerTextBox.Lower().Yf() )
                         * textScale ) - textOffset;
-        glTranslatef( textXPos, textYPos, 0.0f );
-        glScalef( textScale, textScale, textScale );
-        const char* text = headerString.c_str();
-        GLUtil::getInstance()->getMainFont()->Render( text );
-        glDisable( GL_BLEND );
 
-        glPopMatrix();
+        if ( textFont != NULL )
+        {
+            RGBAColor headerColor;
+            headerColor.R = 0.953f; headerColor.G = 0.431f;
+            headerColor.B = 0.129f; headerColor.A = 0.5f;
+            textFont->addText( headerString, textXPos, textYPos, 0.0f,
+                                textScale, headerColor );
+        }
+        else
+        {
+            glPushMatrix();
+
+            glEnable( GL_BLEND );
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glColor4f( 0.953f, 0.431f, 0.129f, 0.5f );
+            glTranslatef( textXPos, textYPos, 0.0f );
+            glScalef( textScale, textScale, textScale );
+            const char* text = headerString.c_str();
+            GLUtil::getInstance()->getMainFont()->Render( text );
+            glDisable( GL_BLEND );
+
+            glPopMatrix();
+        }
     }
 
     // graphics debug drawing
-    if ( graphicsDebugView )
+    if ( graphicsDebugView && canvas != NULL )
     {
-        glPushMatrix();
-
         long drawTime = canvas->getDrawTime();
         float color = (33.0f - (float)drawTime) / 17.0f;
-        glColor4f( 1.0f, color, color, 0.8f );
-        glTranslatef( 0.0f, screenRectFull.getUBound() * 0.9f, 0.0f );
+        float textYPos = screenRectFull.getUBound() * 0.9f;
         float debugScale = textScale / 2.5f;
-        glScalef( debugScale, debugScale, debugScale );
         char text[100];
         sprintf( text,
                 "Draw time: %3ld  Non-draw time: %3ld  Pixel count: %8ld "
                 "FPS: %2.2f",
                 canvas->getDrawTime(), canvas->getNonDrawTime(),
                 videoListener->getPixelCount(), canvas->getFPS() );
-        GLUtil::getInstance()->getMainFont()->Render( text );
 
-        glPopMatrix();
+        if ( textFont != NULL )
+        {
+            RGBAColor debugColor;
+            debugColor.R = 1.0f; debugColor.G = color; debugColor.B = color;
+            debugColor.A = 0.8f;
+            textFont->addText( text, 0.0f, textYPos, 0.0f, debugScale,
+                                debugColor );
+        }
+        else
+        {
+            glPushMatrix();
+
+            glColor4f( 1.0f, color, color, 0.8f );
+            glTranslatef( 0.0f, textYPos, 0.0f );
+            glScalef( debugScale, debugScale, debugScale );
+            GLUtil::getInstance()->getMainFont()->Render( text );
+
+            glPopMatrix();
+        }
     }
 
+    if ( textFont != NULL )
+        textFont->flush();
+
     // back to writeable z-buffer for proper earth/line rendering
     glDepthMask( GL_TRUE );
 
@@ -755,15 +821,49 @@ void gravManager::drawCurvedEarthLine( float lat, float lon,
     */
 }
 
-void gravManager::drawEarthPoint( float lat, float lon, float size )
+void gravManager::drawEarthPoints()
 {
-    float sx, sy, sz;
-    earth->convertLatLong( lat, lon, sx, sy, sz );
+    // point on geographical position, selected ones on top (and bigger).
+    // collect them all first so they get converted in one go
+    std::vector<RectangleBase*> markers;
+    std::vector<RectangleBase*>::const_iterator si;
+    for ( si = drawnObjects->begin(); si != drawnObjects->end(); ++si )
+    {
+        if ( !(*si)->isGrouped() && !(*si)->isSelected() )
+        {
+            //drawCurvedEarthLine( (*si)->getLat(), (*si)->getLon(),
+            //                    (*si)->getX(), (*si)->getY(), (*si)->getZ() );
+            markers.push_back( *si );
+        }
+    }
+    unsigned int numUnselected = markers.size();
+    for ( si = selectedObjects->begin(); si != selectedObjects->end(); ++si )
+    {
+        if ( !(*si)->isGrouped() )
+            markers.push_back( *si );
+    }
 
-    glPointSize( size );
-    glBegin( GL_POINTS );
-    glVertex3f( sx, sy, sz );
-    glEnd();
+    if ( markers.empty() )
+        return;
+
+    std::vector<float> latLongs( markers.size() * 2 );
+    for ( unsigned int i = 0; i < markers.size(); i++ )
+    {
+        latLongs[i*2] = markers[i]->getLat();
+        latLongs[i*2+1] = markers[i]->getLon();
+    }
+    std::vector<float> positions;
+    earth->convertLatLongs( latLongs, positions );
+
+    // one buffer, one draw per point size
+    for ( unsigned int i = 0; i < markers.size(); i++ )
+    {
+        batchRenderer->addPoint( positions[i*3], positions[i*3+1],
+                                    positions[i*3+2],
+                                    i < numUnselected ? 3.0f : 6.0f,
+                                    markers[i]->getColor() );
+    }
+    batchRenderer->flush();
 }
 
 void gravManager::setBoxSelectDrawing( bool draw )
@@ -813,6 +913,8 @@ void gravManager::setWindowSize( int w, int h )
 
     screenRectFull.setPos( (screenL+screenR)/2.0f, (screenU+screenD)/2.0f);
     screenRectFull.setScale( screenR-screenL, screenU-screenD );
+    if ( screenU > screenD )
+        glUtil->setPixelScale( windowHeight / ( screenU - screenD ) );
 
     recalculateRectSizes();
 
@@ -943,10 +1045,12 @@ void gravManager::addNewSource( VideoSource* s )
     if ( s == NULL ) return;
 
     s->setTexture( borderTex, borderWidth, borderHeight );
+    s->setTexturePool( texturePool );
 
     lockSources();
 
     sources->push_back( s );
+    sourceIndex[ SourceKey( s->getSession(), s->getssrc() ) ] = s;
     drawnObjects->push_back( s );
     s->updateName();
 
@@ -989,16 +1093,19 @@ void gravManager::addNewSource( VideoSource* s )
     unlockSources();
 }
 
-void gravManager::deleteSource( std::vector<VideoSource*>::iterator si )
+void gravManager::deleteSource( VideoSource* s )
 {
     lockSources();
 
-    RectangleBase* temp = (RectangleBase*)(*si);
-    VideoSource* s = *si;
+    RectangleBase* temp = (RectangleBase*)s;
 
     removeFromLists( temp );
 
-    sources->erase( si );
+    std::vector<VideoSource*>::iterator si =
+        std::find( sources->begin(), sources->end(), s );
+    if ( si != sources->end() )
+        sources->erase( si );
+    sourceIndex.erase( SourceKey( s->getSession(), s->getssrc() ) );
 
     // TODO need case for runway grouping?
     if ( temp->isGrouped() )
@@ -1051,6 +1158,13 @@ void gravManager::deleteSource( std::vector<VideoSource*>::iterator si )
     unlockSources();
 }
 
+VideoSource* gravManager::findSource( VPMSession* session, uint32_t ssrc )
+{
+    std::tr1::unordered_map<SourceKey, VideoSource*, SourceKeyHash>::iterator
+        it = sourceIndex.find( SourceKey( session, ssrc ) );
+    return it != sourceIndex.end() ? it->second : NULL;
+}
+
 void gravManager::deleteGroup( Group* g )
 {
     lockSources();
@@ -1256,8 +1370,14 @@ void gravManager::setHeaderString( std::string h )
     // since BBox may do some GL calls, any calls to this function must be on
     // the main thread
     if ( GLUtil::getInstance()->getMainFont() )
-        headerTextBox = GLUtil::getInstance()->getMainFont()->BBox(
-                            headerString.c_str() );
+    {
+        if ( GLUtil::getInstance()->getTextMetrics() )
+            headerTextBox = GLUtil::getInstance()->getTextMetrics()->BBox(
+                                headerString );
+        else
+            headerTextBox = GLUtil::getInstance()->getMainFont()->BBox(
+                                headerString.c_str() );
+    }
 
     recalculateRectSizes();
 }
@@ -1336,7 +1456,9 @@ Runway* gravManager::getRunway()
 void gravManager::setGraphicsDebugMode( bool g )
 {
     graphicsDebugView = g;
-    canvas->setDebugTimerUsage( g );
+    // no canvas when running headless
+    if ( canvas != NULL )
+        canvas->setDebugTimerUsage( g );
 }
 
 bool gravManager::getGraphicsDebugMode()
@@ -1344,6 +1466,73 @@ bool gravManager::getGraphicsDebugMode()
     return graphicsDebugView;
 }
 
+void gravManager::setAutoPause( bool a )
+{
+    autoPause = a;
+
+    // make sure nothing stays paused if it got turned off
+    if ( !autoPause )
+    {
+        lockSources();
+        for ( unsigned int i = 0; i < sources->size(); i++ )
+            (*sources)[i]->setAutoPaused( false );
+        unlockSources();
+    }
+}
+
+bool gravManager::usingAutoPause()
+{
+    return autoPause;
+}
+
+void gravManager::setUploadBudget( unsigned long b )
+{
+    uploadScheduler->setBudget( b );
+}
+
+unsigned long gravManager::getUploadBudget()
+{
+    return uploadScheduler->getBudget();
+}
+
+void gravManager::setMipmapThreshold( unsigned int t )
+{
+    mipmapMaxSize = t;
+
+    if ( mipmapMaxSize == 0 )
+    {
+        lockSources();
+        for ( unsigned int i = 0; i < sources->size(); i++ )
+            (*sources)[i]->setMipmapped( false );
+        unlockSources();
+    }
+}
+
+unsigned int gravManager::getMipmapThreshold()
+{
+    return mipmapMaxSize;
+}
+
+void gravManager::setDownscaling( bool d )
+{
+    downscaling = d;
+
+    // back to native for everything
+    if ( !downscaling )
+    {
+        lockSources();
+        for ( unsigned int i = 0; i < sources->size(); i++ )
+            (*sources)[i]->setDisplaySize( (*sources)[i]->getVideoWidth(),
+                                           (*sources)[i]->getVideoHeight() );
+        unlockSources();
+    }
+}
+
+bool gravManager::usingDownscaling()
+{
+    return downscaling;
+}
+
 void gravManager::toggleShowVenueClientController()
 {
     if ( venueClientController != NULL )
@@ -1382,6 +1571,206 @@ bool gravManager::audioAvailable()
     return audioEnabled && audio->getSourceCount() > 0;
 }
 
+void gravManager::updateSourceVisibility()
+{
+    if ( windowWidth == 0 || windowHeight == 0 )
+        return;
+
+    // find what part of the video plane the current camera actually sees,
+    // since the camera may be moved/zoomed away from where the screen rects
+    // were calculated
+    Point topRight, bottomLeft;
+    GLUtil* glUtil = GLUtil::getInstance();
+    if ( !glUtil->screenToRectIntersect( (GLdouble)windowWidth,
+                                         (GLdouble)windowHeight,
+                                         screenRectFull, topRight ) ||
+         !glUtil->screenToRectIntersect( 0.0f, 0.0f, screenRectFull,
+                                         bottomLeft ) )
+        return;
+
+    float viewL = bottomLeft.getX();
+    float viewR = topRight.getX();
+    float viewU = topRight.getY();
+    float viewD = bottomLeft.getY();
+    float pixelsPerUnit = (float)windowWidth / ( viewR - viewL );
+
+    // flatten the draw order - groups draw their members after themselves, so
+    // members come right after the group in terms of what's on top. hidden
+    // groups (ie, the disabled runway) make their members invisible
+    std::vector<RectangleBase*> drawOrder;
+    std::vector<bool> hidden;
+    for ( unsigned int i = 0; i < drawnObjects->size(); i++ )
+    {
+        RectangleBase* obj = (*drawnObjects)[i];
+        if ( obj->isGrouped() )
+            continue;
+
+        if ( obj->isGroup() )
+        {
+            Group* g = static_cast<Group*>( obj );
+            for ( int j = 0; j < g->numObjects(); j++ )
+            {
+                drawOrder.push_back( (*g)[j] );
+                hidden.push_back( g->isHidingMembers() );
+            }
+        }
+        else
+        {
+            drawOrder.push_back( obj );
+            hidden.push_back( false );
+        }
+    }
+
+    double now = gravUtil::getTime();
+
+    for ( unsigned int i = 0; i < drawOrder.size(); i++ )
+    {
+        VideoSource* source = dynamic_cast<VideoSource*>( drawOrder[i] );
+        if ( source == NULL )
+            continue;
+
+        float l = source->getX() - source->getWidth() / 2.0f;
+        float r = source->getX() + source->getWidth() / 2.0f;
+        float u = source->getY() + source->getHeight() / 2.0f;
+        float d = source->getY() - source->getHeight() / 2.0f;
+
+        bool visible = !hidden[i] &&
+                        l < viewR && r > viewL && d < viewU && u > viewD &&
+                        ( r - l ) * pixelsPerUnit >= minVisibleSize &&
+                        ( u - d ) * pixelsPerUnit >= minVisibleSize;
+
+        // check if anything drawn after this completely covers it - only
+        // opaque videos count, since translucent ones (unselectable, ie,
+        // hidden runway members) still show what's behind them
+        for ( unsigned int j = i + 1; visible && j < drawOrder.size(); j++ )
+        {
+            VideoSource* cover = dynamic_cast<VideoSource*>( drawOrder[j] );
+            if ( cover == NULL || hidden[j] || !cover->isSelectable() )
+                continue;
+
+            float cl = cover->getX() - cover->getWidth() / 2.0f;
+            float cr = cover->getX() + cover->getWidth() / 2.0f;
+            float cu = cover->getY() + cover->getHeight() / 2.0f;
+            float cd = cover->getY() - cover->getHeight() / 2.0f;
+            if ( cl <= l && cr >= r && cu >= u && cd <= d )
+                visible = false;
+        }
+
+        source->setVisible( visible );
+
+        // use the destination size so enlarging (ie, going fullscreen) snaps
+        // back to native resolution at the start of the animation rather
+        // than the end
+        if ( downscaling || mipmapMaxSize > 0 )
+        {
+            GLdouble scrL, scrD, scrR, scrU, scrZ;
+            float destL = source->getDestX() - source->getDestWidth() / 2.0f;
+            float destR = source->getDestX() + source->getDestWidth() / 2.0f;
+            float destU = source->getDestY() + source->getDestHeight() / 2.0f;
+            float destD = source->getDestY() - source->getDestHeight() / 2.0f;
+            glUtil->worldToScreen( destL, destD, source->getZ(),
+                                    &scrL, &scrD, &scrZ );
+            glUtil->worldToScreen( destR, destU, source->getZ(),
+                                    &scrR, &scrU, &scrZ );
+            unsigned int scrWidth = (unsigned int)fabs( scrR - scrL );
+            unsigned int scrHeight = (unsigned int)fabs( scrU - scrD );
+            if ( downscaling )
+                source->setDisplaySize( scrWidth, scrHeight );
+            if ( mipmapMaxSize > 0 )
+                source->setMipmapped( scrWidth < mipmapMaxSize );
+        }
+
+        if ( !autoPause )
+            continue;
+
+        // don't pause things that haven't gotten their first frame yet, since
+        // we need that to know their size
+        if ( visible || source->getVideoWidth() == 0 )
+            source->setAutoPaused( false );
+        else if ( now - source->getLastVisibleTime() > autoPauseDelay )
+            source->setAutoPaused( true );
+    }
+}
+
+// for sorting objects left to right when checking for overlaps
+typedef struct {
+    float left, right, bottom, top;
+} DrawnExtent;
+
+static bool compareExtents( const DrawnExtent& a, const DrawnExtent& b )
+{
+    return a.left < b.left;
+}
+
+bool gravManager::canBatchBorders()
+{
+    std::vector<RectangleBase*> topLevel;
+    for ( unsigned int i = 0; i < drawnObjects->size(); i++ )
+    {
+        RectangleBase* obj = (*drawnObjects)[i];
+        if ( obj->isGrouped() )
+            continue;
+        if ( !obj->canBatchBorder() )
+            return false;
+        topLevel.push_back( obj );
+    }
+
+    if ( objectsOverlap( topLevel ) )
+        return false;
+
+    // groups contain their members, but the members themselves draw in turn
+    for ( unsigned int i = 0; i < topLevel.size(); i++ )
+    {
+        if ( topLevel[i]->isGroup() && membersOverlap( (Group*)topLevel[i] ) )
+            return false;
+    }
+
+    return true;
+}
+
+bool gravManager::membersOverlap( Group* g )
+{
+    std::vector<RectangleBase*> members;
+    for ( int i = 0; i < g->numObjects(); i++ )
+        members.push_back( (*g)[i] );
+    if ( objectsOverlap( members ) )
+        return true;
+
+    // batchBorder goes all the way down (ie, site groups on the runway), so
+    // this has to as well
+    for ( unsigned int i = 0; i < members.size(); i++ )
+    {
+        if ( members[i]->isGroup() && membersOverlap( (Group*)members[i] ) )
+            return true;
+    }
+    return false;
+}
+
+bool gravManager::objectsOverlap( std::vector<RectangleBase*>& objects )
+{
+    std::vector<DrawnExtent> extents( objects.size() );
+    for ( unsigned int i = 0; i < objects.size(); i++ )
+    {
+        DrawnExtent& e = extents[i];
+        objects[i]->getDrawnExtent( e.left, e.right, e.bottom, e.top );
+    }
+
+    // sweep left to right, so each one only gets compared with the ones that
+    // start before it ends
+    std::sort( extents.begin(), extents.end(), &compareExtents );
+    for ( unsigned int i = 0; i < extents.size(); i++ )
+    {
+        for ( unsigned int j = i + 1; j < extents.size() &&
+                extents[j].left < extents[i].right; j++ )
+        {
+            if ( extents[j].bottom < extents[i].top &&
+                    extents[i].bottom < extents[j].top )
+                return true;
+        }
+    }
+    return false;
+}
+
 void gravManager::doDelayedDelete()
 {
     if ( objectsToDelete->size() > 0 )
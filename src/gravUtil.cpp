@@ -29,6 +29,9 @@
 #include <wx/filename.h>
 #include <wx/log.h>
 
+#include <sys/time.h>
+#include <sys/resource.h>
+
 gravUtil* gravUtil::instance = NULL;
 
 gravUtil* gravUtil::getInstance()
@@ -196,3 +199,25 @@ wxString gravUtil::getWXStringFromArgs( const char* str, va_list args )
 
     return logString;
 }
+
+double gravUtil::getTime()
+{
+    struct timeval time;
+    gettimeofday( &time, NULL );
+    return (double)time.tv_sec + (double)time.tv_usec / 1000000.0;
+}
+
+double gravUtil::getThreadCPUTime()
+{
+#ifdef RUSAGE_THREAD
+    struct rusage usage;
+    if ( getrusage( RUSAGE_THREAD, &usage ) == 0 )
+    {
+        return (double)usage.ru_utime.tv_sec +
+                (double)usage.ru_utime.tv_usec / 1000000.0 +
+                (double)usage.ru_stime.tv_sec +
+                (double)usage.ru_stime.tv_usec / 1000000.0;
+    }
+#endif
+    return -1.0;
+}